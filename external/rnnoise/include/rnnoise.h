@@ -64,7 +64,10 @@ RNNOISE_EXPORT int rnnoise_get_frame_size();
 /**
  * Initializes a pre-allocated DenoiseState
  *
- * If model is NULL the default model is used.
+ * st must be aligned to 32 bytes, like the states from rnnoise_create().
+ *
+ * If model is NULL the default model is used. A custom model must outlive
+ * the state, see rnnoise_model_free().
  *
  * See: rnnoise_create() and rnnoise_model_from_file()
  */
@@ -73,7 +76,8 @@ RNNOISE_EXPORT int rnnoise_init(DenoiseState *st, RNNModel *model);
 /**
  * Allocate and initialize a DenoiseState
  *
- * If model is NULL the default model is used.
+ * If model is NULL the default model is used. The state holds a reference
+ * to a custom model, see rnnoise_model_free().
  *
  * The returned pointer MUST be freed with rnnoise_destroy().
  */
@@ -82,7 +86,7 @@ RNNOISE_EXPORT DenoiseState *rnnoise_create(RNNModel *model);
 /**
  * Free a DenoiseState produced by rnnoise_create.
  *
- * The optional custom model must be freed by rnnoise_model_free() after.
+ * Releases the state's reference to its custom model.
  */
 RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
@@ -93,11 +97,124 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
  */
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/**
+ * Denoise one frame of samples for each of count states
+ *
+ * Equivalent to calling rnnoise_process_frame() on every state (with
+ * identical results), but the RNN evaluation of states sharing the same
+ * model is batched so that its weights are only loaded once for up to
+ * four states. Typically used for the channels of a multichannel stream.
+ * The VAD probabilities are written to vad_prob, which may be NULL.
+ */
+RNNOISE_EXPORT void rnnoise_process_frame_batch(DenoiseState *const *st, float *const *out, const float *const *in, float *vad_prob, int count);
+
+/**
+ * Denoise nframes consecutive frames of one stream
+ *
+ * in and out hold nframes*rnnoise_get_frame_size() samples and may be the
+ * same buffer. Equivalent to calling rnnoise_process_frame() on every frame
+ * (with identical results), but the parts of the RNN which do not depend on
+ * the previous frame are computed for up to four frames at once. The VAD
+ * probabilities are written to vad_prob, which may be NULL.
+ */
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState *st, float *out, const float *in, float *vad_prob, int nframes);
+
+/**
+ * Variants for samples in [-1, 1] instead of the 16 bit scale of rnnoise_process_frame()
+ *
+ * The scaling is folded into the input filter and the output overlap-add, so
+ * no separate pass over the samples is needed. The output is the one of the
+ * float variant divided by 32767.
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_normalized(DenoiseState *st, float *out, const float *in);
+
+RNNOISE_EXPORT void rnnoise_process_frame_batch_normalized(DenoiseState *const *st, float *const *out, const float *const *in, float *vad_prob, int count);
+
+RNNOISE_EXPORT void rnnoise_process_frames_normalized(DenoiseState *st, float *out, const float *in, float *vad_prob, int nframes);
+
+/**
+ * Denoise a frame of 16 bit samples
+ *
+ * The output is rounded and saturated to 16 bits.
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_int16(DenoiseState *st, short *out, const short *in);
+
+/* Off by default. While the voice is strongly periodic the pitch is only searched around the
+   previous period, with a full search at least every 8 frames. Saves a part of the pitch
+   analysis at the cost of a slightly different output. */
+RNNOISE_EXPORT void rnnoise_set_pitch_tracking(DenoiseState *st, int enabled);
+
+/** Stages of rnnoise_process_frame() with separately recorded timings */
+enum {
+  RNNOISE_STAGE_BIQUAD,
+  RNNOISE_STAGE_FRAME_ANALYSIS,
+  RNNOISE_STAGE_PITCH_SEARCH,
+  RNNOISE_STAGE_FEATURES,
+  RNNOISE_STAGE_RNN_CONV1,
+  RNNOISE_STAGE_RNN_CONV2,
+  RNNOISE_STAGE_RNN_GRU1,
+  RNNOISE_STAGE_RNN_GRU2,
+  RNNOISE_STAGE_RNN_GRU3,
+  RNNOISE_STAGE_RNN_OUTPUT,
+  RNNOISE_STAGE_PITCH_FILTER,
+  RNNOISE_STAGE_FRAME_SYNTHESIS,
+  RNNOISE_STAGE_TOTAL,
+  RNNOISE_STAGE_COUNT
+};
+
+typedef struct {
+  unsigned long long count;
+  unsigned long long min_ns;
+  unsigned long long mean_ns;
+  /* Read from a histogram, within 12.5% of the exact value. */
+  unsigned long long p99_ns;
+  unsigned long long max_ns;
+} RNNoiseStageTiming;
+
+typedef struct {
+  /* rnnoise_get_size() */
+  int state_bytes;
+  /* Weights of the model the state was initialized with. */
+  int model_bytes;
+  /* Largest stack buffers used by rnnoise_process_frame() and by
+     rnnoise_process_frame_batch() or rnnoise_process_frames() for a full batch. */
+  int scratch_bytes;
+  int batch_scratch_bytes;
+} RNNoiseMemoryFootprint;
+
+/**
+ * Name of a RNNOISE_STAGE_* stage, NULL for invalid stages
+ */
+RNNOISE_EXPORT const char *rnnoise_stage_name(int stage);
+
+/**
+ * Timings of each stage, combined over count states
+ *
+ * Only recorded when the library is built with RNNOISE_PROFILE, returns -1
+ * otherwise. timings must hold RNNOISE_STAGE_COUNT entries. Batched RNN
+ * layers are timed once per batch and split evenly between its frames. Must
+ * not be called concurrently with processing of the states.
+ */
+RNNOISE_EXPORT int rnnoise_get_stage_timings(DenoiseState *const *st, int count, RNNoiseStageTiming *timings);
+
+/**
+ * Clears the recorded timings of a state
+ */
+RNNOISE_EXPORT void rnnoise_reset_stage_timings(DenoiseState *st);
+
+/**
+ * Memory used by a state, its model and a call to process it
+ */
+RNNOISE_EXPORT void rnnoise_get_memory_footprint(const DenoiseState *st, RNNoiseMemoryFootprint *footprint);
+
 /**
  * Load a model from a memory buffer
  *
- * It must be deallocated with rnnoise_model_free() and the buffer must remain
- * valid until after the returned object is destroyed.
+ * The model is parsed once and can be shared by any number of states. The
+ * weights are used in place unless the buffer isn't aligned to 4 bytes, so the
+ * buffer must remain valid until the model is freed. Returns NULL if the blob
+ * is malformed.
+ * It must be deallocated with rnnoise_model_free().
  */
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_buffer(const void *ptr, int len);
 
@@ -105,22 +222,45 @@ RNNOISE_EXPORT RNNModel *rnnoise_model_from_buffer(const void *ptr, int len);
 /**
  * Load a model from a file
  *
- * It must be deallocated with rnnoise_model_free() and the file must not be
- * closed until the returned object is destroyed.
+ * The whole file is read, it can be closed once this returns.
+ * It must be deallocated with rnnoise_model_free().
  */
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_file(FILE *f);
 
 /**
  * Load a model from a file name
  *
- * It must be deallocated with rnnoise_model_free()
+ * The file is mapped read-only where possible, so the weights are shared
+ * through the page cache by every process loading the same file. While the
+ * model is alive the file must only be replaced by renaming a new file over
+ * it, writing to it in place changes the weights under the model or, if it
+ * shrinks, crashes the process (SIGBUS) on the next access.
+ * It must be deallocated with rnnoise_model_free().
  */
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_filename(const char *filename);
 
 /**
- * Free a custom model
+ * The weights blob a model runs on, e.g. to tell models loaded from different
+ * contents apart
+ *
+ * Points into the file mapping, the model's own copy or the caller's buffer, and
+ * stays valid until the model is freed.
+ */
+RNNOISE_EXPORT const void *rnnoise_model_get_data(const RNNModel *model, int *len);
+
+/**
+ * Take another reference to a model, released with rnnoise_model_free()
+ *
+ * Thread safe, like rnnoise_model_free().
+ */
+RNNOISE_EXPORT RNNModel *rnnoise_model_ref(RNNModel *model);
+
+/**
+ * Release a reference to a custom model
  *
- * It must be called after all the DenoiseStates referring to it are freed.
+ * States from rnnoise_create() hold their own reference, so the model can be
+ * released right after creating them. States set up with rnnoise_init() don't,
+ * the model must outlive them.
  */
 RNNOISE_EXPORT void rnnoise_model_free(RNNModel *model);
 
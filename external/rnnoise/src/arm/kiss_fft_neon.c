@@ -0,0 +1,111 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* NEON is always there when the compiler targets it, so this file is compiled for every target
+   and is only used when vec_neon.h is used for the DNN. */
+#if (defined(__ARM_NEON__) || defined(__ARM_NEON)) && !defined(DISABLE_NEON)
+
+#include <arm_neon.h>
+#include "kiss_fft.h"
+
+#define RTCD_ARCH neon
+
+/* Two complex values, real and imaginary parts interleaved. */
+typedef float32x4_t fft_vec;
+#define FFT_VEC_SIZE 2
+
+static const uint32_t sign_real[4] = {0x80000000, 0, 0x80000000, 0};
+static const uint32_t sign_imag[4] = {0, 0x80000000, 0, 0x80000000};
+
+static OPUS_INLINE fft_vec fft_vec_load(const kiss_fft_cpx *p)
+{
+   return vld1q_f32(&p->r);
+}
+
+static OPUS_INLINE void fft_vec_store(kiss_fft_cpx *p, fft_vec v)
+{
+   vst1q_f32(&p->r, v);
+}
+
+static OPUS_INLINE fft_vec fft_vec_load_strided(const kiss_fft_cpx *p, int stride)
+{
+   return vcombine_f32(vld1_f32(&p[0].r), vld1_f32(&p[stride].r));
+}
+
+static OPUS_INLINE void fft_vec_store_strided(kiss_fft_cpx *p, int stride, fft_vec v)
+{
+   vst1_f32(&p[0].r, vget_low_f32(v));
+   vst1_f32(&p[stride].r, vget_high_f32(v));
+}
+
+static OPUS_INLINE fft_vec fft_vec_load_twiddles(const kiss_twiddle_cpx *tw, int stride)
+{
+   return vcombine_f32(vld1_f32(&tw[0].r), vld1_f32(&tw[stride].r));
+}
+
+static OPUS_INLINE fft_vec fft_vec_add(fft_vec a, fft_vec b)
+{
+   return vaddq_f32(a, b);
+}
+
+static OPUS_INLINE fft_vec fft_vec_sub(fft_vec a, fft_vec b)
+{
+   return vsubq_f32(a, b);
+}
+
+static OPUS_INLINE fft_vec fft_vec_scale(fft_vec a, float s)
+{
+   return vmulq_n_f32(a, s);
+}
+
+static OPUS_INLINE fft_vec fft_vec_cmul(fft_vec a, fft_vec b)
+{
+   float32x4x2_t parts = vtrnq_f32(b, b);
+   float32x4_t re = vmulq_f32(a, parts.val[0]);
+   float32x4_t im = vmulq_f32(vrev64q_f32(a), parts.val[1]);
+   /* Subtract in the real lanes and add in the imaginary ones. */
+   im = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(im), vld1q_u32(sign_real)));
+   return vaddq_f32(re, im);
+}
+
+/* (a.i, -a.r) */
+static OPUS_INLINE fft_vec fft_vec_mul_minus_i(fft_vec a)
+{
+   return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vrev64q_f32(a)), vld1q_u32(sign_imag)));
+}
+
+#include "kiss_fft_arch.h"
+
+#else
+
+/* ISO C doesn't allow an empty translation unit. */
+typedef int rnn_kiss_fft_neon_unused;
+
+#endif
@@ -0,0 +1,74 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* Compiled for every target like kiss_fft_neon.c, only used when the compiler targets NEON. */
+#if (defined(__ARM_NEON__) || defined(__ARM_NEON)) && !defined(DISABLE_NEON)
+
+#include <arm_neon.h>
+#include "pitch.h"
+
+#define RTCD_ARCH neon
+
+typedef float32x4_t xcorr_vec;
+#define XCORR_VEC_SIZE 4
+
+static OPUS_INLINE xcorr_vec xcorr_vec_zero(void)
+{
+   return vdupq_n_f32(0);
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_set1(float a)
+{
+   return vdupq_n_f32(a);
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_load(const float *p)
+{
+   return vld1q_f32(p);
+}
+
+static OPUS_INLINE void xcorr_vec_store(float *p, xcorr_vec v)
+{
+   vst1q_f32(p, v);
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_mac(xcorr_vec sum, xcorr_vec a, xcorr_vec b)
+{
+   return vmlaq_f32(sum, a, b);
+}
+
+#include "pitch_arch.h"
+
+#else
+
+/* ISO C doesn't allow an empty translation unit. */
+typedef int rnn_pitch_neon_unused;
+
+#endif
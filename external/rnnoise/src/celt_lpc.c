@@ -95,7 +95,8 @@ int rnn_autocorr(
                    const opus_val16       *window,
                    int          overlap,
                    int          lag,
-                   int          n)
+                   int          n,
+                   int          arch)
 {
    opus_val32 d;
    int i, k;
@@ -142,7 +143,7 @@ int rnn_autocorr(
          shift = 0;
    }
 #endif
-   rnn_pitch_xcorr(xptr, xptr, ac, fastN, lag+1);
+   rnn_pitch_xcorr(xptr, xptr, ac, fastN, lag+1, arch);
    for (k=0;k<=lag;k++)
    {
       for (i = k+fastN, d = 0; i < n; i++)
@@ -40,6 +40,6 @@
 void rnn_lpc(opus_val16 *_lpc, const opus_val32 *ac, int p);
 
 int rnn_autocorr(const opus_val16 *x, opus_val32 *ac,
-         const opus_val16 *window, int overlap, int lag, int n);
+         const opus_val16 *window, int overlap, int lag, int n, int arch);
 
 #endif /* PLC_H */
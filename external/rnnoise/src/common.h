@@ -27,6 +27,34 @@ static RNN_INLINE void rnnoise_free (void *ptr)
 }
 #endif
 
+/** rnnoise_alloc() for memory aligned to align bytes (a power of two), which must be freed
+    with rnnoise_free_aligned(). The original pointer is kept right before the aligned block. */
+static RNN_INLINE void *rnnoise_alloc_aligned (size_t size, size_t align)
+{
+   unsigned char *ptr;
+   unsigned char *aligned;
+   ptr = (unsigned char *)rnnoise_alloc(size + align + sizeof(void *));
+   if (ptr == NULL) return NULL;
+   aligned = ptr + sizeof(void *);
+   aligned += (align - ((size_t)aligned & (align - 1))) & (align - 1);
+   ((void **)aligned)[-1] = ptr;
+   return aligned;
+}
+
+static RNN_INLINE void rnnoise_free_aligned (void *ptr)
+{
+   if (ptr != NULL) rnnoise_free(((void **)ptr)[-1]);
+}
+
+/** Aligns a variable or a struct member to n bytes. */
+#if defined(_MSC_VER)
+#define RNN_ALIGN(n) __declspec(align(n))
+#elif defined(__GNUC__)
+#define RNN_ALIGN(n) __attribute__((aligned(n)))
+#else
+#define RNN_ALIGN(n)
+#endif
+
 /** Copy n elements from src to dst. The 0* term provides compile-time type checking  */
 #ifndef OVERRIDE_RNN_COPY
 #define RNN_COPY(dst, src, n) (memcpy((dst), (src), (n)*sizeof(*(dst)) + 0*((dst)-(src)) ))
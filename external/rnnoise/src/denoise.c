@@ -33,6 +33,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "kiss_fft.h"
 #include "common.h"
 #include "denoise.h"
@@ -50,6 +60,22 @@
 #define TRAINING 0
 #endif
 
+/* Pitch tracking: while the pitch gain stays above PITCH_TRACK_MIN_GAIN, the coarse search
+   only looks within PITCH_TRACK_RADIUS of the previous lag (at least 1/8 of it), with a full
+   search at least every PITCH_TRACK_MAX_FRAMES frames. */
+#define PITCH_TRACK_MIN_GAIN .6f
+#define PITCH_TRACK_RADIUS 24
+#define PITCH_TRACK_MAX_FRAMES 8
+
+/* Sample formats of the rnnoise_process_*() variants. rnnoise works on floats at 16 bit scale,
+   the others are converted by the high-pass filter on the way in and by the overlap-add of the
+   synthesis on the way out. */
+#define SAMPLES_SHORT_SCALE 0
+#define SAMPLES_NORMALIZED 1
+#define SAMPLES_INT16 2
+
+#define SAMPLE_SCALE 32767.f
+
 
 /* ERB bandwidths going in reverse from 20 kHz and then replacing the 700 and 800
    with just 750 because having 32 bands is convenient for the DNN. 
@@ -66,17 +92,24 @@ const int eband20ms[NB_BANDS+2] = {
 
 
 struct DenoiseState {
-  RNNoise model;
-#if !TRAINING
+  const RNNModel *model;
+  /* Set when the state holds a reference to its model, see rnnoise_create(). */
+  RNNModel *model_ref;
   int arch;
-#endif
   float analysis_mem[FRAME_SIZE];
   int memid;
   float synthesis_mem[FRAME_SIZE];
   float pitch_buf[PITCH_BUF_SIZE];
   float pitch_enh_buf[PITCH_BUF_SIZE];
+  float pitch_lp_raw[PITCH_BUF_SIZE>>1];
+  float pitch_lp[PITCH_BUF_SIZE>>1];
   float last_gain;
   int last_period;
+  int pitch_tracking;
+  /* Lag found by the last pitch search, before removing doubling, and how many frames in a
+     row it has been tracked. */
+  int last_lag;
+  int tracked_frames;
   float mem_hp_x[2];
   float lastg[NB_BANDS];
   RNNState rnn;
@@ -84,24 +117,60 @@ struct DenoiseState {
   kiss_fft_cpx delayed_P[FREQ_SIZE];
   float delayed_Ex[NB_BANDS], delayed_Ep[NB_BANDS];
   float delayed_Exp[NB_BANDS];
-
+#ifdef RNNOISE_PROFILE
+  RnnProfile profile;
+#endif
 };
 
-static void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
+extern const float rnn_dct_table[];
+extern const float rnn_band_frac[];
+extern const kiss_fft_state rnn_kfft_half;
+extern const float rnn_half_window[];
+
+/* x = m*2^e with m in [sqrt(.5), sqrt(2)), then log(m) = 2*atanh((m-1)/(m+1)). Within a few
+   ulp of log10() for positive normal x, without a libm call so that loops over it vectorize. */
+static OPUS_INLINE float log10_approx(float x) {
+  union {
+    float f;
+    opus_uint32 i;
+  } m;
+  int e;
+  float s, s2, ln;
+  m.f = x;
+  e = (opus_int32)(m.i - 0x3f3504f3) >> 23;
+  m.i -= (opus_uint32)e << 23;
+  s = (m.f - 1)/(m.f + 1);
+  s2 = s*s;
+  ln = 2*s*(1 + s2*(1.f/3 + s2*(1.f/5 + s2*(1.f/7))));
+  return (e*0.693147181f + ln)*0.434294482f;
+}
+
+/* 1/sqrt(x) from the classic initial guess and three Newton steps, within a couple of ulp for
+   positive normal x. Branch free for the same reason as log10_approx(). */
+static OPUS_INLINE float rsqrt_approx(float x) {
+  union {
+    float f;
+    opus_uint32 i;
+  } y;
+  y.f = x;
+  y.i = 0x5f3759df - (y.i >> 1);
+  y.f = y.f*(1.5f - .5f*x*y.f*y.f);
+  y.f = y.f*(1.5f - .5f*x*y.f*y.f);
+  y.f = y.f*(1.5f - .5f*x*y.f*y.f);
+  return y.f;
+}
+
+/* Spreads the per bin values over the bands with triangular weights, every bin goes to its
+   own band and to the next one by its position in the band (rnn_band_frac). */
+static void band_sum(float *bandE, const float *binE) {
   int i;
   float sum[NB_BANDS+2] = {0};
   for (i=0;i<NB_BANDS+1;i++)
   {
     int j;
-    int band_size;
-    band_size = eband20ms[i+1]-eband20ms[i];
-    for (j=0;j<band_size;j++) {
-      float tmp;
-      float frac = (float)j/band_size;
-      tmp = SQUARE(X[eband20ms[i] + j].r);
-      tmp += SQUARE(X[eband20ms[i] + j].i);
-      sum[i] += (1-frac)*tmp;
-      sum[i+1] += frac*tmp;
+    for (j=eband20ms[i];j<eband20ms[i+1];j++) {
+      sum[i] += (1-rnn_band_frac[j])*binE[j];
+      sum[i+1] += rnn_band_frac[j]*binE[j];
     }
   }
   sum[1] = (sum[0]+sum[1])*2/3;
@@ -112,61 +181,50 @@ static void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
   }
 }
 
-static void compute_band_corr(float *bandE, const kiss_fft_cpx *X, const kiss_fft_cpx *P) {
+static void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
   int i;
-  float sum[NB_BANDS+2] = {0};
-  for (i=0;i<NB_BANDS+1;i++)
-  {
-    int j;
-    int band_size;
-    band_size = eband20ms[i+1]-eband20ms[i];
-    for (j=0;j<band_size;j++) {
-      float tmp;
-      float frac = (float)j/band_size;
-      tmp = X[eband20ms[i] + j].r * P[eband20ms[i] + j].r;
-      tmp += X[eband20ms[i] + j].i * P[eband20ms[i] + j].i;
-      sum[i] += (1-frac)*tmp;
-      sum[i+1] += frac*tmp;
-    }
+  float binE[FREQ_SIZE];
+  for (i=0;i<eband20ms[NB_BANDS+1];i++) {
+    binE[i] = SQUARE(X[i].r);
+    binE[i] += SQUARE(X[i].i);
   }
-  sum[1] = (sum[0]+sum[1])*2/3;
-  sum[NB_BANDS] = (sum[NB_BANDS]+sum[NB_BANDS+1])*2/3;
-  for (i=0;i<NB_BANDS;i++)
-  {
-    bandE[i] = sum[i+1];
+  band_sum(bandE, binE);
+}
+
+static void compute_band_corr(float *bandE, const kiss_fft_cpx *X, const kiss_fft_cpx *P) {
+  int i;
+  float binE[FREQ_SIZE];
+  for (i=0;i<eband20ms[NB_BANDS+1];i++) {
+    binE[i] = X[i].r * P[i].r;
+    binE[i] += X[i].i * P[i].i;
   }
+  band_sum(bandE, binE);
 }
 
 static void interp_band_gain(float *g, const float *bandE) {
   int i,j;
-  memset(g, 0, FREQ_SIZE);
   for (i=1;i<NB_BANDS;i++)
   {
-    int band_size;
-    band_size = eband20ms[i+1]-eband20ms[i];
-    for (j=0;j<band_size;j++) {
-      float frac = (float)j/band_size;
-      g[eband20ms[i] + j] = (1-frac)*bandE[i-1] + frac*bandE[i];
+    for (j=eband20ms[i];j<eband20ms[i+1];j++) {
+      g[j] = (1-rnn_band_frac[j])*bandE[i-1] + rnn_band_frac[j]*bandE[i];
     }
   }
   for (j=0;j<eband20ms[1];j++) g[j] = bandE[0];
   for (j=eband20ms[NB_BANDS];j<eband20ms[NB_BANDS+1];j++) g[j] = bandE[NB_BANDS-1];
+  for (j=eband20ms[NB_BANDS+1];j<FREQ_SIZE;j++) g[j] = 0;
 }
 
-extern const float rnn_dct_table[];
-extern const kiss_fft_state rnn_kfft;
-extern const float rnn_half_window[];
-
+/* Row by row over the table, every output accumulates in the same order as a dot product
+   would, but the inner loop runs over all the outputs at once. */
 static void dct(float *out, const float *in) {
-  int i;
-  for (i=0;i<NB_BANDS;i++) {
-    int j;
-    float sum = 0;
-    for (j=0;j<NB_BANDS;j++) {
-      sum += in[j] * rnn_dct_table[j*NB_BANDS + i];
+  int i, j;
+  float sum[NB_BANDS] = {0};
+  for (j=0;j<NB_BANDS;j++) {
+    for (i=0;i<NB_BANDS;i++) {
+      sum[i] += in[j] * rnn_dct_table[j*NB_BANDS + i];
     }
-    out[i] = sum*sqrt(2./22);
   }
+  for (i=0;i<NB_BANDS;i++) out[i] = sum[i]*sqrt(2./22);
 }
 
 #if 0
@@ -183,94 +241,252 @@ static void idct(float *out, const float *in) {
 }
 #endif
 
-static void forward_transform(kiss_fft_cpx *out, const float *in) {
-  int i;
-  kiss_fft_cpx x[WINDOW_SIZE];
-  kiss_fft_cpx y[WINDOW_SIZE];
-  for (i=0;i<WINDOW_SIZE;i++) {
-    x[i].r = in[i];
-    x[i].i = 0;
-  }
-  rnn_fft(&rnn_kfft, x, y, 0);
-  for (i=0;i<FREQ_SIZE;i++) {
-    out[i] = y[i];
+/* Windowed real FFT of WINDOW_SIZE samples into FREQ_SIZE bins. */
+static void forward_transform(kiss_fft_cpx *out, const float *in, int arch) {
+  rnn_real_fft(&rnn_kfft_half, rnn_half_window, in, out, arch);
+}
+
+/* Inverse of forward_transform(), windowed again for the overlap-add. */
+static void inverse_transform(float *out, const kiss_fft_cpx *in, int arch) {
+  rnn_real_ifft(&rnn_kfft_half, rnn_half_window, in, out, arch);
+}
+
+#if defined(_MSC_VER)
+static long rnn_atomic_add(volatile long *value, long delta) {
+  return _InterlockedExchangeAdd(value, delta) + delta;
+}
+static int rnn_atomic_cas(volatile long *value, long expected, long desired) {
+  return _InterlockedCompareExchange(value, desired, expected) == expected;
+}
+static long rnn_atomic_load(volatile long *value) {
+  return _InterlockedOr(value, 0);
+}
+static void rnn_atomic_store(volatile long *value, long desired) {
+  _InterlockedExchange(value, desired);
+}
+#else
+static long rnn_atomic_add(volatile long *value, long delta) {
+  return __atomic_add_fetch(value, delta, __ATOMIC_ACQ_REL);
+}
+static int rnn_atomic_cas(volatile long *value, long expected, long desired) {
+  return __atomic_compare_exchange_n(value, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+static long rnn_atomic_load(volatile long *value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+static void rnn_atomic_store(volatile long *value, long desired) {
+  __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+#endif
+
+/* A model is parsed once and shared by all the states using it, the layers point
+   straight into the weight blob. */
+struct RNNModel {
+  RNNoise rnn;
+  int model_bytes;
+  /* The creator's reference, plus one for each state from rnnoise_create(). */
+  volatile long refs;
+  /* Storage owned by the model, if any: an aligned copy or a read-only mapping. */
+  void *blob;
+  void *mapping;
+  size_t mapping_len;
+  /* The weights the layers point into, NULL for the built-in model. */
+  const void *data;
+  int data_len;
+};
+
+static int weight_arrays_size(const WeightArray *arrays) {
+  int size = 0;
+  while (arrays->name != NULL) {
+    size += arrays->size;
+    arrays++;
   }
+  return size;
 }
 
-static void inverse_transform(float *out, const kiss_fft_cpx *in) {
-  int i;
-  kiss_fft_cpx x[WINDOW_SIZE];
-  kiss_fft_cpx y[WINDOW_SIZE];
-  for (i=0;i<FREQ_SIZE;i++) {
-    x[i] = in[i];
+#if !TRAINING
+static RNNModel *model_create(const void *data, int len) {
+  RNNModel *model;
+  WeightArray *list;
+  int ret;
+  model = malloc(sizeof(*model));
+  if (model == NULL) return NULL;
+  memset(model, 0, sizeof(*model));
+  if (parse_weights(&list, data, len) < 0) {
+    free(model);
+    return NULL;
   }
-  for (;i<WINDOW_SIZE;i++) {
-    x[i].r = x[WINDOW_SIZE - i].r;
-    x[i].i = -x[WINDOW_SIZE - i].i;
+  ret = init_rnnoise(&model->rnn, list);
+  model->model_bytes = weight_arrays_size(list);
+  opus_free(list);
+  if (ret != 0) {
+    free(model);
+    return NULL;
   }
-  rnn_fft(&rnn_kfft, x, y, 0);
-  /* output in reverse order for IFFT. */
-  out[0] = WINDOW_SIZE*y[0].r;
-  for (i=1;i<WINDOW_SIZE;i++) {
-    out[i] = WINDOW_SIZE*y[WINDOW_SIZE - i].r;
+  model->refs = 1;
+  model->data = data;
+  model->data_len = len;
+  return model;
+}
+#endif
+
+#if !TRAINING && !defined(USE_WEIGHTS_FILE)
+static RNNModel builtin_model;
+/* 0: not initialized yet, 1: being initialized, 2: ready, 3: failed. */
+static volatile long builtin_model_state;
+
+/* The compiled-in model, initialized by whichever state needs it first. */
+static RNNModel *get_builtin_model(void) {
+  long state = rnn_atomic_load(&builtin_model_state);
+  if (state < 2 && rnn_atomic_cas(&builtin_model_state, 0, 1)) {
+    int ret = init_rnnoise(&builtin_model.rnn, rnnoise_arrays);
+    builtin_model.model_bytes = weight_arrays_size(rnnoise_arrays);
+    /* Never released, so never freed. */
+    builtin_model.refs = 1;
+    rnn_atomic_store(&builtin_model_state, ret == 0 ? 2 : 3);
   }
+  while ((state = rnn_atomic_load(&builtin_model_state)) < 2) {}
+  return state == 2 ? &builtin_model : NULL;
 }
+#endif
 
-static void apply_window(float *x) {
-  int i;
-  for (i=0;i<FRAME_SIZE;i++) {
-    x[i] *= rnn_half_window[i];
-    x[WINDOW_SIZE - 1 - i] *= rnn_half_window[i];
+#if defined(_WIN32)
+#define RNN_HAVE_MAP_FILE
+static void *map_file(const char *filename, size_t *len) {
+  HANDLE file;
+  HANDLE mapping;
+  LARGE_INTEGER size;
+  void *data = NULL;
+  file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart <= INT_MAX) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
   }
+  CloseHandle(file);
+  if (data != NULL) *len = (size_t)size.QuadPart;
+  return data;
 }
 
-struct RNNModel {
-  /* Set either blob or const_blob. */
-  const void *const_blob;
-  void *blob;
-  int blob_len;
-  FILE *file;
-};
+static void unmap_file(void *data, size_t len) {
+  (void)len;
+  UnmapViewOfFile(data);
+}
+#elif defined(__unix__) || defined(__APPLE__)
+#define RNN_HAVE_MAP_FILE
+static void *map_file(const char *filename, size_t *len) {
+  int fd;
+  struct stat st;
+  void *data = NULL;
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= INT_MAX) {
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) data = NULL;
+    else *len = (size_t)st.st_size;
+  }
+  /* The mapping stays valid without the descriptor. */
+  close(fd);
+  return data;
+}
+
+static void unmap_file(void *data, size_t len) {
+  munmap(data, len);
+}
+#endif
 
 RNNModel *rnnoise_model_from_buffer(const void *ptr, int len) {
+#if !TRAINING
   RNNModel *model;
-  model = malloc(sizeof(*model));
-  model->blob = NULL;
-  model->const_blob = ptr;
-  model->blob_len = len;
+  void *blob = NULL;
+  if (((size_t)ptr & (WEIGHT_BLOB_ALIGN-1)) != 0) {
+    /* The weights can't be used in place. */
+    blob = rnnoise_alloc_aligned(len, WEIGHT_BLOCK_SIZE);
+    if (blob == NULL) return NULL;
+    memcpy(blob, ptr, len);
+    ptr = blob;
+  }
+  model = model_create(ptr, len);
+  if (model == NULL) rnnoise_free_aligned(blob);
+  else model->blob = blob;
   return model;
+#else
+  (void)ptr;
+  (void)len;
+  return NULL;
+#endif
 }
 
 RNNModel *rnnoise_model_from_filename(const char *filename) {
   RNNModel *model;
-  FILE *f = fopen(filename, "rb");
+  FILE *f;
+#if defined(RNN_HAVE_MAP_FILE) && !TRAINING
+  size_t len;
+  void *data = map_file(filename, &len);
+  if (data != NULL) {
+    /* Read-only and shared, so every process using the file shares the page cache. */
+    model = model_create(data, (int)len);
+    if (model == NULL) unmap_file(data, len);
+    else {
+      model->mapping = data;
+      model->mapping_len = len;
+    }
+    return model;
+  }
+#endif
+  f = fopen(filename, "rb");
+  if (f == NULL) return NULL;
   model = rnnoise_model_from_file(f);
-  model->file = f;
+  fclose(f);
   return model;
 }
 
 RNNModel *rnnoise_model_from_file(FILE *f) {
+#if !TRAINING
   RNNModel *model;
-  model = malloc(sizeof(*model));
-  model->file = NULL;
+  void *blob;
+  long len;
 
-  fseek(f, 0, SEEK_END);
-  model->blob_len = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  if (fseek(f, 0, SEEK_END) != 0) return NULL;
+  len = ftell(f);
+  if (len <= 0 || len > INT_MAX || fseek(f, 0, SEEK_SET) != 0) return NULL;
 
-  model->const_blob = NULL;
-  model->blob = malloc(model->blob_len);
-  if (fread(model->blob, model->blob_len, 1, f) != 1)
+  blob = rnnoise_alloc_aligned(len, WEIGHT_BLOCK_SIZE);
+  if (blob == NULL) return NULL;
+  if (fread(blob, len, 1, f) != 1)
   {
-    rnnoise_model_free(model);
+    rnnoise_free_aligned(blob);
     return NULL;
   }
+  model = model_create(blob, (int)len);
+  if (model == NULL) rnnoise_free_aligned(blob);
+  else model->blob = blob;
+  return model;
+#else
+  (void)f;
+  return NULL;
+#endif
+}
+
+const void *rnnoise_model_get_data(const RNNModel *model, int *len) {
+  *len = model->data_len;
+  return model->data;
+}
+
+RNNModel *rnnoise_model_ref(RNNModel *model) {
+  rnn_atomic_add(&model->refs, 1);
   return model;
 }
 
 void rnnoise_model_free(RNNModel *model) {
-  if (model->file != NULL) fclose(model->file);
-  if (model->blob != NULL) free(model->blob);
+  if (model == NULL || rnn_atomic_add(&model->refs, -1) != 0) return;
+#ifdef RNN_HAVE_MAP_FILE
+  if (model->mapping != NULL) unmap_file(model->mapping, model->mapping_len);
+#endif
+  rnnoise_free_aligned(model->blob);
   free(model);
 }
 
@@ -285,25 +501,17 @@ int rnnoise_get_frame_size() {
 int rnnoise_init(DenoiseState *st, RNNModel *model) {
   memset(st, 0, sizeof(*st));
 #if !TRAINING
-  if (model != NULL) {
-    WeightArray *list;
-    int ret = 1;
-    parse_weights(&list, model->blob ? model->blob : model->const_blob, model->blob_len);
-    if (list != NULL) {
-      ret = init_rnnoise(&st->model, list);
-      opus_free(list);
-    }
-    if (ret != 0) return -1;
-  }
 #ifndef USE_WEIGHTS_FILE
-  else {
-    int ret = init_rnnoise(&st->model, rnnoise_arrays);
-    if (ret != 0) return -1;
-  }
+  if (model == NULL) model = get_builtin_model();
 #endif
+  if (model == NULL) return -1;
+  st->model = model;
   st->arch = rnn_select_arch();
 #else
   (void)model;
+#endif
+#ifdef RNNOISE_PROFILE
+  st->rnn.profile = &st->profile;
 #endif
   return 0;
 }
@@ -311,17 +519,23 @@ int rnnoise_init(DenoiseState *st, RNNModel *model) {
 DenoiseState *rnnoise_create(RNNModel *model) {
   int ret;
   DenoiseState *st;
-  st = malloc(rnnoise_get_size());
+  /* The RNN states are aligned for the vector code. */
+  st = rnnoise_alloc_aligned(rnnoise_get_size(), RNN_STATE_ALIGN);
+  if (st == NULL) return NULL;
   ret = rnnoise_init(st, model);
   if (ret != 0) {
-    free(st);
+    rnnoise_free_aligned(st);
     return NULL;
   }
+  /* Keeps a custom model alive until rnnoise_destroy(). */
+  if (model != NULL) st->model_ref = rnnoise_model_ref(model);
   return st;
 }
 
 void rnnoise_destroy(DenoiseState *st) {
-  free(st);
+  if (st == NULL) return;
+  rnnoise_model_free(st->model_ref);
+  rnnoise_free_aligned(st);
 }
 
 #if TRAINING
@@ -335,8 +549,7 @@ void rnn_frame_analysis(DenoiseState *st, kiss_fft_cpx *X, float *Ex, const floa
   RNN_COPY(x, st->analysis_mem, FRAME_SIZE);
   for (i=0;i<FRAME_SIZE;i++) x[FRAME_SIZE + i] = in[i];
   RNN_COPY(st->analysis_mem, in, FRAME_SIZE);
-  apply_window(x);
-  forward_transform(X, x);
+  forward_transform(X, x, st->arch);
 #if TRAINING
   for (i=lowpass;i<FREQ_SIZE;i++)
     X[i].r = X[i].i = 0;
@@ -349,38 +562,45 @@ int rnn_compute_frame_features(DenoiseState *st, kiss_fft_cpx *X, kiss_fft_cpx *
   int i;
   float E = 0;
   float Ly[NB_BANDS];
-  float p[WINDOW_SIZE];
-  float pitch_buf[PITCH_BUF_SIZE>>1];
   int pitch_index;
   float gain;
-  float *(pre[1]);
   float follow, logMax;
+  RNN_PROFILE_DECL(t);
   rnn_frame_analysis(st, X, Ex, in);
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_FRAME_ANALYSIS, t);
   RNN_MOVE(st->pitch_buf, &st->pitch_buf[FRAME_SIZE], PITCH_BUF_SIZE-FRAME_SIZE);
   RNN_COPY(&st->pitch_buf[PITCH_BUF_SIZE-FRAME_SIZE], in, FRAME_SIZE);
-  pre[0] = &st->pitch_buf[0];
-  rnn_pitch_downsample(pre, pitch_buf, PITCH_BUF_SIZE, 1);
-  rnn_pitch_search(pitch_buf+(PITCH_MAX_PERIOD>>1), pitch_buf, PITCH_FRAME_SIZE,
-               PITCH_MAX_PERIOD-3*PITCH_MIN_PERIOD, &pitch_index);
+  rnn_pitch_downsample(st->pitch_buf, st->pitch_lp_raw, st->pitch_lp, PITCH_BUF_SIZE, FRAME_SIZE, st->arch);
+  if (st->pitch_tracking && st->last_gain > PITCH_TRACK_MIN_GAIN
+      && st->tracked_frames < PITCH_TRACK_MAX_FRAMES) {
+    int radius = IMAX(PITCH_TRACK_RADIUS, (PITCH_MAX_PERIOD-st->last_lag)>>3);
+    rnn_pitch_search_range(st->pitch_lp+(PITCH_MAX_PERIOD>>1), st->pitch_lp, PITCH_FRAME_SIZE,
+                 PITCH_MAX_PERIOD-3*PITCH_MIN_PERIOD, IMAX(0, st->last_lag-radius),
+                 IMIN(PITCH_MAX_PERIOD-3*PITCH_MIN_PERIOD, st->last_lag+radius+1), &pitch_index, st->arch);
+    st->tracked_frames++;
+  } else {
+    rnn_pitch_search(st->pitch_lp+(PITCH_MAX_PERIOD>>1), st->pitch_lp, PITCH_FRAME_SIZE,
+                 PITCH_MAX_PERIOD-3*PITCH_MIN_PERIOD, &pitch_index, st->arch);
+    st->tracked_frames = 0;
+  }
+  st->last_lag = pitch_index;
   pitch_index = PITCH_MAX_PERIOD-pitch_index;
 
-  gain = rnn_remove_doubling(pitch_buf, PITCH_MAX_PERIOD, PITCH_MIN_PERIOD,
+  gain = rnn_remove_doubling(st->pitch_lp, PITCH_MAX_PERIOD, PITCH_MIN_PERIOD,
           PITCH_FRAME_SIZE, &pitch_index, st->last_period, st->last_gain);
   st->last_period = pitch_index;
   st->last_gain = gain;
-  for (i=0;i<WINDOW_SIZE;i++)
-    p[i] = st->pitch_buf[PITCH_BUF_SIZE-WINDOW_SIZE-pitch_index+i];
-  apply_window(p);
-  forward_transform(P, p);
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_PITCH_SEARCH, t);
+  forward_transform(P, &st->pitch_buf[PITCH_BUF_SIZE-WINDOW_SIZE-pitch_index], st->arch);
   compute_band_energy(Ep, P);
   compute_band_corr(Exp, X, P);
-  for (i=0;i<NB_BANDS;i++) Exp[i] = Exp[i]/sqrt(.001+Ex[i]*Ep[i]);
+  for (i=0;i<NB_BANDS;i++) Exp[i] = Exp[i]*rsqrt_approx(.001f+Ex[i]*Ep[i]);
   dct(&features[NB_BANDS], Exp);
   features[2*NB_BANDS] = .01*(pitch_index-300);
   logMax = -2;
   follow = -2;
+  for (i=0;i<NB_BANDS;i++) Ly[i] = log10_approx(1e-2f+Ex[i]);
   for (i=0;i<NB_BANDS;i++) {
-    Ly[i] = log10(1e-2+Ex[i]);
     Ly[i] = MAX16(logMax-7, MAX16(follow-1.5, Ly[i]));
     logMax = MAX16(logMax, Ly[i]);
     follow = MAX16(follow-1.5, Ly[i]);
@@ -389,43 +609,71 @@ int rnn_compute_frame_features(DenoiseState *st, kiss_fft_cpx *X, kiss_fft_cpx *
   if (!TRAINING && E < 0.04) {
     /* If there's no audio, avoid messing up the state. */
     RNN_CLEAR(features, NB_FEATURES);
+    RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_FEATURES, t);
     return 1;
   }
   dct(features, Ly);
   features[0] -= 12;
   features[1] -= 4;
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_FEATURES, t);
   return TRAINING && E < 0.1;
 }
 
-static void frame_synthesis(DenoiseState *st, float *out, const kiss_fft_cpx *y) {
+/* Sample i of a frame in the given format, at 16 bit scale. */
+static OPUS_INLINE float load_sample(const void *x, int i, int format) {
+  if (format == SAMPLES_INT16) return ((const short *)x)[i];
+  if (format == SAMPLES_NORMALIZED) return ((const float *)x)[i]*SAMPLE_SCALE;
+  return ((const float *)x)[i];
+}
+
+static OPUS_INLINE void store_sample(void *y, int i, float value, int format) {
+  if (format == SAMPLES_INT16) {
+    ((short *)y)[i] = (short)floor(.5f + MIN32(32767.f, MAX32(-32768.f, value)));
+  } else if (format == SAMPLES_NORMALIZED) {
+    ((float *)y)[i] = value/SAMPLE_SCALE;
+  } else {
+    ((float *)y)[i] = value;
+  }
+}
+
+/* Frame f of a buffer of consecutive frames in the given format. */
+static OPUS_INLINE const void *frame_at(const void *x, int f, int format) {
+  if (format == SAMPLES_INT16) return (const short *)x + f*FRAME_SIZE;
+  return (const float *)x + f*FRAME_SIZE;
+}
+
+static void frame_synthesis(DenoiseState *st, void *out, const kiss_fft_cpx *y, int format) {
   float x[WINDOW_SIZE];
   int i;
-  inverse_transform(x, y);
-  apply_window(x);
-  for (i=0;i<FRAME_SIZE;i++) out[i] = x[i] + st->synthesis_mem[i];
+  inverse_transform(x, y, st->arch);
+  for (i=0;i<FRAME_SIZE;i++) store_sample(out, i, x[i] + st->synthesis_mem[i], format);
   RNN_COPY(st->synthesis_mem, &x[FRAME_SIZE], FRAME_SIZE);
 }
 
-void rnn_biquad(float *y, float mem[2], const float *x, const float *b, const float *a, int N) {
+static OPUS_INLINE void biquad(float *y, float mem[2], const void *x, int format, const float *b, const float *a, int N) {
   int i;
   for (i=0;i<N;i++) {
     float xi, yi;
-    xi = x[i];
-    yi = x[i] + mem[0];
+    xi = load_sample(x, i, format);
+    yi = xi + mem[0];
     mem[0] = mem[1] + (b[0]*(double)xi - a[0]*(double)yi);
     mem[1] = (b[1]*(double)xi - a[1]*(double)yi);
     y[i] = yi;
   }
 }
 
+void rnn_biquad(float *y, float mem[2], const float *x, const float *b, const float *a, int N) {
+  biquad(y, mem, x, SAMPLES_SHORT_SCALE, b, a, N);
+}
+
 void rnn_pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const float *Ep,
                   const float *Exp, const float *g) {
   int i;
   float r[NB_BANDS];
-  float rf[FREQ_SIZE] = {0};
+  float rf[FREQ_SIZE];
   float newE[NB_BANDS];
   float norm[NB_BANDS];
-  float normf[FREQ_SIZE]={0};
+  float normf[FREQ_SIZE];
   for (i=0;i<NB_BANDS;i++) {
 #if 0
     if (Exp[i]>g[i]) r[i] = 1;
@@ -454,28 +702,38 @@ void rnn_pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, c
   }
 }
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
-  int i;
+/* Results of the analysis half of rnnoise_process_frame(), consumed by
+   process_frame_synthesis() once the RNN has computed the gains. */
+typedef struct {
   kiss_fft_cpx X[FREQ_SIZE];
   kiss_fft_cpx P[FREQ_SIZE];
-  float x[FRAME_SIZE];
   float Ex[NB_BANDS], Ep[NB_BANDS];
   float Exp[NB_BANDS];
   float features[NB_FEATURES];
   float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
-  float vad_prob = 0;
+  float vad_prob;
   int silence;
+} FrameAnalysis;
+
+static void process_frame_analysis(DenoiseState *st, FrameAnalysis *fa, const void *in, int format) {
+  float x[FRAME_SIZE];
   static const float a_hp[2] = {-1.99599, 0.99600};
   static const float b_hp[2] = {-2, 1};
-  rnn_biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
-  silence = rnn_compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
+  RNN_PROFILE_DECL(t);
+  biquad(x, st->mem_hp_x, in, format, b_hp, a_hp, FRAME_SIZE);
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_BIQUAD, t);
+  fa->silence = rnn_compute_frame_features(st, fa->X, fa->P, fa->Ex, fa->Ep, fa->Exp, fa->features, x);
+  fa->vad_prob = 0;
+}
 
-  if (!silence) {
-#if !TRAINING
-    compute_rnn(&st->model, &st->rnn, g, &vad_prob, features, st->arch);
-#endif
+static void process_frame_synthesis(DenoiseState *st, FrameAnalysis *fa, void *out, int format) {
+  int i;
+  float gf[FREQ_SIZE];
+  float *g = fa->g;
+  RNN_PROFILE_DECL(t);
+  if (!fa->silence) {
     rnn_pitch_filter(st->delayed_X, st->delayed_P, st->delayed_Ex, st->delayed_Ep, st->delayed_Exp, g);
+    RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_PITCH_FILTER, t);
     for (i=0;i<NB_BANDS;i++) {
       float alpha = .6f;
       g[i] = MAX16(g[i], alpha*st->lastg[i]);
@@ -489,13 +747,190 @@ float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
     }
 #endif
   }
-  frame_synthesis(st, out, st->delayed_X);
-
-  RNN_COPY(st->delayed_X, X, FREQ_SIZE);
-  RNN_COPY(st->delayed_P, P, FREQ_SIZE);
-  RNN_COPY(st->delayed_Ex, Ex, NB_BANDS);
-  RNN_COPY(st->delayed_Ep, Ep, NB_BANDS);
-  RNN_COPY(st->delayed_Exp, Exp, NB_BANDS);
-  return vad_prob;
+  frame_synthesis(st, out, st->delayed_X, format);
+
+  RNN_COPY(st->delayed_X, fa->X, FREQ_SIZE);
+  RNN_COPY(st->delayed_P, fa->P, FREQ_SIZE);
+  RNN_COPY(st->delayed_Ex, fa->Ex, NB_BANDS);
+  RNN_COPY(st->delayed_Ep, fa->Ep, NB_BANDS);
+  RNN_COPY(st->delayed_Exp, fa->Exp, NB_BANDS);
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_FRAME_SYNTHESIS, t);
+}
+
+static float process_frame(DenoiseState *st, void *out, const void *in, int format) {
+  FrameAnalysis fa;
+  RNN_PROFILE_DECL(t);
+  process_frame_analysis(st, &fa, in, format);
+#if !TRAINING
+  if (!fa.silence) {
+    compute_rnn(&st->model->rnn, &st->rnn, fa.g, &fa.vad_prob, fa.features, st->arch);
+  }
+#endif
+  process_frame_synthesis(st, &fa, out, format);
+  RNN_PROFILE_LAP(&st->profile, RNNOISE_STAGE_TOTAL, t);
+  return fa.vad_prob;
+}
+
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+  return process_frame(st, out, in, SAMPLES_SHORT_SCALE);
+}
+
+float rnnoise_process_frame_normalized(DenoiseState *st, float *out, const float *in) {
+  return process_frame(st, out, in, SAMPLES_NORMALIZED);
+}
+
+float rnnoise_process_frame_int16(DenoiseState *st, short *out, const short *in) {
+  return process_frame(st, out, in, SAMPLES_INT16);
+}
+
+static void process_frame_batch(DenoiseState *const *st, void *const *out, const void *const *in, float *vad_prob, int count, int format) {
+  int i, k;
+  for (i=0;i<count;i+=MAX_BATCH) {
+    FrameAnalysis fa[MAX_BATCH];
+    int n = IMIN(MAX_BATCH, count-i);
+    RNN_PROFILE_DECL(t);
+    for (k=0;k<n;k++) process_frame_analysis(st[i+k], &fa[k], in[i+k], format);
+#if !TRAINING
+    {
+      RNNState *rnn[MAX_BATCH];
+      float *g[MAX_BATCH];
+      float *vad[MAX_BATCH];
+      const float *features[MAX_BATCH];
+      const DenoiseState *first = NULL;
+      int nb = 0;
+      for (k=0;k<n;k++) {
+        DenoiseState *s = st[i+k];
+        if (fa[k].silence) continue;
+        /* Only states running the same model can share the weight loads. */
+        if (first == NULL) first = s;
+        if (s->model != first->model) {
+          compute_rnn(&s->model->rnn, &s->rnn, fa[k].g, &fa[k].vad_prob, fa[k].features, s->arch);
+          continue;
+        }
+        rnn[nb] = &s->rnn;
+        g[nb] = fa[k].g;
+        vad[nb] = &fa[k].vad_prob;
+        features[nb] = fa[k].features;
+        nb++;
+      }
+      if (nb > 0) compute_rnn_batch(&first->model->rnn, rnn, g, vad, features, nb, first->arch);
+    }
+#endif
+    for (k=0;k<n;k++) {
+      process_frame_synthesis(st[i+k], &fa[k], out[i+k], format);
+      if (vad_prob != NULL) vad_prob[i+k] = fa[k].vad_prob;
+    }
+#ifdef RNNOISE_PROFILE
+    {
+      opus_uint64 elapsed = rnn_profile_now() - t;
+      for (k=0;k<n;k++) rnn_profile_record(&st[i+k]->profile, RNNOISE_STAGE_TOTAL, elapsed/n);
+    }
+#endif
+  }
+}
+
+void rnnoise_process_frame_batch(DenoiseState *const *st, float *const *out, const float *const *in, float *vad_prob, int count) {
+  process_frame_batch(st, (void *const *)out, (const void *const *)in, vad_prob, count, SAMPLES_SHORT_SCALE);
+}
+
+void rnnoise_process_frame_batch_normalized(DenoiseState *const *st, float *const *out, const float *const *in, float *vad_prob, int count) {
+  process_frame_batch(st, (void *const *)out, (const void *const *)in, vad_prob, count, SAMPLES_NORMALIZED);
+}
+
+static void process_frames(DenoiseState *st, void *out, const void *in, float *vad_prob, int nframes, int format) {
+  int i, k;
+  for (i=0;i<nframes;i+=MAX_BATCH) {
+    FrameAnalysis fa[MAX_BATCH];
+    int n = IMIN(MAX_BATCH, nframes-i);
+    RNN_PROFILE_DECL(t);
+    /* The analysis does not depend on the RNN output, so it is done for all the frames
+       before anything is written to out, which may be the same as in. */
+    for (k=0;k<n;k++) process_frame_analysis(st, &fa[k], frame_at(in, i+k, format), format);
+#if !TRAINING
+    {
+      float *g[MAX_BATCH];
+      float *vad[MAX_BATCH];
+      const float *features[MAX_BATCH];
+      int nb = 0;
+      /* Silent frames do not advance the RNN state, skipping them keeps the order. */
+      for (k=0;k<n;k++) {
+        if (fa[k].silence) continue;
+        g[nb] = fa[k].g;
+        vad[nb] = &fa[k].vad_prob;
+        features[nb] = fa[k].features;
+        nb++;
+      }
+      if (nb > 0) compute_rnn_frames(&st->model->rnn, &st->rnn, g, vad, features, nb, st->arch);
+    }
+#endif
+    for (k=0;k<n;k++) {
+      process_frame_synthesis(st, &fa[k], (void *)frame_at(out, i+k, format), format);
+      if (vad_prob != NULL) vad_prob[i+k] = fa[k].vad_prob;
+    }
+#ifdef RNNOISE_PROFILE
+    {
+      opus_uint64 elapsed = rnn_profile_now() - t;
+      for (k=0;k<n;k++) rnn_profile_record(&st->profile, RNNOISE_STAGE_TOTAL, elapsed/n);
+    }
+#endif
+  }
+}
+
+void rnnoise_process_frames(DenoiseState *st, float *out, const float *in, float *vad_prob, int nframes) {
+  process_frames(st, out, in, vad_prob, nframes, SAMPLES_SHORT_SCALE);
+}
+
+void rnnoise_process_frames_normalized(DenoiseState *st, float *out, const float *in, float *vad_prob, int nframes) {
+  process_frames(st, out, in, vad_prob, nframes, SAMPLES_NORMALIZED);
+}
+
+int rnnoise_get_stage_timings(DenoiseState *const *st, int count, RNNoiseStageTiming *timings) {
+#ifdef RNNOISE_PROFILE
+  int k;
+  RnnProfile merged;
+  if (count == 1) {
+    rnn_profile_summarize(&st[0]->profile, timings);
+    return 0;
+  }
+  RNN_CLEAR(&merged, 1);
+  for (k=0;k<count;k++) rnn_profile_merge(&merged, &st[k]->profile);
+  rnn_profile_summarize(&merged, timings);
+  return 0;
+#else
+  (void)st;
+  (void)count;
+  RNN_CLEAR(timings, RNNOISE_STAGE_COUNT);
+  return -1;
+#endif
+}
+
+void rnnoise_set_pitch_tracking(DenoiseState *st, int enabled) {
+  st->pitch_tracking = enabled != 0;
+  st->tracked_frames = 0;
+}
+
+void rnnoise_reset_stage_timings(DenoiseState *st) {
+#ifdef RNNOISE_PROFILE
+  RNN_CLEAR(&st->profile, 1);
+#else
+  (void)st;
+#endif
+}
+
+void rnnoise_get_memory_footprint(const DenoiseState *st, RNNoiseMemoryFootprint *footprint) {
+  /* The biggest stack buffers on the deepest path: frame analysis with the pitch
+     search, or the RNN layers, on top of the analysis results. */
+  int analysis_bytes = (2*WINDOW_SIZE + FRAME_SIZE + (PITCH_FRAME_SIZE>>2)
+      + ((PITCH_FRAME_SIZE+PITCH_MAX_PERIOD)>>2) + (PITCH_MAX_PERIOD>>1) + NB_BANDS)*sizeof(float);
+  int rnn_bytes = 2*MAX_NEURONS*sizeof(float);
+  /* rnnoise_process_frames() also keeps the GRU outputs of every frame. */
+  int rnn_frames_bytes = (2*MAX_NEURONS + GRU1_STATE_SIZE + GRU2_STATE_SIZE + GRU3_STATE_SIZE)*sizeof(float);
+  int synthesis_bytes = (2*FREQ_SIZE + WINDOW_SIZE + 4*NB_BANDS)*sizeof(float);
+  int frame_bytes = IMAX(analysis_bytes, IMAX(rnn_bytes, synthesis_bytes));
+  footprint->state_bytes = rnnoise_get_size();
+  footprint->model_bytes = st->model != NULL ? st->model->model_bytes : 0;
+  footprint->scratch_bytes = sizeof(FrameAnalysis) + frame_bytes;
+  footprint->batch_scratch_bytes = MAX_BATCH*sizeof(FrameAnalysis)
+      + IMAX(analysis_bytes, IMAX(MAX_BATCH*IMAX(rnn_bytes, rnn_frames_bytes), synthesis_bytes));
 }
 
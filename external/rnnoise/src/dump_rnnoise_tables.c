@@ -40,8 +40,10 @@ int main(void) {
   int i;
   FILE *file;
   kiss_fft_state *kfft;
+  kiss_fft_state *half_kfft;
   float half_window[OVERLAP_SIZE];
   float dct_table[NB_BANDS*NB_BANDS];
+  float band_frac[FREQ_SIZE];
 
   file=fopen("rnnoise_tables.c", "wb");
   fprintf(file, "/* The contents of this file was automatically generated by dump_rnnoise_tables.c*/\n\n");
@@ -81,6 +83,29 @@ int main(void) {
 
   fprintf(file, "};\n\n");
 
+  /* Half-length transform for the real FFT, shares the twiddles of the full one. */
+  half_kfft = rnn_fft_alloc_twiddles(WINDOW_SIZE/2, NULL, NULL, kfft, 0);
+
+  fprintf (file, "static const opus_int32 fft_half_bitrev[%d] = {\n", half_kfft->nfft);
+  for (i=0;i<half_kfft->nfft;i++)
+    fprintf (file, "%d,%c", half_kfft->bitrev[i],(i+16)%15==0?'\n':' ');
+  fprintf (file, "};\n\n");
+
+  fprintf(file, "const kiss_fft_state rnn_kfft_half = {\n");
+  fprintf(file, "%d, /* nfft */\n", half_kfft->nfft);
+  fprintf(file, "%#0.8gf, /* scale */\n", half_kfft->scale);
+  fprintf(file, "%d, /* shift */\n", half_kfft->shift);
+  fprintf(file, "{");
+  for (i=0;i<2*MAXFACTORS;i++) {
+    fprintf(file, "%d, ", half_kfft->factors[i]);
+  }
+  fprintf(file, "}, /* factors */\n");
+  fprintf(file, "fft_half_bitrev, /* bitrev*/\n");
+  fprintf(file, "fft_twiddles, /* twiddles*/\n");
+  fprintf(file, "(arch_fft_state *)&arch_fft, /* arch_fft*/\n");
+
+  fprintf(file, "};\n\n");
+
   for (i=0;i<OVERLAP_SIZE;i++)
     half_window[i] = sin(.5*M_PI*sin(.5*M_PI*(i+.5)/OVERLAP_SIZE) * sin(.5*M_PI*(i+.5)/OVERLAP_SIZE));
   fprintf(file, "const float rnn_half_window[] = {\n");
@@ -98,6 +123,18 @@ int main(void) {
   fprintf(file, "const float rnn_dct_table[] = {\n");
   for (i=0;i<NB_BANDS*NB_BANDS;i++)
     fprintf (file, "%#0.9gf,%c", dct_table[i],(i+6)%5==0?'\n':' ');
+  fprintf(file, "};\n\n");
+
+  /* Position of every bin within its band, the weight of the next band. */
+  for (i=0;i<NB_BANDS+1;i++) {
+    int j;
+    int band_size = eband20ms[i+1]-eband20ms[i];
+    for (j=0;j<band_size;j++)
+      band_frac[eband20ms[i] + j] = (float)j/band_size;
+  }
+  fprintf(file, "const float rnn_band_frac[] = {\n");
+  for (i=0;i<eband20ms[NB_BANDS+1];i++)
+    fprintf (file, "%#0.9gf,%c", band_frac[i],(i+6)%5==0?'\n':' ');
   fprintf(file, "};\n");
 
   fclose(file);
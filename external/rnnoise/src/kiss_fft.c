@@ -599,3 +599,107 @@ void rnn_ifft_c(const kiss_fft_state *st,const kiss_fft_cpx *fin,kiss_fft_cpx *f
    for (i=0;i<st->nfft;i++)
       fout[i].i = -fout[i].i;
 }
+
+#ifndef FIXED_POINT
+
+void rnn_real_fft(const kiss_fft_state *st, const float *window, const float *in, kiss_fft_cpx *out, int arch)
+{
+   int i;
+   int M = st->nfft;
+   int N = 2*M;
+   int tw_shift = st->shift-1;
+   /* The even samples go to the real parts and the odd ones to the imaginary parts. Half of
+      the scale of the half-length transform is the scale of a full-length one. */
+   float scale = .5f*st->scale;
+   celt_assert(st->shift >= 1);
+   if (window) {
+      for (i=0;i<M;i++)
+      {
+         int n = 2*i;
+         float w0 = n < M ? window[n] : window[N-1-n];
+         float w1 = n+1 < M ? window[n+1] : window[N-2-n];
+         out[st->bitrev[i]].r = scale*(in[n]*w0);
+         out[st->bitrev[i]].i = scale*(in[n+1]*w1);
+      }
+   } else {
+      for (i=0;i<M;i++)
+      {
+         out[st->bitrev[i]].r = scale*in[2*i];
+         out[st->bitrev[i]].i = scale*in[2*i+1];
+      }
+   }
+   rnn_fft_impl_arch(st, out, arch);
+
+   /* Split into the spectra of the even and odd samples and combine them, bins i and M-i
+      are computed from the same pair. */
+   {
+      kiss_fft_cpx z0 = out[0];
+      out[0].r = z0.r + z0.i;
+      out[0].i = 0;
+      out[M].r = z0.r - z0.i;
+      out[M].i = 0;
+   }
+   for (i=1;2*i<=M;i++)
+   {
+      kiss_fft_cpx a = out[i];
+      kiss_fft_cpx b = out[M-i];
+      kiss_twiddle_cpx w = st->twiddles[i<<tw_shift];
+      float er = .5f*(a.r + b.r);
+      float ei = .5f*(a.i - b.i);
+      float odr = .5f*(a.i + b.i);
+      float odi = .5f*(b.r - a.r);
+      float tr = w.r*odr - w.i*odi;
+      float ti = w.r*odi + w.i*odr;
+      out[i].r = er + tr;
+      out[i].i = ei + ti;
+      if (M-i != i) {
+         out[M-i].r = er - tr;
+         out[M-i].i = ti - ei;
+      }
+   }
+}
+
+void rnn_real_ifft(const kiss_fft_state *st, const float *window, const kiss_fft_cpx *in, float *out, int arch)
+{
+   int i;
+   int M = st->nfft;
+   int N = 2*M;
+   int tw_shift = st->shift-1;
+   /* The N output samples have room for the M complex values of the half-length transform. */
+   kiss_fft_cpx *z = (kiss_fft_cpx *)out;
+   celt_assert(st->shift >= 1);
+
+   /* Pack the spectra of the even and odd samples as a single one, conjugated so that the
+      forward transform computes the inverse. */
+   for (i=0;i<M;i++)
+   {
+      kiss_fft_cpx a = in[i];
+      kiss_fft_cpx b = in[M-i];
+      kiss_twiddle_cpx w = st->twiddles[i<<tw_shift];
+      float er = a.r + b.r;
+      float ei = a.i - b.i;
+      float dr = a.r - b.r;
+      float di = a.i + b.i;
+      float odr = dr*w.r + di*w.i;
+      float odi = di*w.r - dr*w.i;
+      z[st->bitrev[i]].r = er - odi;
+      z[st->bitrev[i]].i = -(ei + odr);
+   }
+   rnn_fft_impl_arch(st, z, arch);
+
+   if (window) {
+      for (i=0;i<M;i++)
+      {
+         int n = 2*i;
+         float x0 = z[i].r;
+         float x1 = -z[i].i;
+         out[n] = x0*(n < M ? window[n] : window[N-1-n]);
+         out[n+1] = x1*(n+1 < M ? window[n+1] : window[N-2-n]);
+      }
+   } else {
+      for (i=0;i<M;i++)
+         z[i].i = -z[i].i;
+   }
+}
+
+#endif /* FIXED_POINT */
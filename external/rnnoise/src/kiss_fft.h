@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "arch.h"
+#include "cpu_support.h"
 
 #include <stdlib.h>
 #define opus_alloc(x) malloc(x)
@@ -145,7 +146,50 @@ kiss_fft_state *rnn_fft_alloc(int nfft,void * mem,size_t * lenmem, int arch);
 void rnn_fft_c(const kiss_fft_state *cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout);
 void rnn_ifft_c(const kiss_fft_state *cfg,const kiss_fft_cpx *fin,kiss_fft_cpx *fout);
 
+/**
+ * rnn_real_fft(st,window,in,out)
+ *
+ * Forward FFT of 2*st->nfft real samples with the half-length complex transform st, which
+ * must share the twiddles of a transform of 2*st->nfft points (st->shift >= 1).
+ * window is the first half of a symmetric window applied to the input, or NULL.
+ * Writes the st->nfft+1 non-negative frequency bins, scaled like rnn_fft() of full length.
+ * */
+void rnn_real_fft(const kiss_fft_state *st, const float *window, const float *in, kiss_fft_cpx *out, int arch);
+
+/**
+ * rnn_real_ifft(st,window,in,out)
+ *
+ * Unscaled inverse of rnn_real_fft() from the st->nfft+1 bins of a Hermitian spectrum,
+ * the window is applied to the 2*st->nfft output samples.
+ * */
+void rnn_real_ifft(const kiss_fft_state *st, const float *window, const kiss_fft_cpx *in, float *out, int arch);
+
 void rnn_fft_impl(const kiss_fft_state *st,kiss_fft_cpx *fout);
+
+/* Vectorized rnn_fft_impl(), see kiss_fft_arch.h. They fall back to rnn_fft_impl() for plans
+   with stages that don't split into whole vectors. */
+void rnn_fft_impl_sse4_1(const kiss_fft_state *st,kiss_fft_cpx *fout);
+void rnn_fft_impl_avx2(const kiss_fft_state *st,kiss_fft_cpx *fout);
+void rnn_fft_impl_neon(const kiss_fft_state *st,kiss_fft_cpx *fout);
+
+/* The training tools don't link the RTCD tables. */
+#if defined(RNN_ENABLE_X86_RTCD) && !defined(TRAINING)
+
+extern void (*const RNN_FFT_IMPL[OPUS_ARCHMASK + 1])(const kiss_fft_state *st, kiss_fft_cpx *fout);
+#define rnn_fft_impl_arch(_st, _fout, arch) \
+         ((*RNN_FFT_IMPL[(arch)&OPUS_ARCHMASK])(_st, _fout))
+
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && !defined(DISABLE_NEON)
+
+#define rnn_fft_impl_arch(_st, _fout, arch) \
+         ((void)(arch), rnn_fft_impl_neon(_st, _fout))
+
+#else
+
+#define rnn_fft_impl_arch(_st, _fout, arch) \
+         ((void)(arch), rnn_fft_impl(_st, _fout))
+
+#endif
 void rnn_ifft_impl(const kiss_fft_state *st,kiss_fft_cpx *fout);
 
 void rnn_fft_free(const kiss_fft_state *cfg, int arch);
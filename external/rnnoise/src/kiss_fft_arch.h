@@ -0,0 +1,281 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Vectorized kiss_fft butterflies, included by the arch specific files like nnet_arch.h.
+   The includer defines RTCD_ARCH and a vector of FFT_VEC_SIZE complex values:
+   fft_vec, fft_vec_load(), fft_vec_store(), fft_vec_load_strided(), fft_vec_store_strided(),
+   fft_vec_load_twiddles(), fft_vec_add(), fft_vec_sub(), fft_vec_scale(), fft_vec_cmul()
+   and fft_vec_mul_minus_i().
+
+   Each butterfly works on FFT_VEC_SIZE independent columns at once and performs the same
+   operations in the same order as the C version in kiss_fft.c. */
+
+#ifndef KISS_FFT_ARCH_H
+#define KISS_FFT_ARCH_H
+
+#include "_kiss_fft_guts.h"
+
+#ifndef RTCD_SUF
+#define CAT_SUFFIX2(a,b) a ## b
+#define CAT_SUFFIX(a,b) CAT_SUFFIX2(a, b)
+#define RTCD_SUF(name) CAT_SUFFIX(name, RTCD_ARCH)
+#endif
+
+/* Radix 2 after a radix 4, m==4. */
+static void kf_bfly2_simd(kiss_fft_cpx *Fout, int N)
+{
+   int i;
+   const float tw = 0.7071067812f;
+   for (i=0;i<N;i+=FFT_VEC_SIZE)
+   {
+      kiss_fft_cpx *F = Fout + 8*i;
+      fft_vec f, x, t;
+
+      t = fft_vec_load_strided(F+4, 8);
+      f = fft_vec_load_strided(F, 8);
+      fft_vec_store_strided(F+4, 8, fft_vec_sub(f, t));
+      fft_vec_store_strided(F, 8, fft_vec_add(f, t));
+
+      x = fft_vec_load_strided(F+5, 8);
+      t = fft_vec_scale(fft_vec_add(x, fft_vec_mul_minus_i(x)), tw);
+      f = fft_vec_load_strided(F+1, 8);
+      fft_vec_store_strided(F+5, 8, fft_vec_sub(f, t));
+      fft_vec_store_strided(F+1, 8, fft_vec_add(f, t));
+
+      x = fft_vec_load_strided(F+6, 8);
+      t = fft_vec_mul_minus_i(x);
+      f = fft_vec_load_strided(F+2, 8);
+      fft_vec_store_strided(F+6, 8, fft_vec_sub(f, t));
+      fft_vec_store_strided(F+2, 8, fft_vec_add(f, t));
+
+      x = fft_vec_load_strided(F+7, 8);
+      t = fft_vec_scale(fft_vec_sub(fft_vec_mul_minus_i(x), x), tw);
+      f = fft_vec_load_strided(F+3, 8);
+      fft_vec_store_strided(F+7, 8, fft_vec_sub(f, t));
+      fft_vec_store_strided(F+3, 8, fft_vec_add(f, t));
+   }
+}
+
+/* Radix 4 with all twiddles 1, m==1. */
+static void kf_bfly4_degenerate_simd(kiss_fft_cpx *Fout, int N)
+{
+   int i;
+   for (i=0;i<N;i+=FFT_VEC_SIZE)
+   {
+      kiss_fft_cpx *F = Fout + 4*i;
+      fft_vec f0, f1, f2, f3, s0, s1;
+      f0 = fft_vec_load_strided(F, 4);
+      f1 = fft_vec_load_strided(F+1, 4);
+      f2 = fft_vec_load_strided(F+2, 4);
+      f3 = fft_vec_load_strided(F+3, 4);
+
+      s0 = fft_vec_sub(f0, f2);
+      f0 = fft_vec_add(f0, f2);
+      s1 = fft_vec_add(f1, f3);
+      fft_vec_store_strided(F+2, 4, fft_vec_sub(f0, s1));
+      fft_vec_store_strided(F, 4, fft_vec_add(f0, s1));
+      s1 = fft_vec_mul_minus_i(fft_vec_sub(f1, f3));
+      fft_vec_store_strided(F+1, 4, fft_vec_add(s0, s1));
+      fft_vec_store_strided(F+3, 4, fft_vec_sub(s0, s1));
+   }
+}
+
+static void kf_bfly4_simd(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_state *st,
+                          int m, int N, int mm)
+{
+   int i, j;
+   const int m2 = 2*m;
+   const int m3 = 3*m;
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F = Fout + i*mm;
+      for (j=0;j<m;j+=FFT_VEC_SIZE)
+      {
+         fft_vec f0, s0, s1, s2, s3, s4, s5;
+         s0 = fft_vec_cmul(fft_vec_load(F+j+m), fft_vec_load_twiddles(st->twiddles + j*fstride, fstride));
+         s1 = fft_vec_cmul(fft_vec_load(F+j+m2), fft_vec_load_twiddles(st->twiddles + 2*j*fstride, 2*fstride));
+         s2 = fft_vec_cmul(fft_vec_load(F+j+m3), fft_vec_load_twiddles(st->twiddles + 3*j*fstride, 3*fstride));
+         f0 = fft_vec_load(F+j);
+
+         s5 = fft_vec_sub(f0, s1);
+         f0 = fft_vec_add(f0, s1);
+         s3 = fft_vec_add(s0, s2);
+         s4 = fft_vec_mul_minus_i(fft_vec_sub(s0, s2));
+         fft_vec_store(F+j+m2, fft_vec_sub(f0, s3));
+         fft_vec_store(F+j, fft_vec_add(f0, s3));
+         fft_vec_store(F+j+m, fft_vec_add(s5, s4));
+         fft_vec_store(F+j+m3, fft_vec_sub(s5, s4));
+      }
+   }
+}
+
+static void kf_bfly3_simd(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_state *st,
+                          int m, int N, int mm)
+{
+   int i, k;
+   const int m2 = 2*m;
+   const float epi3 = st->twiddles[fstride*m].i;
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F = Fout + i*mm;
+      for (k=0;k<m;k+=FFT_VEC_SIZE)
+      {
+         fft_vec f0, fm, s0, s1, s2, s3;
+         s1 = fft_vec_cmul(fft_vec_load(F+k+m), fft_vec_load_twiddles(st->twiddles + k*fstride, fstride));
+         s2 = fft_vec_cmul(fft_vec_load(F+k+m2), fft_vec_load_twiddles(st->twiddles + 2*k*fstride, 2*fstride));
+         f0 = fft_vec_load(F+k);
+
+         s3 = fft_vec_add(s1, s2);
+         s0 = fft_vec_sub(s1, s2);
+         fm = fft_vec_sub(f0, fft_vec_scale(s3, .5f));
+         s0 = fft_vec_mul_minus_i(fft_vec_scale(s0, epi3));
+         fft_vec_store(F+k, fft_vec_add(f0, s3));
+         fft_vec_store(F+k+m2, fft_vec_add(fm, s0));
+         fft_vec_store(F+k+m, fft_vec_sub(fm, s0));
+      }
+   }
+}
+
+static void kf_bfly5_simd(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_state *st,
+                          int m, int N, int mm)
+{
+   int i, u;
+   const kiss_twiddle_cpx *tw = st->twiddles;
+   const kiss_twiddle_cpx ya = tw[fstride*m];
+   const kiss_twiddle_cpx yb = tw[fstride*2*m];
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F0 = Fout + i*mm;
+      kiss_fft_cpx *F1 = F0 + m;
+      kiss_fft_cpx *F2 = F0 + 2*m;
+      kiss_fft_cpx *F3 = F0 + 3*m;
+      kiss_fft_cpx *F4 = F0 + 4*m;
+      for (u=0;u<m;u+=FFT_VEC_SIZE)
+      {
+         fft_vec s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+         s0 = fft_vec_load(F0+u);
+         s1 = fft_vec_cmul(fft_vec_load(F1+u), fft_vec_load_twiddles(tw + u*fstride, fstride));
+         s2 = fft_vec_cmul(fft_vec_load(F2+u), fft_vec_load_twiddles(tw + 2*u*fstride, 2*fstride));
+         s3 = fft_vec_cmul(fft_vec_load(F3+u), fft_vec_load_twiddles(tw + 3*u*fstride, 3*fstride));
+         s4 = fft_vec_cmul(fft_vec_load(F4+u), fft_vec_load_twiddles(tw + 4*u*fstride, 4*fstride));
+
+         s7 = fft_vec_add(s1, s4);
+         s10 = fft_vec_sub(s1, s4);
+         s8 = fft_vec_add(s2, s3);
+         s9 = fft_vec_sub(s2, s3);
+
+         fft_vec_store(F0+u, fft_vec_add(s0, fft_vec_add(s7, s8)));
+
+         s5 = fft_vec_add(s0, fft_vec_add(fft_vec_scale(s7, ya.r), fft_vec_scale(s8, yb.r)));
+         s6 = fft_vec_mul_minus_i(fft_vec_add(fft_vec_scale(s10, ya.i), fft_vec_scale(s9, yb.i)));
+         fft_vec_store(F1+u, fft_vec_sub(s5, s6));
+         fft_vec_store(F4+u, fft_vec_add(s5, s6));
+
+         s11 = fft_vec_add(s0, fft_vec_add(fft_vec_scale(s7, yb.r), fft_vec_scale(s8, ya.r)));
+         s12 = fft_vec_mul_minus_i(fft_vec_sub(fft_vec_scale(s9, ya.i), fft_vec_scale(s10, yb.i)));
+         fft_vec_store(F2+u, fft_vec_add(s11, s12));
+         fft_vec_store(F3+u, fft_vec_sub(s11, s12));
+      }
+   }
+}
+
+/* Whether every stage splits into whole vectors, true for the rnnoise plans. */
+static int fft_simd_supported(const kiss_fft_state *st)
+{
+   int L = 0;
+   int N = 1;
+   int m;
+   do {
+      int p = st->factors[2*L];
+      m = st->factors[2*L+1];
+      if (p == 2) {
+         if (m != 4 || N % FFT_VEC_SIZE) return 0;
+      } else if (p == 4 && m == 1) {
+         if (N % FFT_VEC_SIZE) return 0;
+      } else if (m % FFT_VEC_SIZE) {
+         return 0;
+      }
+      N *= p;
+      L++;
+   } while (m != 1);
+   return 1;
+}
+
+void RTCD_SUF(rnn_fft_impl_)(const kiss_fft_state *st, kiss_fft_cpx *fout)
+{
+   int m2, m;
+   int p;
+   int L;
+   int fstride[MAXFACTORS];
+   int i;
+   int shift;
+
+   if (!fft_simd_supported(st)) {
+      rnn_fft_impl(st, fout);
+      return;
+   }
+
+   /* st->shift can be -1 */
+   shift = st->shift>0 ? st->shift : 0;
+
+   fstride[0] = 1;
+   L=0;
+   do {
+      p = st->factors[2*L];
+      m = st->factors[2*L+1];
+      fstride[L+1] = fstride[L]*p;
+      L++;
+   } while(m!=1);
+   m = st->factors[2*L-1];
+   for (i=L-1;i>=0;i--)
+   {
+      if (i!=0)
+         m2 = st->factors[2*i-1];
+      else
+         m2 = 1;
+      switch (st->factors[2*i])
+      {
+      case 2:
+         kf_bfly2_simd(fout, fstride[i]);
+         break;
+      case 4:
+         if (m==1)
+            kf_bfly4_degenerate_simd(fout, fstride[i]);
+         else
+            kf_bfly4_simd(fout,fstride[i]<<shift,st,m, fstride[i], m2);
+         break;
+      case 3:
+         kf_bfly3_simd(fout,fstride[i]<<shift,st,m, fstride[i], m2);
+         break;
+      case 5:
+         kf_bfly5_simd(fout,fstride[i]<<shift,st,m, fstride[i], m2);
+         break;
+      }
+      m = m2;
+   }
+}
+
+#endif /* KISS_FFT_ARCH_H */
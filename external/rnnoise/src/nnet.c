@@ -62,24 +62,28 @@ void compute_generic_dense(const LinearLayer *layer, float *output, const float
 
 #define MAX_RNN_NEURONS_ALL 1024
 
-void compute_generic_gru(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, int arch)
+int gru_can_fuse(const LinearLayer *input_weights, const LinearLayer *recurrent_weights)
+{
+  int N = recurrent_weights->nb_inputs;
+  return input_weights->float_weights != NULL && input_weights->weights_idx != NULL
+      && recurrent_weights->float_weights != NULL && recurrent_weights->weights_idx != NULL
+      && N%8 == 0 && N <= MAX_GRU_FUSED_NEURONS;
+}
+
+/* Rest of the GRU step once zrh has the input projection, which it is overwritten with. */
+static void gru_update(const LinearLayer *recurrent_weights, float *state, float *zrh, int arch)
 {
   int i;
   int N;
-  float zrh[3*MAX_RNN_NEURONS_ALL];
   float recur[3*MAX_RNN_NEURONS_ALL];
   float *z;
   float *r;
   float *h;
-  celt_assert(3*recurrent_weights->nb_inputs == recurrent_weights->nb_outputs);
-  celt_assert(input_weights->nb_outputs == recurrent_weights->nb_outputs);
   N = recurrent_weights->nb_inputs;
   z = zrh;
   r = &zrh[N];
   h = &zrh[2*N];
   celt_assert(recurrent_weights->nb_outputs <= 3*MAX_RNN_NEURONS_ALL);
-  celt_assert(in != state);
-  compute_linear(input_weights, zrh, in, arch);
   compute_linear(recurrent_weights, recur, state, arch);
   for (i=0;i<2*N;i++)
      zrh[i] += recur[i];
@@ -93,6 +97,20 @@ void compute_generic_gru(const LinearLayer *input_weights, const LinearLayer *re
      state[i] = h[i];
 }
 
+void compute_generic_gru(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, int arch)
+{
+  float zrh[3*MAX_RNN_NEURONS_ALL];
+  celt_assert(3*recurrent_weights->nb_inputs == recurrent_weights->nb_outputs);
+  celt_assert(input_weights->nb_outputs == recurrent_weights->nb_outputs);
+  celt_assert(in != state);
+  if (gru_can_fuse(input_weights, recurrent_weights)) {
+    compute_gru(input_weights, recurrent_weights, state, in, NULL, arch);
+    return;
+  }
+  compute_linear(input_weights, zrh, in, arch);
+  gru_update(recurrent_weights, state, zrh, arch);
+}
+
 void compute_glu(const LinearLayer *layer, float *output, const float *input, int arch)
 {
    int i;
@@ -121,3 +139,135 @@ void compute_generic_conv1d(const LinearLayer *layer, float *output, float *mem,
    compute_activation(output, output, layer->nb_outputs, activation, arch);
    if (layer->nb_inputs!=input_size) RNN_COPY(mem, &tmp[input_size], layer->nb_inputs-input_size);
 }
+
+void compute_generic_dense_batch(const LinearLayer *layer, float *const *output, const float *const *input, int nb, int activation, int arch)
+{
+   int k;
+   celt_assert(nb <= MAX_BATCH);
+   compute_linear_batch(layer, output, input, nb, arch);
+   for (k=0;k<nb;k++)
+      compute_activation(output[k], output[k], layer->nb_outputs, activation, arch);
+}
+
+/* Keeps the per-input scratch of the batched GRU at a reasonable stack size. */
+#define MAX_RNN_NEURONS_BATCH 512
+
+void compute_generic_gru_batch(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *const *state, const float *const *in, int nb, int arch)
+{
+  int i, k;
+  int N;
+  float zrh[MAX_BATCH][3*MAX_RNN_NEURONS_BATCH];
+  float recur[MAX_BATCH][3*MAX_RNN_NEURONS_BATCH];
+  float *zrh_ptr[MAX_BATCH];
+  float *recur_ptr[MAX_BATCH];
+  celt_assert(3*recurrent_weights->nb_inputs == recurrent_weights->nb_outputs);
+  celt_assert(input_weights->nb_outputs == recurrent_weights->nb_outputs);
+  celt_assert(nb <= MAX_BATCH);
+  N = recurrent_weights->nb_inputs;
+  if (N > MAX_RNN_NEURONS_BATCH) {
+    for (k=0;k<nb;k++) compute_generic_gru(input_weights, recurrent_weights, state[k], in[k], arch);
+    return;
+  }
+  for (k=0;k<nb;k++) {
+    celt_assert(in[k] != state[k]);
+    zrh_ptr[k] = zrh[k];
+    recur_ptr[k] = recur[k];
+  }
+  compute_linear_batch(input_weights, zrh_ptr, in, nb, arch);
+  if (gru_can_fuse(input_weights, recurrent_weights)) {
+    /* Same as compute_generic_gru() on every state, which uses the fused GRU too. */
+    for (k=0;k<nb;k++) compute_gru(input_weights, recurrent_weights, state[k], NULL, zrh[k], arch);
+    return;
+  }
+  compute_linear_batch(recurrent_weights, recur_ptr, (const float *const *)state, nb, arch);
+  for (k=0;k<nb;k++) {
+    float *z = zrh[k];
+    float *r = &zrh[k][N];
+    float *h = &zrh[k][2*N];
+    for (i=0;i<2*N;i++)
+       zrh[k][i] += recur[k][i];
+    compute_activation(zrh[k], zrh[k], 2*N, ACTIVATION_SIGMOID, arch);
+    for (i=0;i<N;i++)
+       h[i] += recur[k][2*N+i]*r[i];
+    compute_activation(h, h, N, ACTIVATION_TANH, arch);
+    for (i=0;i<N;i++)
+       h[i] = z[i]*state[k][i] + (1-z[i])*h[i];
+    for (i=0;i<N;i++)
+       state[k][i] = h[i];
+  }
+}
+
+void compute_generic_conv1d_batch(const LinearLayer *layer, float *const *output, float *const *mem, const float *const *input, int input_size, int nb, int activation, int arch)
+{
+   int k;
+   float tmp[MAX_BATCH][MAX_CONV_INPUTS_ALL];
+   const float *tmp_ptr[MAX_BATCH];
+   celt_assert(layer->nb_inputs <= MAX_CONV_INPUTS_ALL);
+   celt_assert(nb <= MAX_BATCH);
+   for (k=0;k<nb;k++) {
+      celt_assert(input[k] != output[k]);
+      if (layer->nb_inputs!=input_size) RNN_COPY(tmp[k], mem[k], layer->nb_inputs-input_size);
+      RNN_COPY(&tmp[k][layer->nb_inputs-input_size], input[k], input_size);
+      tmp_ptr[k] = tmp[k];
+   }
+   compute_linear_batch(layer, output, tmp_ptr, nb, arch);
+   for (k=0;k<nb;k++) {
+      compute_activation(output[k], output[k], layer->nb_outputs, activation, arch);
+      if (layer->nb_inputs!=input_size) RNN_COPY(mem[k], &tmp[k][input_size], layer->nb_inputs-input_size);
+   }
+}
+
+void compute_generic_conv1d_frames(const LinearLayer *layer, float *const *output, float *mem, const float *const *input, int input_size, int nb, int activation, int arch)
+{
+   int k;
+   int mem_size;
+   float tmp[MAX_BATCH][MAX_CONV_INPUTS_ALL];
+   const float *tmp_ptr[MAX_BATCH];
+   celt_assert(layer->nb_inputs <= MAX_CONV_INPUTS_ALL);
+   celt_assert(nb <= MAX_BATCH);
+   mem_size = layer->nb_inputs-input_size;
+   for (k=0;k<nb;k++) {
+      celt_assert(input[k] != output[k]);
+      /* The memory of a frame is the end of the previous frame's input. */
+      if (mem_size != 0) RNN_COPY(tmp[k], k == 0 ? mem : &tmp[k-1][input_size], mem_size);
+      RNN_COPY(&tmp[k][mem_size], input[k], input_size);
+      tmp_ptr[k] = tmp[k];
+   }
+   compute_linear_batch(layer, output, tmp_ptr, nb, arch);
+   for (k=0;k<nb;k++)
+      compute_activation(output[k], output[k], layer->nb_outputs, activation, arch);
+   if (mem_size != 0) RNN_COPY(mem, &tmp[nb-1][input_size], mem_size);
+}
+
+void compute_generic_gru_frames(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, float *const *output, const float *const *in, int nb, int arch)
+{
+  int k;
+  int N;
+  float zrh[MAX_BATCH][3*MAX_RNN_NEURONS_BATCH];
+  float *zrh_ptr[MAX_BATCH];
+  celt_assert(3*recurrent_weights->nb_inputs == recurrent_weights->nb_outputs);
+  celt_assert(input_weights->nb_outputs == recurrent_weights->nb_outputs);
+  celt_assert(nb <= MAX_BATCH);
+  N = recurrent_weights->nb_inputs;
+  if (N > MAX_RNN_NEURONS_BATCH) {
+    for (k=0;k<nb;k++) {
+      compute_generic_gru(input_weights, recurrent_weights, state, in[k], arch);
+      RNN_COPY(output[k], state, N);
+    }
+    return;
+  }
+  for (k=0;k<nb;k++) {
+    celt_assert(in[k] != state);
+    zrh_ptr[k] = zrh[k];
+  }
+  /* Only the recurrent half needs the previous frame. */
+  compute_linear_batch(input_weights, zrh_ptr, in, nb, arch);
+  for (k=0;k<nb;k++) {
+    if (gru_can_fuse(input_weights, recurrent_weights)) {
+      compute_gru(input_weights, recurrent_weights, state, NULL, zrh[k], arch);
+    } else {
+      gru_update(recurrent_weights, state, zrh[k], arch);
+    }
+    RNN_COPY(output[k], state, N);
+  }
+}
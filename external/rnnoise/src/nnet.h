@@ -40,6 +40,9 @@
 
 #define WEIGHT_BLOB_VERSION 0
 #define WEIGHT_BLOCK_SIZE 64
+/* Blobs are parsed in place: records are padded to WEIGHT_BLOCK_SIZE, so with the blob
+   aligned to WEIGHT_BLOB_ALIGN every header and array is aligned for its type. */
+#define WEIGHT_BLOB_ALIGN 4
 typedef struct {
   const char *name;
   int type;
@@ -51,6 +54,8 @@ typedef struct {
 #define WEIGHT_TYPE_int 1
 #define WEIGHT_TYPE_qweight 2
 #define WEIGHT_TYPE_int8 3
+/* IEEE half precision, only for float weights. */
+#define WEIGHT_TYPE_float16 4
 
 typedef struct {
   char head[4];
@@ -67,6 +72,7 @@ typedef struct {
   const float *subias;
   const opus_int8 *weights;
   const float *float_weights;
+  const opus_uint16 *float16_weights;
   const int *weights_idx;
   const float *diag;
   const float *scale;
@@ -91,19 +97,31 @@ typedef struct {
 #define compute_generic_dense rnn_compute_generic_dense
 #define compute_generic_gru rnn_compute_generic_gru
 #define compute_generic_conv1d rnn_compute_generic_conv1d
+#define compute_generic_dense_batch rnn_compute_generic_dense_batch
+#define compute_generic_gru_batch rnn_compute_generic_gru_batch
+#define compute_generic_conv1d_batch rnn_compute_generic_conv1d_batch
+#define compute_generic_gru_frames rnn_compute_generic_gru_frames
+#define compute_generic_conv1d_frames rnn_compute_generic_conv1d_frames
 #define compute_glu rnn_compute_glu
+#define gru_can_fuse rnn_gru_can_fuse
 
 #define parse_weights rnn_parse_weights
 
 #define compute_linear_c rnn_compute_linear_c
+#define compute_linear_batch_c rnn_compute_linear_batch_c
 #define compute_activation_c rnn_compute_activation_c
 #define compute_conv2d_c rnn_compute_conv2d_c
+#define compute_gru_c rnn_compute_gru_c
 #define compute_linear_sse4_1 rnn_compute_linear_sse4_1
+#define compute_linear_batch_sse4_1 rnn_compute_linear_batch_sse4_1
 #define compute_activation_sse4_1 rnn_compute_activation_sse4_1
 #define compute_conv2d_sse4_1 rnn_compute_conv2d_sse4_1
+#define compute_gru_sse4_1 rnn_compute_gru_sse4_1
 #define compute_linear_avx2 rnn_compute_linear_avx2
+#define compute_linear_batch_avx2 rnn_compute_linear_batch_avx2
 #define compute_activation_avx2 rnn_compute_activation_avx2
 #define compute_conv2d_avx2 rnn_compute_conv2d_avx2
+#define compute_gru_avx2 rnn_compute_gru_avx2
 
 
 void compute_generic_dense(const LinearLayer *layer, float *output, const float *input, int activation, int arch);
@@ -111,6 +129,21 @@ void compute_generic_gru(const LinearLayer *input_weights, const LinearLayer *re
 void compute_generic_conv1d(const LinearLayer *layer, float *output, float *mem, const float *input, int input_size, int activation, int arch);
 void compute_glu(const LinearLayer *layer, float *output, const float *input, int arch);
 
+/* Batched versions of the layers above: apply the same layer to nb independent
+   inputs (each with its own state), loading the weights once for up to
+   MAX_BATCH inputs. Results are identical to calling the single versions. */
+#define MAX_BATCH 4
+void compute_generic_dense_batch(const LinearLayer *layer, float *const *output, const float *const *input, int nb, int activation, int arch);
+void compute_generic_gru_batch(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *const *state, const float *const *in, int nb, int arch);
+void compute_generic_conv1d_batch(const LinearLayer *layer, float *const *output, float *const *mem, const float *const *input, int input_size, int nb, int activation, int arch);
+
+/* The same layers over nb consecutive frames of a single state, up to MAX_BATCH. The input
+   projections of all frames are computed at once, only the GRU recurrent weights are applied
+   frame by frame. output gets the GRU state after every frame. Results are identical to
+   calling the single versions frame by frame. */
+void compute_generic_gru_frames(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, float *const *output, const float *const *in, int nb, int arch);
+void compute_generic_conv1d_frames(const LinearLayer *layer, float *const *output, float *mem, const float *const *input, int input_size, int nb, int activation, int arch);
+
 
 int parse_weights(WeightArray **list, const void *data, int len);
 
@@ -137,9 +170,19 @@ int conv2d_init(Conv2dLayer *layer, const WeightArray *arrays,
 
 
 void compute_linear_c(const LinearLayer *linear, float *out, const float *in);
+void compute_linear_batch_c(const LinearLayer *linear, float *const *out, const float *const *in, int nb);
 void compute_activation_c(float *output, const float *input, int N, int activation);
 void compute_conv2d_c(const Conv2dLayer *conv, float *out, float *mem, const float *in, int height, int hstride, int activation);
 
+/* Fused GRU step: for every block of 8 units the z, r and h rows of both weight matrices are
+   read once and the new state is computed right away, instead of going through the full
+   compute_linear() outputs. Only for float 8x4 sparse weights, see gru_can_fuse().
+   input_proj is the output of compute_linear() for input_weights and in when the caller already
+   has it (for several frames at once), in is not used then. NULL to compute it here. */
+#define MAX_GRU_FUSED_NEURONS 1024
+int gru_can_fuse(const LinearLayer *input_weights, const LinearLayer *recurrent_weights);
+void compute_gru_c(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, const float *input_proj);
+
 #ifdef RNN_ENABLE_X86_RTCD
 #include "x86/dnn_x86.h"
 #endif
@@ -148,6 +191,10 @@ void compute_conv2d_c(const Conv2dLayer *conv, float *out, float *mem, const flo
 #define compute_linear(linear, out, in, arch) ((void)(arch),compute_linear_c(linear, out, in))
 #endif
 
+#ifndef OVERRIDE_COMPUTE_LINEAR_BATCH
+#define compute_linear_batch(linear, out, in, nb, arch) ((void)(arch),compute_linear_batch_c(linear, out, in, nb))
+#endif
+
 #ifndef OVERRIDE_COMPUTE_ACTIVATION
 #define compute_activation(output, input, N, activation, arch) ((void)(arch),compute_activation_c(output, input, N, activation))
 #endif
@@ -156,6 +203,10 @@ void compute_conv2d_c(const Conv2dLayer *conv, float *out, float *mem, const flo
 #define compute_conv2d(conv, out, mem, in, height, hstride, activation, arch) ((void)(arch),compute_conv2d_c(conv, out, mem, in, height, hstride, activation))
 #endif
 
+#ifndef OVERRIDE_COMPUTE_GRU
+#define compute_gru(input_weights, recurrent_weights, state, in, input_proj, arch) ((void)(arch),compute_gru_c(input_weights, recurrent_weights, state, in, input_proj))
+#endif
+
 #if defined(__x86_64__) && !defined(RNN_ENABLE_X86_RTCD) && !defined(__AVX2__)
 #if defined(_MSC_VER)
 #pragma message ("Only SSE and SSE2 are available. On newer machines, enable SSSE3/AVX/AVX2 to get better performance")
@@ -138,6 +138,9 @@ void RTCD_SUF(compute_linear_) (const LinearLayer *linear, float *out, const flo
    if (linear->float_weights != NULL) {
      if (linear->weights_idx != NULL) sparse_sgemv8x4(out, linear->float_weights, linear->weights_idx, N, in);
      else sgemv(out, linear->float_weights, N, M, N, in);
+   } else if (linear->float16_weights != NULL) {
+     if (linear->weights_idx != NULL) sparse_hgemv8x4(out, linear->float16_weights, linear->weights_idx, N, in);
+     else hgemv(out, linear->float16_weights, N, M, N, in);
    } else if (linear->weights != NULL) {
      if (linear->weights_idx != NULL) sparse_cgemv8x4(out, linear->weights, linear->weights_idx, linear->scale, N, M, in);
      else cgemv8x4(out, linear->weights, linear->scale, N, M, in);
@@ -161,6 +164,122 @@ void RTCD_SUF(compute_linear_) (const LinearLayer *linear, float *out, const flo
    }
 }
 
+void RTCD_SUF(compute_linear_batch_) (const LinearLayer *linear, float *const *out, const float *const *in, int nb)
+{
+   int i, k, M, N;
+   const float *bias;
+   bias = linear->bias;
+   M = linear->nb_inputs;
+   N = linear->nb_outputs;
+   for (k=0;k<nb;k+=BATCH_MAX_INPUTS) {
+      int n = IMIN(BATCH_MAX_INPUTS, nb-k);
+      if (linear->float_weights != NULL) {
+        if (linear->weights_idx != NULL) sparse_sgemv8x4_batch(&out[k], linear->float_weights, linear->weights_idx, N, &in[k], n);
+        else sgemv_batch(&out[k], linear->float_weights, N, M, N, &in[k], n);
+      } else if (linear->float16_weights != NULL) {
+        if (linear->weights_idx != NULL) sparse_hgemv8x4_batch(&out[k], linear->float16_weights, linear->weights_idx, N, &in[k], n);
+        else hgemv_batch(&out[k], linear->float16_weights, N, M, N, &in[k], n);
+      } else if (linear->weights != NULL) {
+        if (linear->weights_idx != NULL) sparse_cgemv8x4_batch(&out[k], linear->weights, linear->weights_idx, linear->scale, N, M, &in[k], n);
+        else cgemv8x4_batch(&out[k], linear->weights, linear->scale, N, M, &in[k], n);
+      } else {
+        for (i=0;i<n;i++) RNN_CLEAR(out[k+i], N);
+      }
+   }
+#ifdef USE_SU_BIAS
+   /* Only use SU biases on for integer matrices on SU archs. */
+   if (linear->float_weights == NULL && linear->float16_weights == NULL && linear->weights != NULL) bias = linear->subias;
+#endif
+   for (k=0;k<nb;k++) {
+      celt_assert(in[k] != out[k]);
+      if (bias != NULL) {
+         for (i=0;i<N;i++) out[k][i] += bias[i];
+      }
+      if (linear->diag) {
+         /* Diag is only used for GRU recurrent weights. */
+         celt_assert(3*M == N);
+         for (i=0;i<M;i++) {
+            out[k][i] += linear->diag[i]*in[k][i];
+            out[k][i+M] += linear->diag[i+M]*in[k][i];
+            out[k][i+2*M] += linear->diag[i+2*M]*in[k][i];
+         }
+      }
+   }
+}
+
+/* Moves a cursor of an 8x4 sparse matrix over the given number of 8-row blocks. */
+static OPUS_INLINE void sparse8x4_skip(const float **w, const int **idx, int blocks)
+{
+   int i;
+   for (i=0;i<blocks;i++) {
+      int cols = **idx;
+      *idx += 1 + cols;
+      *w += 32*cols;
+   }
+}
+
+void RTCD_SUF(compute_gru_)(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, const float *input_proj)
+{
+   int i, j, k, N;
+   const float *w_in[3], *w_rec[3];
+   const int *idx_in[3], *idx_rec[3];
+   const float *bias_in, *bias_rec, *diag;
+   float new_state[MAX_GRU_FUSED_NEURONS];
+   celt_assert(gru_can_fuse(input_weights, recurrent_weights));
+   celt_assert(input_proj != NULL || in != state);
+   N = recurrent_weights->nb_inputs;
+   bias_in = input_proj == NULL ? input_weights->bias : NULL;
+   bias_rec = recurrent_weights->bias;
+   diag = recurrent_weights->diag;
+   /* The z, r and h rows are consecutive blocks of N rows in both matrices, every gate gets
+      its own cursor so that the three of them advance together, 8 units at a time. */
+   w_in[0] = input_weights->float_weights;
+   idx_in[0] = input_weights->weights_idx;
+   w_rec[0] = recurrent_weights->float_weights;
+   idx_rec[0] = recurrent_weights->weights_idx;
+   for (k=1;k<3;k++) {
+      w_in[k] = w_in[k-1];
+      idx_in[k] = idx_in[k-1];
+      sparse8x4_skip(&w_in[k], &idx_in[k], N/8);
+      w_rec[k] = w_rec[k-1];
+      idx_rec[k] = idx_rec[k-1];
+      sparse8x4_skip(&w_rec[k], &idx_rec[k], N/8);
+   }
+   for (i=0;i<N;i+=8) {
+      /* z, r and h of these 8 units, z and r next to each other for a single sigmoid call. */
+      float zrh[24];
+      float recur[24];
+      if (input_proj == NULL) {
+         sparse_sgemv8x4_gates(zrh, w_in, idx_in, in);
+      } else {
+         for (k=0;k<3;k++) RNN_COPY(&zrh[8*k], &input_proj[k*N + i], 8);
+      }
+      sparse_sgemv8x4_gates(recur, w_rec, idx_rec, state);
+      /* Same order as compute_linear(): bias first, then the diagonal. */
+      for (k=0;k<3;k++) {
+         if (bias_in != NULL) {
+            for (j=0;j<8;j++) zrh[8*k + j] += bias_in[k*N + i + j];
+         }
+         if (bias_rec != NULL) {
+            for (j=0;j<8;j++) recur[8*k + j] += bias_rec[k*N + i + j];
+         }
+         if (diag != NULL) {
+            for (j=0;j<8;j++) recur[8*k + j] += diag[k*N + i + j]*state[i + j];
+         }
+      }
+      for (j=0;j<16;j++)
+         zrh[j] += recur[j];
+      vec_sigmoid(zrh, zrh, 16);
+      for (j=0;j<8;j++)
+         zrh[16 + j] += recur[16 + j]*zrh[8 + j];
+      vec_tanh(&zrh[16], &zrh[16], 8);
+      /* The old state is still read by the next blocks. */
+      for (j=0;j<8;j++)
+         new_state[i + j] = zrh[j]*state[i + j] + (1-zrh[j])*zrh[16 + j];
+   }
+   RNN_COPY(state, new_state, N);
+}
+
 /* Computes non-padded convolution for input [ ksize1 x in_channels x (len2+ksize2) ],
    kernel [ out_channels x in_channels x ksize1 x ksize2 ],
    storing the output as [ out_channels x len2 ].
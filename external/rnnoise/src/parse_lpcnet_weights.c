@@ -39,6 +39,7 @@ static int parse_record(const void **data, int *len, WeightArray *array) {
   if (*len < WEIGHT_BLOCK_SIZE) return -1;
   if (h->block_size < h->size) return -1;
   if (h->block_size > *len-WEIGHT_BLOCK_SIZE) return -1;
+  if (h->block_size % WEIGHT_BLOCK_SIZE != 0) return -1;
   if (h->name[sizeof(h->name)-1] != 0) return -1;
   if (h->size < 0) return -1;
   array->name = h->name;
@@ -55,6 +56,10 @@ int parse_weights(WeightArray **list, const void *data, int len)
 {
   int nb_arrays=0;
   int capacity=20;
+  if (((size_t)data & (WEIGHT_BLOB_ALIGN-1)) != 0) {
+    *list = NULL;
+    return -1;
+  }
   *list = calloc(capacity*sizeof(WeightArray), 1);
   while (len > 0) {
     int ret;
@@ -132,10 +137,12 @@ int linear_init(LinearLayer *layer, const WeightArray *arrays,
   int nb_outputs)
 {
   int err;
+  int nb_weights;
   layer->bias = NULL;
   layer->subias = NULL;
   layer->weights = NULL;
   layer->float_weights = NULL;
+  layer->float16_weights = NULL;
   layer->weights_idx = NULL;
   layer->diag = NULL;
   layer->scale = NULL;
@@ -148,26 +155,32 @@ int linear_init(LinearLayer *layer, const WeightArray *arrays,
   if (weights_idx != NULL) {
     int total_blocks;
     if ((layer->weights_idx = find_idx_check(arrays, weights_idx, nb_inputs, nb_outputs, &total_blocks)) == NULL) return 1;
-    if (weights != NULL) {
-      if ((layer->weights = find_array_check(arrays, weights, SPARSE_BLOCK_SIZE*total_blocks*sizeof(layer->weights[0]))) == NULL) return 1;
-    }
-    if (float_weights != NULL) {
-      layer->float_weights = opt_array_check(arrays, float_weights, SPARSE_BLOCK_SIZE*total_blocks*sizeof(layer->float_weights[0]), &err);
-      if (err) return 1;
-    }
+    nb_weights = SPARSE_BLOCK_SIZE*total_blocks;
   } else {
-    if (weights != NULL) {
-      if ((layer->weights = find_array_check(arrays, weights, nb_inputs*nb_outputs*sizeof(layer->weights[0]))) == NULL) return 1;
-    }
-    if (float_weights != NULL) {
-      layer->float_weights = opt_array_check(arrays, float_weights, nb_inputs*nb_outputs*sizeof(layer->float_weights[0]), &err);
+    nb_weights = nb_inputs*nb_outputs;
+  }
+  if (float_weights != NULL) {
+    /* The float weights may be stored in half precision under the same name. */
+    const WeightArray *a = find_array_entry(arrays, float_weights);
+    if (a->name != NULL && a->type == WEIGHT_TYPE_float16) {
+      if (a->size != nb_weights*(int)sizeof(layer->float16_weights[0])) return 1;
+      layer->float16_weights = a->data;
+    } else {
+      layer->float_weights = opt_array_check(arrays, float_weights, nb_weights*sizeof(layer->float_weights[0]), &err);
       if (err) return 1;
     }
   }
+  if (weights != NULL) {
+    /* The int8 weights are only required when there are no float weights to run on. */
+    if (layer->float_weights != NULL || layer->float16_weights != NULL) {
+      layer->weights = opt_array_check(arrays, weights, nb_weights*sizeof(layer->weights[0]), &err);
+      if (err) return 1;
+    } else if ((layer->weights = find_array_check(arrays, weights, nb_weights*sizeof(layer->weights[0]))) == NULL) return 1;
+  }
   if (diag != NULL) {
     if ((layer->diag = find_array_check(arrays, diag, nb_outputs*sizeof(layer->diag[0]))) == NULL) return 1;
   }
-  if (weights != NULL) {
+  if (layer->weights != NULL) {
     if ((layer->scale = find_array_check(arrays, scale, nb_outputs*sizeof(layer->scale[0]))) == NULL) return 1;
   }
   layer->nb_inputs = nb_inputs;
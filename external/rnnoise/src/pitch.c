@@ -143,43 +143,30 @@ static void celt_fir5(const opus_val16 *x,
 }
 
 
-void rnn_pitch_downsample(celt_sig *x[], opus_val16 *x_lp,
-      int len, int C)
+void rnn_pitch_downsample(const celt_sig *x, opus_val16 *x_raw, opus_val16 *x_lp,
+      int len, int new_len, int arch)
 {
    int i;
+   int start;
    opus_val32 ac[5];
    opus_val16 tmp=Q15ONE;
-   opus_val16 lpc[4], mem[5]={0,0,0,0,0};
+   opus_val16 lpc[4], mem[5];
    opus_val16 lpc2[5];
    opus_val16 c1 = QCONST16(.8f,15);
-#ifdef FIXED_POINT
-   int shift;
-   opus_val32 maxabs = celt_maxabs32(x[0], len);
-   if (C==2)
-   {
-      opus_val32 maxabs_1 = celt_maxabs32(x[1], len);
-      maxabs = MAX32(maxabs, maxabs_1);
-   }
-   if (maxabs<1)
-      maxabs=1;
-   shift = celt_ilog2(maxabs)-10;
-   if (shift<0)
-      shift=0;
-   if (C==2)
-      shift++;
-#endif
-   for (i=1;i<len>>1;i++)
-      x_lp[i] = SHR32(HALF32(HALF32(x[0][(2*i-1)]+x[0][(2*i+1)])+x[0][2*i]), shift);
-   x_lp[0] = SHR32(HALF32(HALF32(x[0][1])+x[0][0]), shift);
-   if (C==2)
-   {
-      for (i=1;i<len>>1;i++)
-         x_lp[i] += SHR32(HALF32(HALF32(x[1][(2*i-1)]+x[1][(2*i+1)])+x[1][2*i]), shift);
-      x_lp[0] += SHR32(HALF32(HALF32(x[1][1])+x[1][0]), shift);
-   }
-
-   rnn_autocorr(x_lp, ac, NULL, 0,
-                  4, len>>1);
+   celt_assert(new_len <= len);
+   celt_assert((new_len&1) == 0);
+   len >>= 1;
+   start = len-(new_len>>1);
+   /* Decimated samples of the history don't change when they move, except for the first one
+      which has no left neighbour. */
+   RNN_MOVE(x_raw, &x_raw[new_len>>1], start);
+   RNN_MOVE(x_lp, &x_lp[new_len>>1], start);
+   for (i=IMAX(start, 1);i<len;i++)
+      x_raw[i] = HALF32(HALF32(x[(2*i-1)]+x[(2*i+1)])+x[2*i]);
+   x_raw[0] = HALF32(HALF32(x[1])+x[0]);
+
+   rnn_autocorr(x_raw, ac, NULL, 0,
+                  4, len, arch);
 
    /* Noise floor -40 dB */
 #ifdef FIXED_POINT
@@ -210,10 +197,14 @@ void rnn_pitch_downsample(celt_sig *x[], opus_val16 *x_lp,
    lpc2[2] = lpc[2] + MULT16_16_Q15(c1,lpc[1]);
    lpc2[3] = lpc[3] + MULT16_16_Q15(c1,lpc[2]);
    lpc2[4] = MULT16_16_Q15(c1,lpc[3]);
-   celt_fir5(x_lp, lpc2, x_lp, len>>1, mem);
+   /* The history was whitened by the filters of the previous frames, only the new samples
+      go through this one. Its memory is the input preceding them. */
+   for (i=0;i<5;i++)
+      mem[i] = start-1-i >= 0 ? x_raw[start-1-i] : 0;
+   celt_fir5(&x_raw[start], lpc2, &x_lp[start], len-start, mem);
 }
 
-void rnn_pitch_xcorr(const opus_val16 *_x, const opus_val16 *_y,
+void rnn_pitch_xcorr_c(const opus_val16 *_x, const opus_val16 *_y,
       opus_val32 *xcorr, int len, int max_pitch)
 {
 
@@ -279,10 +270,17 @@ void rnn_pitch_xcorr(const opus_val16 *_x, const opus_val16 *_y,
 }
 
 void rnn_pitch_search(const opus_val16 *x_lp, opus_val16 *y,
-                  int len, int max_pitch, int *pitch)
+                  int len, int max_pitch, int *pitch, int arch)
 {
-   int i, j;
+   rnn_pitch_search_range(x_lp, y, len, max_pitch, 0, max_pitch, pitch, arch);
+}
+
+void rnn_pitch_search_range(const opus_val16 *x_lp, opus_val16 *y,
+                  int len, int max_pitch, int start, int end, int *pitch, int arch)
+{
+   int i, j, k;
    int lag;
+   int start4, end4;
    int best_pitch[2]={0,0};
 #ifdef FIXED_POINT
    opus_val32 maxcorr;
@@ -298,7 +296,11 @@ void rnn_pitch_search(const opus_val16 *x_lp, opus_val16 *y,
    celt_assert(max_pitch <= PITCH_MAX_PERIOD);
    celt_assert(len>0);
    celt_assert(max_pitch>0);
+   celt_assert(start>=0 && start<end && end<=max_pitch);
    lag = len+max_pitch;
+   start4 = start>>2;
+   end4 = IMIN(max_pitch>>2, (end+3)>>2);
+   celt_assert(start4<end4);
 
 
    /* Downsample by 2 again */
@@ -329,36 +331,45 @@ void rnn_pitch_search(const opus_val16 *x_lp, opus_val16 *y,
 #ifdef FIXED_POINT
    maxcorr =
 #endif
-   rnn_pitch_xcorr(x_lp4, y_lp4, xcorr, len>>2, max_pitch>>2);
+   rnn_pitch_xcorr(x_lp4, y_lp4+start4, xcorr, len>>2, end4-start4, arch);
 
-   find_best_pitch(xcorr, y_lp4, len>>2, max_pitch>>2, best_pitch
+   find_best_pitch(xcorr, y_lp4+start4, len>>2, end4-start4, best_pitch
 #ifdef FIXED_POINT
                    , 0, maxcorr
 #endif
                    );
+   best_pitch[0] += start4;
+   best_pitch[1] += start4;
 
    /* Finer search with 2x decimation */
 #ifdef FIXED_POINT
    maxcorr=1;
-#endif
    for (i=0;i<max_pitch>>1;i++)
    {
       opus_val32 sum;
       xcorr[i] = 0;
       if (abs(i-2*best_pitch[0])>2 && abs(i-2*best_pitch[1])>2)
          continue;
-#ifdef FIXED_POINT
       sum = 0;
       for (j=0;j<len>>1;j++)
          sum += SHR32(MULT16_16(x_lp[j],y[i+j]), shift);
-#else
-      sum = celt_inner_prod(x_lp, y+i, len>>1);
-#endif
       xcorr[i] = MAX32(-1, sum);
-#ifdef FIXED_POINT
       maxcorr = MAX32(maxcorr, sum);
-#endif
    }
+#else
+   /* Only the lags around the two coarse candidates are needed. */
+   RNN_CLEAR(xcorr, max_pitch>>1);
+   for (k=0;k<2;k++)
+   {
+      int start = IMAX(0, 2*best_pitch[k]-2);
+      int end = IMIN(max_pitch>>1, 2*best_pitch[k]+3);
+      if (start >= end)
+         continue;
+      rnn_pitch_xcorr(x_lp, y+start, xcorr+start, len>>1, end-start, arch);
+      for (i=start;i<end;i++)
+         xcorr[i] = MAX32(-1, xcorr[i]);
+   }
+#endif
    find_best_pitch(xcorr, y, len>>1, max_pitch>>1, best_pitch
 #ifdef FIXED_POINT
                    , shift+1, maxcorr
@@ -35,12 +35,21 @@
 #define PITCH_H
 
 #include "arch.h"
+#include "cpu_support.h"
 
-void rnn_pitch_downsample(celt_sig *x[], opus_val16 *x_lp,
-      int len, int C);
+/* Updates the 2x decimated and whitened history x_lp (len>>1 samples) after new_len new
+   samples were appended to x (len samples). x_raw keeps the decimated samples before the
+   whitening filter, only the new samples are decimated and filtered. */
+void rnn_pitch_downsample(const celt_sig *x, opus_val16 *x_raw, opus_val16 *x_lp,
+      int len, int new_len, int arch);
 
 void rnn_pitch_search(const opus_val16 *x_lp, opus_val16 *y,
-                  int len, int max_pitch, int *pitch);
+                  int len, int max_pitch, int *pitch, int arch);
+
+/* rnn_pitch_search() that only considers the lags in [start, end), rounded out to the
+   4x decimation of the coarse search. */
+void rnn_pitch_search_range(const opus_val16 *x_lp, opus_val16 *y,
+                  int len, int max_pitch, int start, int end, int *pitch, int arch);
 
 opus_val16 rnn_remove_doubling(opus_val16 *x, int maxperiod, int minperiod,
       int N, int *T0, int prev_period, opus_val16 prev_gain);
@@ -141,7 +150,35 @@ static OPUS_INLINE opus_val32 celt_inner_prod(const opus_val16 *x,
    return xy;
 }
 
-void rnn_pitch_xcorr(const opus_val16 *_x, const opus_val16 *_y,
+void rnn_pitch_xcorr_c(const opus_val16 *_x, const opus_val16 *_y,
+      opus_val32 *xcorr, int len, int max_pitch);
+
+/* Vectorized rnn_pitch_xcorr_c(), see pitch_arch.h. */
+void rnn_pitch_xcorr_sse4_1(const opus_val16 *_x, const opus_val16 *_y,
+      opus_val32 *xcorr, int len, int max_pitch);
+void rnn_pitch_xcorr_avx2(const opus_val16 *_x, const opus_val16 *_y,
       opus_val32 *xcorr, int len, int max_pitch);
+void rnn_pitch_xcorr_neon(const opus_val16 *_x, const opus_val16 *_y,
+      opus_val32 *xcorr, int len, int max_pitch);
+
+/* The training tools don't link the RTCD tables. */
+#if defined(RNN_ENABLE_X86_RTCD) && !defined(TRAINING)
+
+extern void (*const RNN_PITCH_XCORR_IMPL[OPUS_ARCHMASK + 1])(const opus_val16 *_x,
+      const opus_val16 *_y, opus_val32 *xcorr, int len, int max_pitch);
+#define rnn_pitch_xcorr(_x, _y, xcorr, len, max_pitch, arch) \
+         ((*RNN_PITCH_XCORR_IMPL[(arch)&OPUS_ARCHMASK])(_x, _y, xcorr, len, max_pitch))
+
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && !defined(DISABLE_NEON)
+
+#define rnn_pitch_xcorr(_x, _y, xcorr, len, max_pitch, arch) \
+         ((void)(arch), rnn_pitch_xcorr_neon(_x, _y, xcorr, len, max_pitch))
+
+#else
+
+#define rnn_pitch_xcorr(_x, _y, xcorr, len, max_pitch, arch) \
+         ((void)(arch), rnn_pitch_xcorr_c(_x, _y, xcorr, len, max_pitch))
+
+#endif
 
 #endif
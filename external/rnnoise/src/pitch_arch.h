@@ -0,0 +1,82 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Vectorized pitch cross-correlation, included by the arch specific files like nnet_arch.h.
+   The includer defines RTCD_ARCH and a vector of XCORR_VEC_SIZE floats:
+   xcorr_vec, xcorr_vec_zero(), xcorr_vec_set1(), xcorr_vec_load(), xcorr_vec_store()
+   and xcorr_vec_mac().
+
+   Every lane accumulates one lag over j in the same order as xcorr_kernel(), so without
+   fused multiply-adds the results match rnn_pitch_xcorr_c() exactly. */
+
+#ifndef PITCH_ARCH_H
+#define PITCH_ARCH_H
+
+#include "pitch.h"
+
+#ifndef RTCD_SUF
+#define CAT_SUFFIX2(a,b) a ## b
+#define CAT_SUFFIX(a,b) CAT_SUFFIX2(a, b)
+#define RTCD_SUF(name) CAT_SUFFIX(name, RTCD_ARCH)
+#endif
+
+void RTCD_SUF(rnn_pitch_xcorr_)(const opus_val16 *_x, const opus_val16 *_y,
+      opus_val32 *xcorr, int len, int max_pitch)
+{
+   int i, j;
+   celt_assert(max_pitch>0);
+   /* Four vectors of lags at a time hide the latency of the accumulation. */
+   for (i=0;i<max_pitch-(4*XCORR_VEC_SIZE-1);i+=4*XCORR_VEC_SIZE)
+   {
+      xcorr_vec sum0, sum1, sum2, sum3;
+      sum0 = sum1 = sum2 = sum3 = xcorr_vec_zero();
+      for (j=0;j<len;j++)
+      {
+         const opus_val16 *y = _y+i+j;
+         xcorr_vec x = xcorr_vec_set1(_x[j]);
+         sum0 = xcorr_vec_mac(sum0, x, xcorr_vec_load(y));
+         sum1 = xcorr_vec_mac(sum1, x, xcorr_vec_load(y+XCORR_VEC_SIZE));
+         sum2 = xcorr_vec_mac(sum2, x, xcorr_vec_load(y+2*XCORR_VEC_SIZE));
+         sum3 = xcorr_vec_mac(sum3, x, xcorr_vec_load(y+3*XCORR_VEC_SIZE));
+      }
+      xcorr_vec_store(xcorr+i, sum0);
+      xcorr_vec_store(xcorr+i+XCORR_VEC_SIZE, sum1);
+      xcorr_vec_store(xcorr+i+2*XCORR_VEC_SIZE, sum2);
+      xcorr_vec_store(xcorr+i+3*XCORR_VEC_SIZE, sum3);
+   }
+   for (;i<max_pitch-(XCORR_VEC_SIZE-1);i+=XCORR_VEC_SIZE)
+   {
+      xcorr_vec sum = xcorr_vec_zero();
+      for (j=0;j<len;j++)
+         sum = xcorr_vec_mac(sum, xcorr_vec_set1(_x[j]), xcorr_vec_load(_y+i+j));
+      xcorr_vec_store(xcorr+i, sum);
+   }
+   /* The C version still computes four lags at a time. */
+   if (i<max_pitch)
+      rnn_pitch_xcorr_c(_x, _y+i, xcorr+i, len, max_pitch-i);
+}
+
+#endif /* PITCH_ARCH_H */
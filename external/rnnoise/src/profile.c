@@ -0,0 +1,147 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "profile.h"
+
+static const char *const stage_names[RNNOISE_STAGE_COUNT] = {
+  "biquad",
+  "frame_analysis",
+  "pitch_search",
+  "features",
+  "rnn_conv1",
+  "rnn_conv2",
+  "rnn_gru1",
+  "rnn_gru2",
+  "rnn_gru3",
+  "rnn_output",
+  "pitch_filter",
+  "frame_synthesis",
+  "total"
+};
+
+const char *rnnoise_stage_name(int stage) {
+  if (stage < 0 || stage >= RNNOISE_STAGE_COUNT) return NULL;
+  return stage_names[stage];
+}
+
+#ifdef RNNOISE_PROFILE
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+opus_uint64 rnn_profile_now(void) {
+#if defined(_WIN32)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (opus_uint64)(counter.QuadPart / frequency.QuadPart * 1000000000
+                       + counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (opus_uint64)ts.tv_sec * 1000000000 + (opus_uint64)ts.tv_nsec;
+#endif
+}
+
+static int bucket_index(opus_uint64 ns) {
+  int msb = 0;
+  if (ns < (1 << RNN_PROFILE_SUB_BUCKET_BITS)) return (int)ns;
+  while ((ns >> msb) > 1) msb++;
+  /* The top bits below the leading one select the sub-bucket. */
+  return ((msb - RNN_PROFILE_SUB_BUCKET_BITS + 1) << RNN_PROFILE_SUB_BUCKET_BITS)
+         + (int)((ns >> (msb - RNN_PROFILE_SUB_BUCKET_BITS)) & ((1 << RNN_PROFILE_SUB_BUCKET_BITS) - 1));
+}
+
+/* Largest duration falling into the bucket. */
+static opus_uint64 bucket_upper_bound(int idx) {
+  int octave = idx >> RNN_PROFILE_SUB_BUCKET_BITS;
+  opus_uint64 sub = idx & ((1 << RNN_PROFILE_SUB_BUCKET_BITS) - 1);
+  int shift;
+  if (octave == 0) return sub;
+  shift = octave - 1;
+  return (((opus_uint64)(1 << RNN_PROFILE_SUB_BUCKET_BITS) + sub + 1) << shift) - 1;
+}
+
+void rnn_profile_record(RnnProfile *profile, int stage, opus_uint64 ns) {
+  RnnStageHistogram *h = &profile->stages[stage];
+  int idx = bucket_index(ns);
+  if (idx >= RNN_PROFILE_BUCKETS) idx = RNN_PROFILE_BUCKETS - 1;
+  if (h->count == 0 || ns < h->min_ns) h->min_ns = ns;
+  if (ns > h->max_ns) h->max_ns = ns;
+  h->count++;
+  h->sum_ns += ns;
+  h->buckets[idx]++;
+}
+
+void rnn_profile_merge(RnnProfile *dst, const RnnProfile *src) {
+  int stage, i;
+  for (stage=0;stage<RNNOISE_STAGE_COUNT;stage++) {
+    RnnStageHistogram *d = &dst->stages[stage];
+    const RnnStageHistogram *h = &src->stages[stage];
+    if (h->count == 0) continue;
+    if (d->count == 0 || h->min_ns < d->min_ns) d->min_ns = h->min_ns;
+    if (h->max_ns > d->max_ns) d->max_ns = h->max_ns;
+    d->count += h->count;
+    d->sum_ns += h->sum_ns;
+    for (i=0;i<RNN_PROFILE_BUCKETS;i++) d->buckets[i] += h->buckets[i];
+  }
+}
+
+void rnn_profile_summarize(const RnnProfile *profile, RNNoiseStageTiming *timings) {
+  int stage, i;
+  for (stage=0;stage<RNNOISE_STAGE_COUNT;stage++) {
+    const RnnStageHistogram *h = &profile->stages[stage];
+    RNNoiseStageTiming *t = &timings[stage];
+    opus_uint64 p99_rank, seen;
+    memset(t, 0, sizeof(*t));
+    if (h->count == 0) continue;
+    t->count = h->count;
+    t->min_ns = h->min_ns;
+    t->max_ns = h->max_ns;
+    t->mean_ns = h->sum_ns / h->count;
+    /* Upper bound of the smallest bucket which covers 99% of the samples. */
+    p99_rank = (h->count * 99 + 99) / 100;
+    seen = 0;
+    for (i=0;i<RNN_PROFILE_BUCKETS && seen < p99_rank;i++) {
+      seen += h->buckets[i];
+      t->p99_ns = bucket_upper_bound(i);
+    }
+    if (t->p99_ns > t->max_ns) t->p99_ns = t->max_ns;
+    if (t->p99_ns < t->min_ns) t->p99_ns = t->min_ns;
+  }
+}
+
+#endif
@@ -0,0 +1,77 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "rnnoise.h"
+#include "opus_types.h"
+
+#ifdef RNNOISE_PROFILE
+
+/* Durations are bucketed with 8 buckets per power of two, so the error of a
+   percentile read from the histogram is below 12.5%. */
+#define RNN_PROFILE_SUB_BUCKET_BITS 3
+#define RNN_PROFILE_BUCKETS (40 << RNN_PROFILE_SUB_BUCKET_BITS)
+
+typedef struct {
+  opus_uint64 count;
+  opus_uint64 sum_ns;
+  opus_uint64 min_ns;
+  opus_uint64 max_ns;
+  opus_uint32 buckets[RNN_PROFILE_BUCKETS];
+} RnnStageHistogram;
+
+typedef struct {
+  RnnStageHistogram stages[RNNOISE_STAGE_COUNT];
+} RnnProfile;
+
+opus_uint64 rnn_profile_now(void);
+
+void rnn_profile_record(RnnProfile *profile, int stage, opus_uint64 ns);
+
+void rnn_profile_merge(RnnProfile *dst, const RnnProfile *src);
+
+void rnn_profile_summarize(const RnnProfile *profile, RNNoiseStageTiming *timings);
+
+/* Records the time since t for the stage and restarts t, so consecutive
+   stages only read the clock once each. */
+#define RNN_PROFILE_DECL(t) opus_uint64 t = rnn_profile_now()
+#define RNN_PROFILE_LAP(profile, stage, t) do { \
+    opus_uint64 rnn_profile_now_ = rnn_profile_now(); \
+    rnn_profile_record(profile, stage, rnn_profile_now_ - (t)); \
+    (t) = rnn_profile_now_; \
+  } while (0)
+
+#else
+
+#define RNN_PROFILE_DECL(t)
+#define RNN_PROFILE_LAP(profile, stage, t) do {} while (0)
+
+#endif
+
+#endif /* PROFILE_H */
@@ -40,18 +40,113 @@
 
 #define INPUT_SIZE 42
 
+#ifdef RNNOISE_PROFILE
+/* A batch is timed as a whole, each of its frames gets an equal share. */
+#define RNN_PROFILE_LAP_BATCH(rnn, nb, stage, t) do { \
+    opus_uint64 rnn_profile_now_ = rnn_profile_now(); \
+    int rnn_profile_k_; \
+    for (rnn_profile_k_=0;rnn_profile_k_<(nb);rnn_profile_k_++) \
+      rnn_profile_record((rnn)[rnn_profile_k_]->profile, stage, (rnn_profile_now_ - (t))/(nb)); \
+    (t) = rnn_profile_now_; \
+  } while (0)
+#else
+#define RNN_PROFILE_LAP_BATCH(rnn, nb, stage, t) do {} while (0)
+#endif
+
 
 void compute_rnn(const RNNoise *model, RNNState *rnn, float *gains, float *vad, const float *input, int arch) {
   float tmp[MAX_NEURONS];
   float tmp2[MAX_NEURONS];
+  RNN_PROFILE_DECL(t);
   /*for (int i=0;i<INPUT_SIZE;i++) printf("%f ", input[i]);printf("\n");*/
   compute_generic_conv1d(&model->conv1, tmp, rnn->conv1_state, input, CONV1_IN_SIZE, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_CONV1, t);
   compute_generic_conv1d(&model->conv2, tmp2, rnn->conv2_state, tmp, CONV2_IN_SIZE, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_CONV2, t);
   compute_generic_gru(&model->gru1_input, &model->gru1_recurrent, rnn->gru1_state, tmp2, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_GRU1, t);
   compute_generic_gru(&model->gru2_input, &model->gru2_recurrent, rnn->gru2_state, rnn->gru1_state, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_GRU2, t);
   compute_generic_gru(&model->gru3_input, &model->gru3_recurrent, rnn->gru3_state, rnn->gru2_state, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_GRU3, t);
   compute_generic_dense(&model->dense_out, gains, rnn->gru3_state, ACTIVATION_SIGMOID, arch);
   compute_generic_dense(&model->vad_dense, vad, rnn->gru3_state, ACTIVATION_SIGMOID, arch);
+  RNN_PROFILE_LAP(rnn->profile, RNNOISE_STAGE_RNN_OUTPUT, t);
   /*for (int i=0;i<22;i++) printf("%f ", gains[i]);printf("\n");*/
   /*printf("%f\n", *vad);*/
 }
+
+void compute_rnn_batch(const RNNoise *model, RNNState *const *rnn, float *const *gains, float *const *vad, const float *const *input, int nb, int arch) {
+  int k;
+  float tmp[MAX_BATCH][MAX_NEURONS];
+  float tmp2[MAX_BATCH][MAX_NEURONS];
+  float *tmp_ptr[MAX_BATCH];
+  float *tmp2_ptr[MAX_BATCH];
+  float *conv1_state[MAX_BATCH];
+  float *conv2_state[MAX_BATCH];
+  float *gru1_state[MAX_BATCH];
+  float *gru2_state[MAX_BATCH];
+  float *gru3_state[MAX_BATCH];
+  RNN_PROFILE_DECL(t);
+  celt_assert(nb > 0 && nb <= MAX_BATCH);
+  for (k=0;k<nb;k++) {
+    tmp_ptr[k] = tmp[k];
+    tmp2_ptr[k] = tmp2[k];
+    conv1_state[k] = rnn[k]->conv1_state;
+    conv2_state[k] = rnn[k]->conv2_state;
+    gru1_state[k] = rnn[k]->gru1_state;
+    gru2_state[k] = rnn[k]->gru2_state;
+    gru3_state[k] = rnn[k]->gru3_state;
+  }
+  compute_generic_conv1d_batch(&model->conv1, tmp_ptr, conv1_state, input, CONV1_IN_SIZE, nb, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_CONV1, t);
+  compute_generic_conv1d_batch(&model->conv2, tmp2_ptr, conv2_state, (const float *const *)tmp_ptr, CONV2_IN_SIZE, nb, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_CONV2, t);
+  compute_generic_gru_batch(&model->gru1_input, &model->gru1_recurrent, gru1_state, (const float *const *)tmp2_ptr, nb, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_GRU1, t);
+  compute_generic_gru_batch(&model->gru2_input, &model->gru2_recurrent, gru2_state, (const float *const *)gru1_state, nb, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_GRU2, t);
+  compute_generic_gru_batch(&model->gru3_input, &model->gru3_recurrent, gru3_state, (const float *const *)gru2_state, nb, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_GRU3, t);
+  compute_generic_dense_batch(&model->dense_out, gains, (const float *const *)gru3_state, nb, ACTIVATION_SIGMOID, arch);
+  compute_generic_dense_batch(&model->vad_dense, vad, (const float *const *)gru3_state, nb, ACTIVATION_SIGMOID, arch);
+  RNN_PROFILE_LAP_BATCH(rnn, nb, RNNOISE_STAGE_RNN_OUTPUT, t);
+}
+
+void compute_rnn_frames(const RNNoise *model, RNNState *rnn, float *const *gains, float *const *vad, const float *const *input, int nb, int arch) {
+  int k;
+  float tmp[MAX_BATCH][MAX_NEURONS];
+  float tmp2[MAX_BATCH][MAX_NEURONS];
+  float gru1[MAX_BATCH][GRU1_STATE_SIZE];
+  float gru2[MAX_BATCH][GRU2_STATE_SIZE];
+  float gru3[MAX_BATCH][GRU3_STATE_SIZE];
+  float *tmp_ptr[MAX_BATCH];
+  float *tmp2_ptr[MAX_BATCH];
+  float *gru1_ptr[MAX_BATCH];
+  float *gru2_ptr[MAX_BATCH];
+  float *gru3_ptr[MAX_BATCH];
+  RNNState *frames[MAX_BATCH];
+  RNN_PROFILE_DECL(t);
+  celt_assert(nb > 0 && nb <= MAX_BATCH);
+  for (k=0;k<nb;k++) {
+    tmp_ptr[k] = tmp[k];
+    tmp2_ptr[k] = tmp2[k];
+    gru1_ptr[k] = gru1[k];
+    gru2_ptr[k] = gru2[k];
+    gru3_ptr[k] = gru3[k];
+    frames[k] = rnn;
+  }
+  compute_generic_conv1d_frames(&model->conv1, tmp_ptr, rnn->conv1_state, input, CONV1_IN_SIZE, nb, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_CONV1, t);
+  compute_generic_conv1d_frames(&model->conv2, tmp2_ptr, rnn->conv2_state, (const float *const *)tmp_ptr, CONV2_IN_SIZE, nb, ACTIVATION_TANH, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_CONV2, t);
+  compute_generic_gru_frames(&model->gru1_input, &model->gru1_recurrent, rnn->gru1_state, gru1_ptr, (const float *const *)tmp2_ptr, nb, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_GRU1, t);
+  compute_generic_gru_frames(&model->gru2_input, &model->gru2_recurrent, rnn->gru2_state, gru2_ptr, (const float *const *)gru1_ptr, nb, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_GRU2, t);
+  compute_generic_gru_frames(&model->gru3_input, &model->gru3_recurrent, rnn->gru3_state, gru3_ptr, (const float *const *)gru2_ptr, nb, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_GRU3, t);
+  compute_generic_dense_batch(&model->dense_out, gains, (const float *const *)gru3_ptr, nb, ACTIVATION_SIGMOID, arch);
+  compute_generic_dense_batch(&model->vad_dense, vad, (const float *const *)gru3_ptr, nb, ACTIVATION_SIGMOID, arch);
+  RNN_PROFILE_LAP_BATCH(frames, nb, RNNOISE_STAGE_RNN_OUTPUT, t);
+}
@@ -30,20 +30,35 @@
 #include "rnnoise.h"
 #include "rnnoise_data.h"
 
+#include "common.h"
 #include "opus_types.h"
+#include "profile.h"
 
 #define WEIGHTS_SCALE (1.f/256)
 
 #define MAX_NEURONS 1024
 
 
+/* Alignment of the layer states, a whole AVX register. */
+#define RNN_STATE_ALIGN 32
+
 typedef struct {
-  float conv1_state[CONV1_STATE_SIZE];
-  float conv2_state[CONV2_STATE_SIZE];
-  float gru1_state[GRU1_STATE_SIZE];
-  float gru2_state[GRU2_STATE_SIZE];
-  float gru3_state[GRU3_STATE_SIZE];
+  RNN_ALIGN(RNN_STATE_ALIGN) float conv1_state[CONV1_STATE_SIZE];
+  RNN_ALIGN(RNN_STATE_ALIGN) float conv2_state[CONV2_STATE_SIZE];
+  RNN_ALIGN(RNN_STATE_ALIGN) float gru1_state[GRU1_STATE_SIZE];
+  RNN_ALIGN(RNN_STATE_ALIGN) float gru2_state[GRU2_STATE_SIZE];
+  RNN_ALIGN(RNN_STATE_ALIGN) float gru3_state[GRU3_STATE_SIZE];
+#ifdef RNNOISE_PROFILE
+  /* Where the layer timings go, owned by the DenoiseState. */
+  RnnProfile *profile;
+#endif
 } RNNState;
 void compute_rnn(const RNNoise *model, RNNState *rnn, float *gains, float *vad, const float *input, int arch);
 
+/* Same as compute_rnn() for up to MAX_BATCH states sharing the same model. */
+void compute_rnn_batch(const RNNoise *model, RNNState *const *rnn, float *const *gains, float *const *vad, const float *const *input, int nb, int arch);
+
+/* Same as compute_rnn() for up to MAX_BATCH consecutive frames of a single state. */
+void compute_rnn_frames(const RNNoise *model, RNNState *rnn, float *const *gains, float *const *vad, const float *const *input, int nb, int arch);
+
 #endif /* RNN_H_ */
@@ -567,6 +567,51 @@ fft_twiddles, /* twiddles*/
 (arch_fft_state *)&arch_fft, /* arch_fft*/
 };
 
+static const opus_int32 fft_half_bitrev[480] = {
+0, 96, 192, 288, 384, 32, 128, 224, 320, 416, 64, 160, 256, 352, 448,
+8, 104, 200, 296, 392, 40, 136, 232, 328, 424, 72, 168, 264, 360, 456,
+16, 112, 208, 304, 400, 48, 144, 240, 336, 432, 80, 176, 272, 368, 464,
+24, 120, 216, 312, 408, 56, 152, 248, 344, 440, 88, 184, 280, 376, 472,
+4, 100, 196, 292, 388, 36, 132, 228, 324, 420, 68, 164, 260, 356, 452,
+12, 108, 204, 300, 396, 44, 140, 236, 332, 428, 76, 172, 268, 364, 460,
+20, 116, 212, 308, 404, 52, 148, 244, 340, 436, 84, 180, 276, 372, 468,
+28, 124, 220, 316, 412, 60, 156, 252, 348, 444, 92, 188, 284, 380, 476,
+1, 97, 193, 289, 385, 33, 129, 225, 321, 417, 65, 161, 257, 353, 449,
+9, 105, 201, 297, 393, 41, 137, 233, 329, 425, 73, 169, 265, 361, 457,
+17, 113, 209, 305, 401, 49, 145, 241, 337, 433, 81, 177, 273, 369, 465,
+25, 121, 217, 313, 409, 57, 153, 249, 345, 441, 89, 185, 281, 377, 473,
+5, 101, 197, 293, 389, 37, 133, 229, 325, 421, 69, 165, 261, 357, 453,
+13, 109, 205, 301, 397, 45, 141, 237, 333, 429, 77, 173, 269, 365, 461,
+21, 117, 213, 309, 405, 53, 149, 245, 341, 437, 85, 181, 277, 373, 469,
+29, 125, 221, 317, 413, 61, 157, 253, 349, 445, 93, 189, 285, 381, 477,
+2, 98, 194, 290, 386, 34, 130, 226, 322, 418, 66, 162, 258, 354, 450,
+10, 106, 202, 298, 394, 42, 138, 234, 330, 426, 74, 170, 266, 362, 458,
+18, 114, 210, 306, 402, 50, 146, 242, 338, 434, 82, 178, 274, 370, 466,
+26, 122, 218, 314, 410, 58, 154, 250, 346, 442, 90, 186, 282, 378, 474,
+6, 102, 198, 294, 390, 38, 134, 230, 326, 422, 70, 166, 262, 358, 454,
+14, 110, 206, 302, 398, 46, 142, 238, 334, 430, 78, 174, 270, 366, 462,
+22, 118, 214, 310, 406, 54, 150, 246, 342, 438, 86, 182, 278, 374, 470,
+30, 126, 222, 318, 414, 62, 158, 254, 350, 446, 94, 190, 286, 382, 478,
+3, 99, 195, 291, 387, 35, 131, 227, 323, 419, 67, 163, 259, 355, 451,
+11, 107, 203, 299, 395, 43, 139, 235, 331, 427, 75, 171, 267, 363, 459,
+19, 115, 211, 307, 403, 51, 147, 243, 339, 435, 83, 179, 275, 371, 467,
+27, 123, 219, 315, 411, 59, 155, 251, 347, 443, 91, 187, 283, 379, 475,
+7, 103, 199, 295, 391, 39, 135, 231, 327, 423, 71, 167, 263, 359, 455,
+15, 111, 207, 303, 399, 47, 143, 239, 335, 431, 79, 175, 271, 367, 463,
+23, 119, 215, 311, 407, 55, 151, 247, 343, 439, 87, 183, 279, 375, 471,
+31, 127, 223, 319, 415, 63, 159, 255, 351, 447, 95, 191, 287, 383, 479,
+};
+
+const kiss_fft_state rnn_kfft_half = {
+480, /* nfft */
+0.0020833334f, /* scale */
+1, /* shift */
+{5, 96, 3, 32, 4, 8, 2, 4, 4, 1, 0, 0, 0, 0, 0, 0, }, /* factors */
+fft_half_bitrev, /* bitrev*/
+fft_twiddles, /* twiddles*/
+(arch_fft_state *)&arch_fft, /* arch_fft*/
+};
+
 const float rnn_half_window[] = {
 4.20549168e-06f, 3.78491532e-05f, 0.000105135041f, 0.000206060256f, 0.000340620492f,
 0.000508809986f, 0.000710621476f, 0.000946046319f, 0.00121507444f, 0.00151769421f,
@@ -872,3 +917,86 @@ const float rnn_dct_table[] = {
 0.634393275f, -0.595699310f, 0.555570245f, -0.514102757f, 0.471396744f,
 -0.427555084f, 0.382683426f, -0.336889863f, 0.290284663f, -0.242980182f,
 0.195090324f, -0.146730468f, 0.0980171412f, -0.0490676761f, };
+
+const float rnn_band_frac[] = {
+0.00000000f, 0.500000000f, 0.00000000f, 0.500000000f, 0.00000000f,
+0.500000000f, 0.00000000f, 0.500000000f, 0.00000000f, 0.500000000f,
+0.00000000f, 0.500000000f, 0.00000000f, 0.333333343f, 0.666666687f,
+0.00000000f, 0.333333343f, 0.666666687f, 0.00000000f, 0.333333343f,
+0.666666687f, 0.00000000f, 0.333333343f, 0.666666687f, 0.00000000f,
+0.250000000f, 0.500000000f, 0.750000000f, 0.00000000f, 0.250000000f,
+0.500000000f, 0.750000000f, 0.00000000f, 0.250000000f, 0.500000000f,
+0.750000000f, 0.00000000f, 0.200000003f, 0.400000006f, 0.600000024f,
+0.800000012f, 0.00000000f, 0.166666672f, 0.333333343f, 0.500000000f,
+0.666666687f, 0.833333313f, 0.00000000f, 0.166666672f, 0.333333343f,
+0.500000000f, 0.666666687f, 0.833333313f, 0.00000000f, 0.142857149f,
+0.285714298f, 0.428571433f, 0.571428597f, 0.714285731f, 0.857142866f,
+0.00000000f, 0.125000000f, 0.250000000f, 0.375000000f, 0.500000000f,
+0.625000000f, 0.750000000f, 0.875000000f, 0.00000000f, 0.111111112f,
+0.222222224f, 0.333333343f, 0.444444448f, 0.555555582f, 0.666666687f,
+0.777777791f, 0.888888896f, 0.00000000f, 0.100000001f, 0.200000003f,
+0.300000012f, 0.400000006f, 0.500000000f, 0.600000024f, 0.699999988f,
+0.800000012f, 0.899999976f, 0.00000000f, 0.0909090936f, 0.181818187f,
+0.272727281f, 0.363636374f, 0.454545468f, 0.545454562f, 0.636363626f,
+0.727272749f, 0.818181813f, 0.909090936f, 0.00000000f, 0.0833333358f,
+0.166666672f, 0.250000000f, 0.333333343f, 0.416666657f, 0.500000000f,
+0.583333313f, 0.666666687f, 0.750000000f, 0.833333313f, 0.916666687f,
+0.00000000f, 0.0714285746f, 0.142857149f, 0.214285716f, 0.285714298f,
+0.357142866f, 0.428571433f, 0.500000000f, 0.571428597f, 0.642857134f,
+0.714285731f, 0.785714269f, 0.857142866f, 0.928571403f, 0.00000000f,
+0.0625000000f, 0.125000000f, 0.187500000f, 0.250000000f, 0.312500000f,
+0.375000000f, 0.437500000f, 0.500000000f, 0.562500000f, 0.625000000f,
+0.687500000f, 0.750000000f, 0.812500000f, 0.875000000f, 0.937500000f,
+0.00000000f, 0.0588235296f, 0.117647059f, 0.176470593f, 0.235294119f,
+0.294117659f, 0.352941185f, 0.411764711f, 0.470588237f, 0.529411793f,
+0.588235319f, 0.647058845f, 0.705882370f, 0.764705896f, 0.823529422f,
+0.882352948f, 0.941176474f, 0.00000000f, 0.0526315793f, 0.105263159f,
+0.157894731f, 0.210526317f, 0.263157904f, 0.315789461f, 0.368421048f,
+0.421052635f, 0.473684222f, 0.526315808f, 0.578947365f, 0.631578922f,
+0.684210539f, 0.736842096f, 0.789473712f, 0.842105269f, 0.894736826f,
+0.947368443f, 0.00000000f, 0.0454545468f, 0.0909090936f, 0.136363640f,
+0.181818187f, 0.227272734f, 0.272727281f, 0.318181813f, 0.363636374f,
+0.409090906f, 0.454545468f, 0.500000000f, 0.545454562f, 0.590909064f,
+0.636363626f, 0.681818187f, 0.727272749f, 0.772727251f, 0.818181813f,
+0.863636374f, 0.909090936f, 0.954545438f, 0.00000000f, 0.0399999991f,
+0.0799999982f, 0.119999997f, 0.159999996f, 0.200000003f, 0.239999995f,
+0.280000001f, 0.319999993f, 0.360000014f, 0.400000006f, 0.439999998f,
+0.479999989f, 0.519999981f, 0.560000002f, 0.600000024f, 0.639999986f,
+0.680000007f, 0.720000029f, 0.759999990f, 0.800000012f, 0.839999974f,
+0.879999995f, 0.920000017f, 0.959999979f, 0.00000000f, 0.0357142873f,
+0.0714285746f, 0.107142858f, 0.142857149f, 0.178571433f, 0.214285716f,
+0.250000000f, 0.285714298f, 0.321428567f, 0.357142866f, 0.392857134f,
+0.428571433f, 0.464285702f, 0.500000000f, 0.535714269f, 0.571428597f,
+0.607142866f, 0.642857134f, 0.678571403f, 0.714285731f, 0.750000000f,
+0.785714269f, 0.821428597f, 0.857142866f, 0.892857134f, 0.928571403f,
+0.964285731f, 0.00000000f, 0.0322580636f, 0.0645161271f, 0.0967741907f,
+0.129032254f, 0.161290318f, 0.193548381f, 0.225806445f, 0.258064508f,
+0.290322572f, 0.322580636f, 0.354838699f, 0.387096763f, 0.419354826f,
+0.451612890f, 0.483870953f, 0.516129017f, 0.548387110f, 0.580645144f,
+0.612903237f, 0.645161271f, 0.677419364f, 0.709677398f, 0.741935492f,
+0.774193525f, 0.806451619f, 0.838709652f, 0.870967746f, 0.903225780f,
+0.935483873f, 0.967741907f, 0.00000000f, 0.0285714287f, 0.0571428575f,
+0.0857142881f, 0.114285715f, 0.142857149f, 0.171428576f, 0.200000003f,
+0.228571430f, 0.257142872f, 0.285714298f, 0.314285725f, 0.342857152f,
+0.371428579f, 0.400000006f, 0.428571433f, 0.457142860f, 0.485714287f,
+0.514285743f, 0.542857170f, 0.571428597f, 0.600000024f, 0.628571451f,
+0.657142878f, 0.685714304f, 0.714285731f, 0.742857158f, 0.771428585f,
+0.800000012f, 0.828571439f, 0.857142866f, 0.885714293f, 0.914285719f,
+0.942857146f, 0.971428573f, 0.00000000f, 0.0256410260f, 0.0512820520f,
+0.0769230798f, 0.102564104f, 0.128205135f, 0.153846160f, 0.179487184f,
+0.205128208f, 0.230769232f, 0.256410271f, 0.282051295f, 0.307692319f,
+0.333333343f, 0.358974367f, 0.384615391f, 0.410256416f, 0.435897440f,
+0.461538464f, 0.487179488f, 0.512820542f, 0.538461566f, 0.564102590f,
+0.589743614f, 0.615384638f, 0.641025662f, 0.666666687f, 0.692307711f,
+0.717948735f, 0.743589759f, 0.769230783f, 0.794871807f, 0.820512831f,
+0.846153855f, 0.871794879f, 0.897435904f, 0.923076928f, 0.948717952f,
+0.974358976f, 0.00000000f, 0.0227272734f, 0.0454545468f, 0.0681818202f,
+0.0909090936f, 0.113636367f, 0.136363640f, 0.159090906f, 0.181818187f,
+0.204545453f, 0.227272734f, 0.250000000f, 0.272727281f, 0.295454532f,
+0.318181813f, 0.340909094f, 0.363636374f, 0.386363626f, 0.409090906f,
+0.431818187f, 0.454545468f, 0.477272719f, 0.500000000f, 0.522727251f,
+0.545454562f, 0.568181813f, 0.590909064f, 0.613636374f, 0.636363626f,
+0.659090936f, 0.681818187f, 0.704545438f, 0.727272749f, 0.750000000f,
+0.772727251f, 0.795454562f, 0.818181813f, 0.840909064f, 0.863636374f,
+0.886363626f, 0.909090936f, 0.931818187f, 0.954545438f, 0.977272749f,
+};
@@ -385,4 +385,117 @@ static inline void vec_sigmoid(float *y, const float *x, int N)
 #define SCALE_1 (1.f/128.f/127.f)
 
 #endif /*no optimizations*/
+
+#ifndef VEC_HAVE_FLOAT16
+/* Generic fallback for the half precision weights, converted one at a time. */
+static inline float float16_to_float(opus_uint16 h)
+{
+   union {
+      float f;
+      opus_uint32 i;
+   } u;
+   opus_uint32 sign = (opus_uint32)(h & 0x8000) << 16;
+   int exponent = (h >> 10) & 0x1f;
+   opus_uint32 mantissa = h & 0x3ff;
+   if (exponent == 0) {
+      /* Zero or subnormal. */
+      u.f = mantissa*(1.f/16777216);
+      u.i |= sign;
+   } else if (exponent == 31) {
+      u.i = sign | 0x7f800000 | (mantissa << 13);
+   } else {
+      u.i = sign | ((opus_uint32)(exponent + 112) << 23) | (mantissa << 13);
+   }
+   return u.f;
+}
+
+static inline void hgemv(float *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *x)
+{
+   int i, j;
+   RNN_CLEAR(out, rows);
+   for (j=0;j<cols;j++)
+   {
+      const opus_uint16 *w = &weights[j*col_stride];
+      float xj = x[j];
+      for (i=0;i<rows;i++) out[i] += float16_to_float(w[i])*xj;
+   }
+}
+
+static inline void sparse_hgemv8x4(float *out, const opus_uint16 *w, const int *idx, int rows, const float *x)
+{
+   int i, j, k;
+   RNN_CLEAR(out, rows);
+   for (i=0;i<rows;i+=8)
+   {
+      int cols;
+      cols = *idx++;
+      for (j=0;j<cols;j++)
+      {
+         int pos = *idx++;
+         for (k=0;k<32;k++) out[i + (k&7)] += float16_to_float(w[k])*x[pos + (k>>3)];
+         w += 32;
+      }
+   }
+}
+#endif
+
+#ifndef VEC_HAVE_FLOAT16_BATCH
+static inline void hgemv_batch(float *const *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) hgemv(out[k], weights, rows, cols, col_stride, x[k]);
+}
+
+static inline void sparse_hgemv8x4_batch(float *const *out, const opus_uint16 *weights, const int *idx, int rows, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) sparse_hgemv8x4(out[k], weights, idx, rows, x[k]);
+}
+#endif
+
+#ifndef VEC_HAVE_BATCH
+/* Generic fallback for the batched kernels: apply the single-vector kernel to
+   each input in turn. */
+#define BATCH_MAX_INPUTS 4
+
+static inline void sgemv_batch(float *const *out, const float *weights, int rows, int cols, int col_stride, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) sgemv(out[k], weights, rows, cols, col_stride, x[k]);
+}
+
+static inline void sparse_sgemv8x4_batch(float *const *out, const float *weights, const int *idx, int rows, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) sparse_sgemv8x4(out[k], weights, idx, rows, x[k]);
+}
+
+static inline void sparse_cgemv8x4_batch(float *const *out, const opus_int8 *w, const int *idx, const float *scale, int rows, int cols, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) sparse_cgemv8x4(out[k], w, idx, scale, rows, cols, x[k]);
+}
+
+static inline void cgemv8x4_batch(float *const *out, const opus_int8 *w, const float *scale, int rows, int cols, const float *const *x, int nb)
+{
+   int k;
+   for (k=0;k<nb;k++) cgemv8x4(out[k], w, scale, rows, cols, x[k]);
+}
+#endif
+
+#ifndef VEC_HAVE_GATES
+/* Generic fallback for the fused GRU: the next 8-row block of three 8x4 sparse matrices, one
+   after the other. The cursors move past the blocks. */
+static inline void sparse_sgemv8x4_gates(float *out, const float **weights, const int **idx, const float *x)
+{
+   int k;
+   for (k=0;k<3;k++) {
+      int cols = *idx[k];
+      sparse_sgemv8x4(&out[8*k], weights[k], idx[k], 8, x);
+      idx[k] += 1 + cols;
+      weights[k] += 32*cols;
+   }
+}
+#endif
+
 #endif /*VEC_H*/
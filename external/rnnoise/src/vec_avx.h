@@ -775,6 +775,63 @@ static inline void sparse_sgemv8x4(float *out, const float *weights, const int *
    }
 }
 
+static inline __m256 sparse8x4_block(__m256 vy, const float *weights, const float *x)
+{
+   vy = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[0]), _mm256_broadcast_ss(&x[0]), vy);
+   vy = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[8]), _mm256_broadcast_ss(&x[1]), vy);
+   vy = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[16]), _mm256_broadcast_ss(&x[2]), vy);
+   vy = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[24]), _mm256_broadcast_ss(&x[3]), vy);
+   return vy;
+}
+
+/* The next 8-row block of three 8x4 sparse matrices (the GRU gates) over the same input, out
+   gets 24 values. The three accumulations are interleaved so that they don't wait on each
+   other, every output is still summed in the same order as sparse_sgemv8x4(). The cursors
+   move past the blocks. */
+#define VEC_HAVE_GATES
+static inline void sparse_sgemv8x4_gates(float *out, const float **weights, const int **idx, const float *x)
+{
+   int j, n;
+   int cols0, cols1, cols2;
+   const float *w0, *w1, *w2;
+   const int *idx0, *idx1, *idx2;
+   __m256 vy0, vy1, vy2;
+   w0 = weights[0];
+   w1 = weights[1];
+   w2 = weights[2];
+   idx0 = idx[0];
+   idx1 = idx[1];
+   idx2 = idx[2];
+   cols0 = *idx0++;
+   cols1 = *idx1++;
+   cols2 = *idx2++;
+   vy0 = _mm256_setzero_ps();
+   vy1 = _mm256_setzero_ps();
+   vy2 = _mm256_setzero_ps();
+   n = IMIN(cols0, IMIN(cols1, cols2));
+   for (j=0;j<n;j++)
+   {
+      vy0 = sparse8x4_block(vy0, w0, &x[*idx0++]);
+      vy1 = sparse8x4_block(vy1, w1, &x[*idx1++]);
+      vy2 = sparse8x4_block(vy2, w2, &x[*idx2++]);
+      w0 += 32;
+      w1 += 32;
+      w2 += 32;
+   }
+   for (j=n;j<cols0;j++,w0+=32) vy0 = sparse8x4_block(vy0, w0, &x[*idx0++]);
+   for (j=n;j<cols1;j++,w1+=32) vy1 = sparse8x4_block(vy1, w1, &x[*idx1++]);
+   for (j=n;j<cols2;j++,w2+=32) vy2 = sparse8x4_block(vy2, w2, &x[*idx2++]);
+   _mm256_storeu_ps(&out[0], vy0);
+   _mm256_storeu_ps(&out[8], vy1);
+   _mm256_storeu_ps(&out[16], vy2);
+   weights[0] = w0;
+   weights[1] = w1;
+   weights[2] = w2;
+   idx[0] = idx0;
+   idx[1] = idx1;
+   idx[2] = idx2;
+}
+
 static inline void sparse_cgemv8x4(float *_out, const opus_int8 *w, const int *idx, const float *scale, int rows, int cols, const float *_x)
 {
    int i, j;
@@ -876,6 +933,307 @@ static inline void cgemv8x4(float *_out, const opus_int8 *w, const float *scale,
    }
 }
 
+/* Batched variants of the kernels above: the same matrix is applied to up to
+   BATCH_MAX_INPUTS input vectors at once so that each block of weights is only
+   loaded once. Every output is accumulated in the same order as the
+   single-vector kernels, so the results are bit-exact with them. */
+#define BATCH_MAX_INPUTS 4
+#define VEC_HAVE_BATCH
+
+static inline void sgemv_batch_n(float *const *out, const float *weights, int rows, int cols, int col_stride, const float *const *x, const int nb)
+{
+  int i, j, k;
+  i=0;
+  for (;i<rows-7;i+=8)
+  {
+     __m256 vy[BATCH_MAX_INPUTS];
+     for (k=0;k<nb;k++) vy[k] = _mm256_setzero_ps();
+     for (j=0;j<cols;j++)
+     {
+        __m256 vw;
+        vw = _mm256_loadu_ps(&weights[j*col_stride + i]);
+        for (k=0;k<nb;k++) vy[k] = _mm256_fmadd_ps(vw, _mm256_broadcast_ss(&x[k][j]), vy[k]);
+     }
+     for (k=0;k<nb;k++) _mm256_storeu_ps(&out[k][i], vy[k]);
+  }
+  if (i<rows) {
+     for (k=0;k<nb;k++) sgemv(&out[k][i], &weights[i], rows-i, cols, col_stride, x[k]);
+  }
+}
+
+static inline void sgemv_batch(float *const *out, const float *weights, int rows, int cols, int col_stride, const float *const *x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: sgemv(out[0], weights, rows, cols, col_stride, x[0]); break;
+      case 2: sgemv_batch_n(out, weights, rows, cols, col_stride, x, 2); break;
+      case 3: sgemv_batch_n(out, weights, rows, cols, col_stride, x, 3); break;
+      default: sgemv_batch_n(out, weights, rows, cols, col_stride, x, 4); break;
+   }
+}
+
+static inline void sparse_sgemv8x4_batch_n(float *const *out, const float *weights, const int *idx, int rows, const float *const *x, const int nb)
+{
+   int i, j, k;
+   for (i=0;i<rows;i+=8)
+   {
+      int cols;
+      __m256 vy[BATCH_MAX_INPUTS];
+      for (k=0;k<nb;k++) vy[k] = _mm256_setzero_ps();
+      cols = *idx++;
+      for (j=0;j<cols;j++)
+      {
+         int id;
+         __m256 vw0, vw1, vw2, vw3;
+         id = *idx++;
+         vw0 = _mm256_loadu_ps(&weights[0]);
+         vw1 = _mm256_loadu_ps(&weights[8]);
+         vw2 = _mm256_loadu_ps(&weights[16]);
+         vw3 = _mm256_loadu_ps(&weights[24]);
+         for (k=0;k<nb;k++) {
+            vy[k] = _mm256_fmadd_ps(vw0, _mm256_broadcast_ss(&x[k][id]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw1, _mm256_broadcast_ss(&x[k][id+1]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw2, _mm256_broadcast_ss(&x[k][id+2]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw3, _mm256_broadcast_ss(&x[k][id+3]), vy[k]);
+         }
+         weights += 32;
+      }
+      for (k=0;k<nb;k++) _mm256_storeu_ps(&out[k][i], vy[k]);
+   }
+}
+
+static inline void sparse_sgemv8x4_batch(float *const *out, const float *weights, const int *idx, int rows, const float *const *x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: sparse_sgemv8x4(out[0], weights, idx, rows, x[0]); break;
+      case 2: sparse_sgemv8x4_batch_n(out, weights, idx, rows, x, 2); break;
+      case 3: sparse_sgemv8x4_batch_n(out, weights, idx, rows, x, 3); break;
+      default: sparse_sgemv8x4_batch_n(out, weights, idx, rows, x, 4); break;
+   }
+}
+
+static inline void sparse_cgemv8x4_batch_n(float *const *_out, const opus_int8 *w, const int *idx, const float *scale, int rows, int cols, const float *const *_x, const int nb)
+{
+   int i, j, k;
+   unsigned char x[BATCH_MAX_INPUTS][MAX_INPUTS];
+   for (k=0;k<nb;k++) vector_ps_to_epi8(x[k], _x[k], cols);
+   for (i=0;i<rows;i+=8)
+   {
+      int colblocks;
+      __m256i vy[BATCH_MAX_INPUTS];
+      colblocks = *idx++;
+      for (k=0;k<nb;k++) vy[k] = _mm256_setzero_si256();
+      for (j=0;j<colblocks;j++)
+      {
+         int id;
+         __m256i vw;
+         id = *idx++;
+         vw = _mm256_loadu_si256((const __m256i *)(void*)w);
+         for (k=0;k<nb;k++) vy[k] = opus_mm256_dpbusds_epi32(vy[k], _mm256_broadcastd_epi32(_mm_loadu_si32(&x[k][id])), vw);
+         w += 32;
+      }
+      for (k=0;k<nb;k++) {
+         __m256 vout;
+         vout = _mm256_cvtepi32_ps(vy[k]);
+         vout = _mm256_mul_ps(vout, _mm256_loadu_ps(&scale[i]));
+         _mm256_storeu_ps(&_out[k][i], vout);
+      }
+   }
+}
+
+static inline void sparse_cgemv8x4_batch(float *const *_out, const opus_int8 *w, const int *idx, const float *scale, int rows, int cols, const float *const *_x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: sparse_cgemv8x4(_out[0], w, idx, scale, rows, cols, _x[0]); break;
+      case 2: sparse_cgemv8x4_batch_n(_out, w, idx, scale, rows, cols, _x, 2); break;
+      case 3: sparse_cgemv8x4_batch_n(_out, w, idx, scale, rows, cols, _x, 3); break;
+      default: sparse_cgemv8x4_batch_n(_out, w, idx, scale, rows, cols, _x, 4); break;
+   }
+}
+
+static inline void cgemv8x4_batch_n(float *const *_out, const opus_int8 *w, const float *scale, int rows, int cols, const float *const *_x, const int nb)
+{
+   int i, j, k;
+   unsigned char x[BATCH_MAX_INPUTS][MAX_INPUTS];
+   for (k=0;k<nb;k++) vector_ps_to_epi8(x[k], _x[k], cols);
+   for (i=0;i<rows;i+=8)
+   {
+      __m256i vy[BATCH_MAX_INPUTS];
+      for (k=0;k<nb;k++) vy[k] = _mm256_setzero_si256();
+      for (j=0;j<cols;j+=4)
+      {
+         __m256i vw;
+         vw = _mm256_loadu_si256((const __m256i *)(void*)w);
+         for (k=0;k<nb;k++) vy[k] = opus_mm256_dpbusds_epi32(vy[k], _mm256_broadcastd_epi32(_mm_loadu_si32(&x[k][j])), vw);
+         w += 32;
+      }
+      for (k=0;k<nb;k++) {
+         __m256 vout;
+         vout = _mm256_cvtepi32_ps(vy[k]);
+         vout = _mm256_mul_ps(vout, _mm256_loadu_ps(&scale[i]));
+         _mm256_storeu_ps(&_out[k][i], vout);
+      }
+   }
+}
+
+static inline void cgemv8x4_batch(float *const *_out, const opus_int8 *w, const float *scale, int rows, int cols, const float *const *_x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: cgemv8x4(_out[0], w, scale, rows, cols, _x[0]); break;
+      case 2: cgemv8x4_batch_n(_out, w, scale, rows, cols, _x, 2); break;
+      case 3: cgemv8x4_batch_n(_out, w, scale, rows, cols, _x, 3); break;
+      default: cgemv8x4_batch_n(_out, w, scale, rows, cols, _x, 4); break;
+   }
+}
+
+/* MSVC has no __F16C__, but F16C comes with all AVX2 CPUs. */
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+/* Half precision weights, expanded to float in registers. */
+#define VEC_HAVE_FLOAT16
+static inline float float16_to_float(opus_uint16 h)
+{
+   return _cvtsh_ss(h);
+}
+
+static inline __m256 load8_float16(const opus_uint16 *w)
+{
+   return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)w));
+}
+
+static inline void hgemv(float *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *x)
+{
+  int i, j;
+  i=0;
+  for (;i<rows-15;i+=16)
+  {
+     __m256 vy0, vy8;
+     vy0 = _mm256_setzero_ps();
+     vy8 = _mm256_setzero_ps();
+     for (j=0;j<cols;j++)
+     {
+        __m256 vxj = _mm256_broadcast_ss(&x[j]);
+        vy0 = _mm256_fmadd_ps(load8_float16(&weights[j*col_stride + i]), vxj, vy0);
+        vy8 = _mm256_fmadd_ps(load8_float16(&weights[j*col_stride + i + 8]), vxj, vy8);
+     }
+     _mm256_storeu_ps (&out[i], vy0);
+     _mm256_storeu_ps (&out[i+8], vy8);
+  }
+  for (;i<rows-7;i+=8)
+  {
+     __m256 vy0;
+     vy0 = _mm256_setzero_ps();
+     for (j=0;j<cols;j++)
+     {
+        vy0 = _mm256_fmadd_ps(load8_float16(&weights[j*col_stride + i]), _mm256_broadcast_ss(&x[j]), vy0);
+     }
+     _mm256_storeu_ps (&out[i], vy0);
+  }
+  for (;i<rows;i++)
+  {
+    out[i] = 0;
+    for (j=0;j<cols;j++) out[i] += float16_to_float(weights[j*col_stride + i])*x[j];
+  }
+}
+
+static inline void sparse_hgemv8x4(float *out, const opus_uint16 *weights, const int *idx, int rows, const float *x)
+{
+   int i, j;
+   for (i=0;i<rows;i+=8)
+   {
+      int cols;
+      __m256 vy0;
+      vy0 = _mm256_setzero_ps();
+      cols = *idx++;
+      for (j=0;j<cols;j++)
+      {
+         int id = *idx++;
+         vy0 = _mm256_fmadd_ps(load8_float16(&weights[0]), _mm256_broadcast_ss(&x[id]), vy0);
+         vy0 = _mm256_fmadd_ps(load8_float16(&weights[8]), _mm256_broadcast_ss(&x[id+1]), vy0);
+         vy0 = _mm256_fmadd_ps(load8_float16(&weights[16]), _mm256_broadcast_ss(&x[id+2]), vy0);
+         vy0 = _mm256_fmadd_ps(load8_float16(&weights[24]), _mm256_broadcast_ss(&x[id+3]), vy0);
+         weights += 32;
+      }
+      _mm256_storeu_ps (&out[i], vy0);
+   }
+}
+static inline void hgemv_batch_n(float *const *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *const *x, const int nb)
+{
+  int i, j, k;
+  i=0;
+  for (;i<rows-7;i+=8)
+  {
+     __m256 vy[BATCH_MAX_INPUTS];
+     for (k=0;k<nb;k++) vy[k] = _mm256_setzero_ps();
+     for (j=0;j<cols;j++)
+     {
+        __m256 vw;
+        vw = load8_float16(&weights[j*col_stride + i]);
+        for (k=0;k<nb;k++) vy[k] = _mm256_fmadd_ps(vw, _mm256_broadcast_ss(&x[k][j]), vy[k]);
+     }
+     for (k=0;k<nb;k++) _mm256_storeu_ps(&out[k][i], vy[k]);
+  }
+  if (i<rows) {
+     for (k=0;k<nb;k++) hgemv(&out[k][i], &weights[i], rows-i, cols, col_stride, x[k]);
+  }
+}
+
+#define VEC_HAVE_FLOAT16_BATCH
+static inline void hgemv_batch(float *const *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *const *x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: hgemv(out[0], weights, rows, cols, col_stride, x[0]); break;
+      case 2: hgemv_batch_n(out, weights, rows, cols, col_stride, x, 2); break;
+      case 3: hgemv_batch_n(out, weights, rows, cols, col_stride, x, 3); break;
+      default: hgemv_batch_n(out, weights, rows, cols, col_stride, x, 4); break;
+   }
+}
+
+static inline void sparse_hgemv8x4_batch_n(float *const *out, const opus_uint16 *weights, const int *idx, int rows, const float *const *x, const int nb)
+{
+   int i, j, k;
+   for (i=0;i<rows;i+=8)
+   {
+      int cols;
+      __m256 vy[BATCH_MAX_INPUTS];
+      for (k=0;k<nb;k++) vy[k] = _mm256_setzero_ps();
+      cols = *idx++;
+      for (j=0;j<cols;j++)
+      {
+         int id;
+         __m256 vw0, vw1, vw2, vw3;
+         id = *idx++;
+         vw0 = load8_float16(&weights[0]);
+         vw1 = load8_float16(&weights[8]);
+         vw2 = load8_float16(&weights[16]);
+         vw3 = load8_float16(&weights[24]);
+         for (k=0;k<nb;k++) {
+            vy[k] = _mm256_fmadd_ps(vw0, _mm256_broadcast_ss(&x[k][id]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw1, _mm256_broadcast_ss(&x[k][id+1]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw2, _mm256_broadcast_ss(&x[k][id+2]), vy[k]);
+            vy[k] = _mm256_fmadd_ps(vw3, _mm256_broadcast_ss(&x[k][id+3]), vy[k]);
+         }
+         weights += 32;
+      }
+      for (k=0;k<nb;k++) _mm256_storeu_ps(&out[k][i], vy[k]);
+   }
+}
+
+static inline void sparse_hgemv8x4_batch(float *const *out, const opus_uint16 *weights, const int *idx, int rows, const float *const *x, int nb)
+{
+   celt_assert(nb > 0 && nb <= BATCH_MAX_INPUTS);
+   switch (nb) {
+      case 1: sparse_hgemv8x4(out[0], weights, idx, rows, x[0]); break;
+      case 2: sparse_hgemv8x4_batch_n(out, weights, idx, rows, x, 2); break;
+      case 3: sparse_hgemv8x4_batch_n(out, weights, idx, rows, x, 3); break;
+      default: sparse_hgemv8x4_batch_n(out, weights, idx, rows, x, 4); break;
+   }
+}
+#endif
+
 #define SCALE (128.f*127.f)
 #define SCALE_1 (1.f/128.f/127.f)
 #define USE_SU_BIAS
@@ -360,6 +360,71 @@ static inline void sparse_sgemv8x4(float *out, const float *w, const int *idx, i
 }
 
 
+#if defined(__aarch64__) || (defined(__ARM_FP) && (__ARM_FP & 2))
+/* Half precision weights, expanded to float in registers. */
+#define VEC_HAVE_FLOAT16
+static inline float32x4_t load4_float16(const opus_uint16 *w)
+{
+   return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(w)));
+}
+
+static inline float float16_to_float(opus_uint16 h)
+{
+   return vgetq_lane_f32(vcvt_f32_f16(vreinterpret_f16_u16(vdup_n_u16(h))), 0);
+}
+
+static inline void hgemv(float *out, const opus_uint16 *weights, int rows, int cols, int col_stride, const float *x)
+{
+   int i, j;
+   i=0;
+   for (;i<rows-7;i+=8)
+   {
+      float32x4_t y0_3 = vdupq_n_f32(0);
+      float32x4_t y4_7 = vdupq_n_f32(0);
+      for (j=0;j<cols;j++)
+      {
+         const opus_uint16 *w = &weights[j*col_stride + i];
+         float32x4_t xj = vld1q_dup_f32(&x[j]);
+         y0_3 = vmlaq_f32(y0_3, load4_float16(&w[0]), xj);
+         y4_7 = vmlaq_f32(y4_7, load4_float16(&w[4]), xj);
+      }
+      vst1q_f32(&out[i], y0_3);
+      vst1q_f32(&out[i+4], y4_7);
+   }
+   for (;i<rows;i++)
+   {
+      out[i] = 0;
+      for (j=0;j<cols;j++) out[i] += float16_to_float(weights[j*col_stride + i])*x[j];
+   }
+}
+
+static inline void sparse_hgemv8x4(float *out, const opus_uint16 *w, const int *idx, int rows, const float *x)
+{
+   int i, j;
+   for (i=0;i<rows;i+=8)
+   {
+      int cols;
+      float32x4_t y0_3 = vdupq_n_f32(0);
+      float32x4_t y4_7 = vdupq_n_f32(0);
+      cols = *idx++;
+      for (j=0;j<cols;j++)
+      {
+         int k;
+         int pos = *idx++;
+         for (k=0;k<4;k++)
+         {
+            float32x4_t xj = vld1q_dup_f32(&x[pos+k]);
+            y0_3 = vmlaq_f32(y0_3, load4_float16(&w[8*k]), xj);
+            y4_7 = vmlaq_f32(y4_7, load4_float16(&w[8*k+4]), xj);
+         }
+         w += 32;
+      }
+      vst1q_f32(&out[i], y0_3);
+      vst1q_f32(&out[i+4], y4_7);
+   }
+}
+#endif
+
 #define SCALE (128.f*127.f)
 #define SCALE_1 (1.f/128.f/127.f)
 
@@ -28,7 +28,9 @@
 #include "config.h"
 #endif
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include "nnet.h"
@@ -68,10 +70,293 @@ void write_weights(const WeightArray *list, FILE *fout)
   }
 }
 
-int main(void)
+static const WeightArray *find_weights(const WeightArray *list, const char *prefix, const char *suffix)
 {
-  FILE *fout = fopen("weights_blob.bin", "w");
-  write_weights(rnnoise_arrays, fout);
+  char name[sizeof(((WeightHead*)0)->name)];
+  if (strlen(prefix) + strlen(suffix) >= sizeof(name)) return NULL;
+  strcpy(name, prefix);
+  strcat(name, suffix);
+  while (list->name != NULL) {
+    if (strcmp(list->name, name) == 0) return list;
+    list++;
+  }
+  return NULL;
+}
+
+typedef struct {
+  char name[sizeof(((WeightHead*)0)->name)];
+  signed char *weights;
+  float *scale;
+  float *subias;
+} QuantizedLayer;
+
+/* Weight (output k, input q) of the 8x4 block at the given index, in the layout the float
+   kernels use: input-major for dense matrices, sparse_sgemv8x4() blocks otherwise. */
+static float block_weight(const float *w, const int *idx, int N, int i, int j, int block, int k, int q)
+{
+  if (idx != NULL) return w[32*block + 8*q + k];
+  return w[(j+q)*N + i + k];
+}
+
+/* Quantizes a layer from its float weights like the weight exporter does
+   (torch/weight-exchange/wexchange/c_export/common.py): a per-output scale that keeps every
+   weight and every pair of consecutive weights in range of the u8*s8 pairs cgemv8x4() sums,
+   int8 weights in the layout of the int8 kernels, and the bias corrected for the unsigned
+   inputs of the SU kernels. Unlike the exporter, the diagonal of GRU recurrent weights, which
+   stays in float, doesn't count towards the scale. */
+static int quantize_layer(const WeightArray *list, const char *prefix, QuantizedLayer *q)
+{
+  const WeightArray *fw, *bias, *idx_array, *scale;
+  const float *w;
+  const int *idx;
+  float *max_abs, *max_sum, *sum_q;
+  int N, M, i, j, k, p, blocks, block, pos, err;
+  fw = find_weights(list, prefix, "_weights_float");
+  bias = find_weights(list, prefix, "_bias");
+  idx_array = find_weights(list, prefix, "_weights_idx");
+  scale = find_weights(list, prefix, "_scale");
+  if (fw == NULL || scale == NULL) return 1;
+  N = scale->size/sizeof(float);
+  if (N == 0 || N%8 != 0 || (bias != NULL && bias->size != scale->size)) return 1;
+  w = fw->data;
+  idx = idx_array != NULL ? idx_array->data : NULL;
+  if (idx != NULL) {
+    const int *cursor = idx;
+    blocks = 0;
+    M = 0;
+    for (i=0;i<N;i+=8) {
+      int cols = *cursor++;
+      for (j=0;j<cols;j++) M = IMAX(M, cursor[j]+4);
+      cursor += cols;
+      blocks += cols;
+    }
+  } else {
+    M = fw->size/sizeof(float)/N;
+    blocks = N/8*M/4;
+    if (M%4 != 0) return 1;
+  }
+  if (fw->size != 32*blocks*(int)sizeof(float)) return 1;
+
+  strcpy(q->name, prefix);
+  q->weights = malloc(32*blocks);
+  q->scale = malloc(N*sizeof(float));
+  q->subias = malloc(N*sizeof(float));
+  max_abs = calloc(N, sizeof(float));
+  max_sum = calloc(N, sizeof(float));
+  sum_q = calloc(N, sizeof(float));
+  err = 0;
+  for (p=0;p<2;p++) {
+    const int *cursor = idx;
+    block = 0;
+    pos = 0;
+    for (i=0;i<N;i+=8) {
+      int cols = idx != NULL ? *cursor++ : M/4;
+      for (j=0;j<cols;j++) {
+        int col = idx != NULL ? *cursor++ : 4*j;
+        for (k=0;k<8;k++) {
+          int l;
+          for (l=0;l<4;l++) {
+            float v = block_weight(w, idx, N, i, col, block, k, l);
+            if (p == 0) {
+              max_abs[i+k] = MAX32(max_abs[i+k], fabs(v));
+              if (l%2 == 1) max_sum[i+k] = MAX32(max_sum[i+k], fabs(v + block_weight(w, idx, N, i, col, block, k, l-1)));
+            } else {
+              int wq = (int)rint(v/(q->scale[i+k]*127 + 1e-30f));
+              if (wq > 127 || wq < -128) err = 1;
+              wq = IMAX(-128, IMIN(127, wq));
+              q->weights[pos++] = wq;
+              sum_q[i+k] += wq;
+            }
+          }
+        }
+        block++;
+      }
+    }
+    if (p == 0) {
+      for (i=0;i<N;i++) q->scale[i] = MAX32(max_abs[i]/127, max_sum[i]/129)/127;
+    }
+  }
+  for (i=0;i<N;i++) {
+    float b = bias != NULL ? ((const float*)bias->data)[i] : 0;
+    q->subias[i] = b - sum_q[i]*q->scale[i]*127;
+  }
+  free(max_abs);
+  free(max_sum);
+  free(sum_q);
+  if (err) {
+    fprintf(stderr, "[write_weights] %s: weights out of range after quantization\n", prefix);
+    free(q->weights);
+    free(q->scale);
+    free(q->subias);
+  }
+  return err;
+}
+
+/* Replaces the weights of every layer which has int8 weights by ones quantized from its float
+   weights, and leaves the float weights out so that the int8 kernels run on them. */
+static WeightArray *quantize_weights(const WeightArray *list, QuantizedLayer *layers, int max_layers, int *nb_layers)
+{
+  int i, n, count;
+  WeightArray *out;
+  for (count=0;list[count].name != NULL;count++);
+  out = calloc(count+1, sizeof(*out));
+  *nb_layers = 0;
+  for (i=0;i<count;i++) {
+    const char *suffix = strstr(list[i].name, "_weights_int8");
+    if (suffix != NULL && suffix[strlen("_weights_int8")] == 0) {
+      char prefix[sizeof(((WeightHead*)0)->name)];
+      int len = suffix - list[i].name;
+      if (len >= (int)sizeof(prefix)) continue;
+      memcpy(prefix, list[i].name, len);
+      prefix[len] = 0;
+      /* Already int8 only, nothing to quantize from. */
+      if (find_weights(list, prefix, "_weights_float") == NULL) continue;
+      if (*nb_layers == max_layers) {
+        fprintf(stderr, "[write_weights] too many layers\n");
+        free(out);
+        return NULL;
+      }
+      if (quantize_layer(list, prefix, &layers[*nb_layers])) {
+        fprintf(stderr, "[write_weights] failed to quantize %s\n", prefix);
+        free(out);
+        return NULL;
+      }
+      (*nb_layers)++;
+    }
+  }
+  n = 0;
+  for (i=0;i<count;i++) {
+    int l;
+    WeightArray a = list[i];
+    for (l=0;l<*nb_layers;l++) {
+      size_t len = strlen(layers[l].name);
+      const char *suffix = a.name + len;
+      if (strncmp(a.name, layers[l].name, len) != 0) continue;
+      if (strcmp(suffix, "_weights_int8") == 0) a.data = layers[l].weights;
+      else if (strcmp(suffix, "_scale") == 0) a.data = layers[l].scale;
+      else if (strcmp(suffix, "_subias") == 0) a.data = layers[l].subias;
+      else if (strcmp(suffix, "_weights_float") == 0) a.name = NULL;
+      else continue;
+      break;
+    }
+    if (a.name != NULL) out[n++] = a;
+  }
+  return out;
+}
+
+/* IEEE half precision, rounded to nearest even. */
+static opus_uint16 float_to_float16(float f)
+{
+  union {
+    float f;
+    opus_uint32 i;
+  } u;
+  opus_uint32 sign, abs_bits, h, rem;
+  u.f = f;
+  sign = (u.i >> 16) & 0x8000;
+  abs_bits = u.i & 0x7fffffff;
+  if (abs_bits >= 0x7f800000) return sign | 0x7c00 | (abs_bits > 0x7f800000 ? 0x200 : 0);
+  /* 65520 and above round to infinity. */
+  if (abs_bits >= 0x477ff000) return sign | 0x7c00;
+  if (abs_bits < 0x38800000) {
+    /* Subnormal, a multiple of 2^-24. */
+    u.i = abs_bits;
+    return sign | (opus_uint32)rint(u.f*16777216.f);
+  }
+  h = (abs_bits - 0x38000000) >> 13;
+  rem = abs_bits & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+  return sign | h;
+}
+
+/* Stores all float weights in half precision, under the same names, and leaves out the int8
+   weights of their layers, which are only used without float weights. Biases, scales and the
+   GRU diagonals stay in float. */
+static WeightArray *float16_weights(const WeightArray *list, opus_uint16 **buffers, int *nb_buffers)
+{
+  const char float_suffix[] = "_weights_float";
+  int i, j, n, count;
+  WeightArray *out;
+  for (count=0;list[count].name != NULL;count++);
+  out = calloc(count+1, sizeof(*out));
+  *nb_buffers = 0;
+  n = 0;
+  for (i=0;i<count;i++) {
+    WeightArray a = list[i];
+    size_t len = strlen(a.name);
+    if (len > strlen(float_suffix) && strcmp(a.name + len - strlen(float_suffix), float_suffix) == 0
+        && a.type == WEIGHT_TYPE_float) {
+      int size = a.size/sizeof(float);
+      opus_uint16 *h = malloc(size*sizeof(*h));
+      for (j=0;j<size;j++) h[j] = float_to_float16(((const float*)a.data)[j]);
+      buffers[(*nb_buffers)++] = h;
+      a.type = WEIGHT_TYPE_float16;
+      a.size = size*sizeof(*h);
+      a.data = h;
+    } else if (len > strlen("_weights_int8") && strcmp(a.name + len - strlen("_weights_int8"), "_weights_int8") == 0) {
+      char prefix[sizeof(((WeightHead*)0)->name)];
+      len -= strlen("_weights_int8");
+      if (len < sizeof(prefix)) {
+        memcpy(prefix, a.name, len);
+        prefix[len] = 0;
+        if (find_weights(list, prefix, float_suffix) != NULL) continue;
+      }
+    }
+    out[n++] = a;
+  }
+  return out;
+}
+
+int main(int argc, char **argv)
+{
+  const char *filename = "weights_blob.bin";
+  int int8 = 0;
+  int float16 = 0;
+  int i;
+  FILE *fout;
+  for (i=1;i<argc;i++) {
+    if (strcmp(argv[i], "--int8") == 0) int8 = 1;
+    else if (strcmp(argv[i], "--float16") == 0) float16 = 1;
+    else if (argv[i][0] != '-') filename = argv[i];
+    else break;
+  }
+  if (i < argc || (int8 && float16)) {
+    fprintf(stderr, "usage: %s [--int8 | --float16] [output]\n", argv[0]);
+    fprintf(stderr, "  --int8     quantize every layer that has int8 weights from its float weights\n");
+    fprintf(stderr, "             and leave the float weights out, so that the int8 kernels are used\n");
+    fprintf(stderr, "  --float16  store the float weights in half precision instead of the int8 ones\n");
+    return 1;
+  }
+  fout = fopen(filename, "wb");
+  if (fout == NULL) {
+    fprintf(stderr, "[write_weights] cannot open %s\n", filename);
+    return 1;
+  }
+  if (int8) {
+    QuantizedLayer layers[64];
+    int nb_layers;
+    WeightArray *list = quantize_weights(rnnoise_arrays, layers, sizeof(layers)/sizeof(layers[0]), &nb_layers);
+    if (list == NULL) {
+      fclose(fout);
+      return 1;
+    }
+    write_weights(list, fout);
+    for (i=0;i<nb_layers;i++) {
+      free(layers[i].weights);
+      free(layers[i].scale);
+      free(layers[i].subias);
+    }
+    free(list);
+  } else if (float16) {
+    opus_uint16 *buffers[sizeof(rnnoise_arrays)/sizeof(rnnoise_arrays[0])];
+    int nb_buffers;
+    WeightArray *list = float16_weights(rnnoise_arrays, buffers, &nb_buffers);
+    write_weights(list, fout);
+    for (i=0;i<nb_buffers;i++) free(buffers[i]);
+    free(list);
+  } else {
+    write_weights(rnnoise_arrays, fout);
+  }
   fclose(fout);
   return 0;
 }
@@ -32,12 +32,16 @@
 #include "opus_types.h"
 
 void compute_linear_sse4_1(const LinearLayer *linear, float *out, const float *in);
+void compute_linear_batch_sse4_1(const LinearLayer *linear, float *const *out, const float *const *in, int nb);
 void compute_activation_sse4_1(float *output, const float *input, int N, int activation);
 void compute_conv2d_sse4_1(const Conv2dLayer *conv, float *out, float *mem, const float *in, int height, int hstride, int activation);
+void compute_gru_sse4_1(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, const float *input_proj);
 
 void compute_linear_avx2(const LinearLayer *linear, float *out, const float *in);
+void compute_linear_batch_avx2(const LinearLayer *linear, float *const *out, const float *const *in, int nb);
 void compute_activation_avx2(float *output, const float *input, int N, int activation);
 void compute_conv2d_avx2(const Conv2dLayer *conv, float *out, float *mem, const float *in, int height, int hstride, int activation);
+void compute_gru_avx2(const LinearLayer *input_weights, const LinearLayer *recurrent_weights, float *state, const float *in, const float *input_proj);
 
 
 
@@ -53,6 +57,17 @@ extern void (*const RNN_COMPUTE_LINEAR_IMPL[OPUS_ARCHMASK + 1])(
     ((*RNN_COMPUTE_LINEAR_IMPL[(arch) & OPUS_ARCHMASK])(linear, out, in))
 
 
+extern void (*const RNN_COMPUTE_LINEAR_BATCH_IMPL[OPUS_ARCHMASK + 1])(
+                    const LinearLayer *linear,
+                    float *const *out,
+                    const float *const *in,
+                    int nb
+                    );
+#define OVERRIDE_COMPUTE_LINEAR_BATCH
+#define compute_linear_batch(linear, out, in, nb, arch) \
+    ((*RNN_COMPUTE_LINEAR_BATCH_IMPL[(arch) & OPUS_ARCHMASK])(linear, out, in, nb))
+
+
 extern void (*const RNN_COMPUTE_ACTIVATION_IMPL[OPUS_ARCHMASK + 1])(
                     float *output,
                     const float *input,
@@ -78,6 +93,18 @@ extern void (*const RNN_COMPUTE_CONV2D_IMPL[OPUS_ARCHMASK + 1])(
     ((*RNN_COMPUTE_CONV2D_IMPL[(arch) & OPUS_ARCHMASK])(conv, out, mem, in, height, hstride, activation))
 
 
+extern void (*const RNN_COMPUTE_GRU_IMPL[OPUS_ARCHMASK + 1])(
+                    const LinearLayer *input_weights,
+                    const LinearLayer *recurrent_weights,
+                    float *state,
+                    const float *in,
+                    const float *input_proj
+                    );
+#define OVERRIDE_COMPUTE_GRU
+#define compute_gru(input_weights, recurrent_weights, state, in, input_proj, arch) \
+    ((*RNN_COMPUTE_GRU_IMPL[(arch) & OPUS_ARCHMASK])(input_weights, recurrent_weights, state, in, input_proj))
+
+
 #endif
 
 
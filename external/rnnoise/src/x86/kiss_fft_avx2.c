@@ -0,0 +1,117 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x86/x86_arch_macros.h"
+
+#ifndef __AVX2__
+#error kiss_fft_avx2.c is being compiled without AVX2 enabled
+#endif
+
+#include <immintrin.h>
+#include "kiss_fft.h"
+
+#define RTCD_ARCH avx2
+
+/* Four complex values, real and imaginary parts interleaved. */
+typedef __m256 fft_vec;
+#define FFT_VEC_SIZE 4
+
+static OPUS_INLINE fft_vec fft_vec_load(const kiss_fft_cpx *p)
+{
+   return _mm256_loadu_ps(&p->r);
+}
+
+static OPUS_INLINE void fft_vec_store(kiss_fft_cpx *p, fft_vec v)
+{
+   _mm256_storeu_ps(&p->r, v);
+}
+
+static OPUS_INLINE __m128 load_pair(const float *p0, const float *p1)
+{
+   __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p0);
+   return _mm_loadh_pi(v, (const __m64 *)p1);
+}
+
+static OPUS_INLINE void store_pair(float *p0, float *p1, __m128 v)
+{
+   _mm_storel_pi((__m64 *)p0, v);
+   _mm_storeh_pi((__m64 *)p1, v);
+}
+
+static OPUS_INLINE fft_vec fft_vec_load_strided(const kiss_fft_cpx *p, int stride)
+{
+   __m128 lo = load_pair(&p[0].r, &p[stride].r);
+   __m128 hi = load_pair(&p[2*stride].r, &p[3*stride].r);
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+static OPUS_INLINE void fft_vec_store_strided(kiss_fft_cpx *p, int stride, fft_vec v)
+{
+   store_pair(&p[0].r, &p[stride].r, _mm256_castps256_ps128(v));
+   store_pair(&p[2*stride].r, &p[3*stride].r, _mm256_extractf128_ps(v, 1));
+}
+
+static OPUS_INLINE fft_vec fft_vec_load_twiddles(const kiss_twiddle_cpx *tw, int stride)
+{
+   __m128 lo = load_pair(&tw[0].r, &tw[stride].r);
+   __m128 hi = load_pair(&tw[2*stride].r, &tw[3*stride].r);
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+static OPUS_INLINE fft_vec fft_vec_add(fft_vec a, fft_vec b)
+{
+   return _mm256_add_ps(a, b);
+}
+
+static OPUS_INLINE fft_vec fft_vec_sub(fft_vec a, fft_vec b)
+{
+   return _mm256_sub_ps(a, b);
+}
+
+static OPUS_INLINE fft_vec fft_vec_scale(fft_vec a, float s)
+{
+   return _mm256_mul_ps(a, _mm256_set1_ps(s));
+}
+
+static OPUS_INLINE fft_vec fft_vec_cmul(fft_vec a, fft_vec b)
+{
+   __m256 swapped = _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1));
+   return _mm256_addsub_ps(_mm256_mul_ps(a, _mm256_moveldup_ps(b)), _mm256_mul_ps(swapped, _mm256_movehdup_ps(b)));
+}
+
+/* (a.i, -a.r) */
+static OPUS_INLINE fft_vec fft_vec_mul_minus_i(fft_vec a)
+{
+   const __m256 sign = _mm256_castsi256_ps(_mm256_set_epi32((int)0x80000000, 0, (int)0x80000000, 0,
+                                                            (int)0x80000000, 0, (int)0x80000000, 0));
+   return _mm256_xor_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+}
+
+#include "kiss_fft_arch.h"
@@ -0,0 +1,70 @@
+/* Copyright (c) 2026 The noise-suppression-for-voice authors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "x86/x86_arch_macros.h"
+
+#ifndef __SSE4_1__
+#error pitch_sse4_1.c is being compiled without SSE4.1 enabled
+#endif
+
+#include <smmintrin.h>
+#include "pitch.h"
+
+#define RTCD_ARCH sse4_1
+
+typedef __m128 xcorr_vec;
+#define XCORR_VEC_SIZE 4
+
+static OPUS_INLINE xcorr_vec xcorr_vec_zero(void)
+{
+   return _mm_setzero_ps();
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_set1(float a)
+{
+   return _mm_set1_ps(a);
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_load(const float *p)
+{
+   return _mm_loadu_ps(p);
+}
+
+static OPUS_INLINE void xcorr_vec_store(float *p, xcorr_vec v)
+{
+   _mm_storeu_ps(p, v);
+}
+
+static OPUS_INLINE xcorr_vec xcorr_vec_mac(xcorr_vec sum, xcorr_vec a, xcorr_vec b)
+{
+   return _mm_add_ps(sum, _mm_mul_ps(a, b));
+}
+
+#include "pitch_arch.h"
@@ -31,6 +31,8 @@
 
 #include "x86/x86cpu.h"
 #include "nnet.h"
+#include "kiss_fft.h"
+#include "pitch.h"
 
 #ifdef RNN_ENABLE_X86_RTCD
 
@@ -45,6 +47,17 @@ void (*const RNN_COMPUTE_LINEAR_IMPL[OPUS_ARCHMASK + 1])(
   MAY_HAVE_AVX2(compute_linear)  /* avx  */
 };
 
+void (*const RNN_COMPUTE_LINEAR_BATCH_IMPL[OPUS_ARCHMASK + 1])(
+         const LinearLayer *linear,
+         float *const *out,
+         const float *const *in,
+         int nb
+) = {
+  compute_linear_batch_c,                /* non-sse */
+  MAY_HAVE_SSE4_1(compute_linear_batch), /* sse4.1  */
+  MAY_HAVE_AVX2(compute_linear_batch)  /* avx  */
+};
+
 void (*const RNN_COMPUTE_ACTIVATION_IMPL[OPUS_ARCHMASK + 1])(
          float *output,
          const float *input,
@@ -70,5 +83,38 @@ void (*const RNN_COMPUTE_CONV2D_IMPL[OPUS_ARCHMASK + 1])(
   MAY_HAVE_AVX2(compute_conv2d)  /* avx  */
 };
 
+void (*const RNN_COMPUTE_GRU_IMPL[OPUS_ARCHMASK + 1])(
+         const LinearLayer *input_weights,
+         const LinearLayer *recurrent_weights,
+         float *state,
+         const float *in,
+         const float *input_proj
+) = {
+  compute_gru_c,                /* non-sse */
+  MAY_HAVE_SSE4_1(compute_gru), /* sse4.1  */
+  MAY_HAVE_AVX2(compute_gru)  /* avx  */
+};
+
+void (*const RNN_FFT_IMPL[OPUS_ARCHMASK + 1])(
+         const kiss_fft_state *st,
+         kiss_fft_cpx *fout
+) = {
+  rnn_fft_impl,                /* non-sse */
+  MAY_HAVE_SSE4_1(rnn_fft_impl), /* sse4.1  */
+  MAY_HAVE_AVX2(rnn_fft_impl)  /* avx  */
+};
+
+void (*const RNN_PITCH_XCORR_IMPL[OPUS_ARCHMASK + 1])(
+         const opus_val16 *_x,
+         const opus_val16 *_y,
+         opus_val32 *xcorr,
+         int len,
+         int max_pitch
+) = {
+  rnn_pitch_xcorr_c,                /* non-sse */
+  MAY_HAVE_SSE4_1(rnn_pitch_xcorr), /* sse4.1  */
+  MAY_HAVE_AVX2(rnn_pitch_xcorr)  /* avx  */
+};
+
 
 #endif
@@ -29,6 +29,9 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "cpu_support.h"
 #include "pitch.h"
 #include "x86cpu.h"
@@ -102,6 +105,19 @@ typedef struct CPU_Feature{
     int HW_AVX2;
 } CPU_Feature;
 
+/* XCR0 bits 1 and 2, the OS saves the SSE and AVX registers. Only valid when CPUID reports OSXSAVE. */
+static int os_saves_avx_state(void)
+{
+#if defined(_MSC_VER)
+    return (_xgetbv(0) & 6) == 6;
+#else
+    unsigned int eax, edx;
+    /* xgetbv, spelled out for assemblers that don't know it. */
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+    return (eax & 6) == 6;
+#endif
+}
+
 static void rnn_cpu_feature_check(CPU_Feature *cpu_feature)
 {
     unsigned int info[4];
@@ -115,7 +131,9 @@ static void rnn_cpu_feature_check(CPU_Feature *cpu_feature)
         cpu_feature->HW_SSE = (info[3] & (1 << 25)) != 0;
         cpu_feature->HW_SSE2 = (info[3] & (1 << 26)) != 0;
         cpu_feature->HW_SSE41 = (info[2] & (1 << 19)) != 0;
-        cpu_feature->HW_AVX2 = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 12)) != 0;
+        /* AVX, FMA and F16C, for the half precision weights, with the OS saving the AVX registers. */
+        cpu_feature->HW_AVX2 = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 12)) != 0
+            && (info[2] & (1 << 29)) != 0 && (info[2] & (1 << 27)) != 0 && os_saves_avx_state();
         if (cpu_feature->HW_AVX2 && nIds >= 7) {
             cpuid(info, 7);
             cpu_feature->HW_AVX2 = cpu_feature->HW_AVX2 && (info[1] & (1 << 5)) != 0;
@@ -154,8 +172,31 @@ static int rnn_select_arch_impl(void)
     return arch;
 }
 
+/* RNNOISE_ARCH=c|sse4_1|avx2 (or 0 to 2) lowers the arch, to compare the SIMD paths or to work
+   around one. It can't raise it above what the CPU supports. */
+static int rnn_arch_override(int arch)
+{
+    static const char *const names[] = {"c", "sse4_1", "avx2"};
+    const char *env;
+    int i;
+
+    env = getenv("RNNOISE_ARCH");
+    if (env == NULL || env[0] == '\0')
+    {
+        return arch;
+    }
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcmp(env, names[i]) == 0 || (env[0] == '0' + i && env[1] == '\0'))
+        {
+            return i < arch ? i : arch;
+        }
+    }
+    return arch;
+}
+
 int rnn_select_arch(void) {
-    int arch = rnn_select_arch_impl();
+    int arch = rnn_arch_override(rnn_select_arch_impl());
 #ifdef FUZZING
     /* Randomly downgrade the architecture. */
     arch = rand()%(arch+1);
@@ -0,0 +1,640 @@
+#include "common/RnNoiseCommonPlugin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <rnnoise.h>
+
+/* rnnoise internals, the kernels are benchmarked on the layers of the built-in model. */
+extern "C" {
+#include "cpu_support.h"
+#include "denoise.h"
+#include "kiss_fft.h"
+#include "nnet.h"
+#include "pitch.h"
+#include "rnnoise_data.h"
+
+extern const WeightArray rnnoise_arrays[];
+extern const kiss_fft_state rnn_kfft;
+extern const kiss_fft_state rnn_kfft_half;
+extern const float rnn_half_window[];
+}
+
+/* Mirrors denoise.c. */
+static const int k_frameSize = 480;
+static const int k_windowSize = 2 * k_frameSize;
+static const int k_pitchMinPeriod = 60;
+static const int k_pitchMaxPeriod = 768;
+static const int k_pitchFrameSize = 960;
+static const int k_pitchBufSize = k_pitchMaxPeriod + k_pitchFrameSize;
+
+struct BenchOptions {
+    bool json = false;
+    double minSeconds = 0.2;
+    std::string filter;
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    /* A frame is one call for the kernels, and 480 samples of one channel for everything that
+     * processes audio, so that ns/frame of different channel counts and block sizes compare.
+     */
+    double framesPerIteration;
+    double nsPerFrame;
+    double framesPerSecond;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static bool isSelected(const BenchOptions &options, const std::string &name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+/* Repeats the body in growing batches until a batch takes at least options.minSeconds. */
+static void runBenchmark(const BenchOptions &options, std::vector<BenchResult> &results,
+                         const std::string &name, double framesPerIteration, const std::function<void()> &body) {
+    if (!isSelected(options, name)) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        body();
+    }
+
+    uint64_t iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            body();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (seconds >= options.minSeconds) {
+            double frames = framesPerIteration * static_cast<double>(iterations);
+            results.push_back({name, iterations, framesPerIteration, seconds * 1e9 / frames, frames / seconds});
+            break;
+        }
+
+        /* Aim a bit over the minimum so that the next batch is most likely the last one. */
+        double scale = seconds > 0 ? 1.2 * options.minSeconds / seconds : 10.0;
+        iterations = std::max<uint64_t>(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations)
+                                                                              * std::min(scale, 10.0)));
+    }
+
+    if (!options.json) {
+        const BenchResult &result = results.back();
+        std::printf("%-48s %14.1f ns/frame %14.1f frames/s\n", result.name.c_str(), result.nsPerFrame,
+                    result.framesPerSecond);
+        std::fflush(stdout);
+    }
+}
+
+static std::vector<float> randomSignal(size_t size, uint32_t seed, float amplitude) {
+    std::minstd_rand rng(seed);
+    std::uniform_real_distribution<float> distribution(-amplitude, amplitude);
+    std::vector<float> signal(size);
+    for (auto &sample: signal) {
+        sample = distribution(rng);
+    }
+    return signal;
+}
+
+/* RTCD arches which were compiled in and are supported by this CPU. */
+static std::vector<std::pair<int, std::string>> availableArches() {
+#ifdef RNN_ENABLE_X86_RTCD
+    static const char *const names[] = {"c", "sse4_1", "avx2"};
+    std::vector<std::pair<int, std::string>> arches;
+    int maxArch = std::min<int>(rnn_select_arch(), sizeof(names) / sizeof(names[0]) - 1);
+    for (int arch = 0; arch <= maxArch; arch++) {
+        arches.emplace_back(arch, names[arch]);
+    }
+    return arches;
+#else
+    /* A single implementation built with whatever the compiler flags allow. */
+    return {{0, "default"}};
+#endif
+}
+
+/* Half precision rounded to nearest, values below its normal range are flushed to zero. */
+static uint16_t toFloat16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t absBits = bits & 0x7fffffff;
+    if (absBits < 0x38800000) {
+        return static_cast<uint16_t>(sign);
+    }
+    return static_cast<uint16_t>(sign | ((absBits - 0x38000000 + 0x1000) >> 13));
+}
+
+enum class ModelWeights {
+    Int8,
+    Float16,
+};
+
+/* The built-in model as a weights blob, like `dump_weights_blob --int8` or `--float16` write it:
+ * without the float weights of the layers which have int8 weights as well, or with the float
+ * weights in half precision instead of the int8 ones.
+ */
+static std::vector<unsigned char> modelBlob(ModelWeights weights) {
+    const std::string floatSuffix = "_weights_float";
+    const std::string int8Suffix = "_weights_int8";
+    auto hasArray = [](const std::string &name) {
+        for (const WeightArray *array = rnnoise_arrays; array->name != nullptr; array++) {
+            if (name == array->name) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto prefix = [](const std::string &name, const std::string &suffix) {
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return name.substr(0, name.size() - suffix.size());
+        }
+        return std::string();
+    };
+
+    std::vector<unsigned char> blob;
+    for (const WeightArray *array = rnnoise_arrays; array->name != nullptr; array++) {
+        const std::string name = array->name;
+        const std::string floatPrefix = prefix(name, floatSuffix);
+        const std::string int8Prefix = prefix(name, int8Suffix);
+        if (weights == ModelWeights::Int8 && !floatPrefix.empty() && hasArray(floatPrefix + int8Suffix)) {
+            continue;
+        }
+        if (weights == ModelWeights::Float16 && !int8Prefix.empty() && hasArray(int8Prefix + floatSuffix)) {
+            continue;
+        }
+
+        WeightHead head{};
+        std::memcpy(head.head, "DNNw", 4);
+        head.version = WEIGHT_BLOB_VERSION;
+        head.type = array->type;
+        head.size = array->size;
+        const auto *data = static_cast<const unsigned char *>(array->data);
+        std::vector<uint16_t> halfData;
+        if (weights == ModelWeights::Float16 && !floatPrefix.empty() && array->type == WEIGHT_TYPE_float) {
+            const auto *floatData = static_cast<const float *>(array->data);
+            for (size_t i = 0; i < array->size / sizeof(float); i++) {
+                halfData.push_back(toFloat16(floatData[i]));
+            }
+            head.type = WEIGHT_TYPE_float16;
+            head.size = static_cast<int>(halfData.size() * sizeof(uint16_t));
+            data = reinterpret_cast<const unsigned char *>(halfData.data());
+        }
+        head.block_size = (head.size + WEIGHT_BLOCK_SIZE - 1) / WEIGHT_BLOCK_SIZE * WEIGHT_BLOCK_SIZE;
+        std::strncpy(head.name, array->name, sizeof(head.name) - 1);
+        const auto *headBytes = reinterpret_cast<const unsigned char *>(&head);
+        blob.insert(blob.end(), headBytes, headBytes + sizeof(head));
+        blob.insert(blob.end(), data, data + head.size);
+        blob.resize(blob.size() + head.block_size - head.size);
+    }
+    return blob;
+}
+
+static void benchProcessFrame(const BenchOptions &options, std::vector<BenchResult> &results) {
+    DenoiseState *st = rnnoise_create(nullptr);
+    std::vector<float> input = randomSignal(k_frameSize, 1, 10000.f);
+    std::vector<float> output(k_frameSize);
+
+    runBenchmark(options, results, "rnnoise_process_frame", 1, [&] {
+        rnnoise_process_frame(st, output.data(), input.data());
+    });
+
+    /* The [-1, 1] and 16 bit integer samples are converted inside rnnoise. */
+    std::vector<float> normalizedInput(k_frameSize);
+    std::vector<short> int16Input(k_frameSize), int16Output(k_frameSize);
+    for (size_t i = 0; i < k_frameSize; i++) {
+        normalizedInput[i] = input[i] / 32767.f;
+        int16Input[i] = static_cast<short>(input[i]);
+    }
+
+    runBenchmark(options, results, "rnnoise_process_frame/normalized", 1, [&] {
+        rnnoise_process_frame_normalized(st, output.data(), normalizedInput.data());
+    });
+
+    runBenchmark(options, results, "rnnoise_process_frame/int16", 1, [&] {
+        rnnoise_process_frame_int16(st, int16Output.data(), int16Input.data());
+    });
+
+    rnnoise_destroy(st);
+
+    /* A full batch of consecutive frames of one stream. */
+    const int frames = 4;
+    st = rnnoise_create(nullptr);
+    input = randomSignal(frames * k_frameSize, 1, 10000.f);
+    output.resize(frames * k_frameSize);
+
+    runBenchmark(options, results, "rnnoise_process_frames/4", frames, [&] {
+        rnnoise_process_frames(st, output.data(), input.data(), nullptr, frames);
+    });
+
+    rnnoise_destroy(st);
+
+    /* The same on the int8 weights, a quarter of the float ones in size, and on the float weights
+     * in half precision.
+     */
+    const std::pair<ModelWeights, std::string> models[] = {
+            {ModelWeights::Int8,    "/int8"},
+            {ModelWeights::Float16, "/float16"},
+    };
+    for (const auto &weights: models) {
+        const std::vector<unsigned char> blob = modelBlob(weights.first);
+        RNNModel *model = rnnoise_model_from_buffer(blob.data(), static_cast<int>(blob.size()));
+        if (model == nullptr) {
+            std::fprintf(stderr, "Failed to load the %s model\n", weights.second.c_str() + 1);
+            std::exit(1);
+        }
+        st = rnnoise_create(model);
+        input = randomSignal(frames * k_frameSize, 1, 10000.f);
+
+        runBenchmark(options, results, "rnnoise_process_frame" + weights.second, 1, [&] {
+            rnnoise_process_frame(st, output.data(), input.data());
+        });
+        runBenchmark(options, results, "rnnoise_process_frames/4" + weights.second, frames, [&] {
+            rnnoise_process_frames(st, output.data(), input.data(), nullptr, frames);
+        });
+
+        rnnoise_destroy(st);
+        rnnoise_model_free(model);
+    }
+}
+
+static void benchKernels(const BenchOptions &options, std::vector<BenchResult> &results) {
+    RNNoise model;
+    if (init_rnnoise(&model, rnnoise_arrays) != 0) {
+        std::fprintf(stderr, "Failed to initialize the built-in model\n");
+        std::exit(1);
+    }
+
+    struct NamedLayer {
+        const char *name;
+        const LinearLayer *layer;
+    };
+    const NamedLayer linearLayers[] = {
+            {"conv1",          &model.conv1},
+            {"conv2",          &model.conv2},
+            {"gru1_input",     &model.gru1_input},
+            {"gru1_recurrent", &model.gru1_recurrent},
+            {"dense_out",      &model.dense_out},
+    };
+
+    /* The layers which have int8 weights, without their float weights. */
+    RNNoise int8Model = model;
+    LinearLayer *const int8Layers[] = {
+            &int8Model.conv2, &int8Model.gru1_input, &int8Model.gru1_recurrent,
+    };
+    for (LinearLayer *layer: int8Layers) {
+        layer->float_weights = nullptr;
+    }
+    const NamedLayer int8LinearLayers[] = {
+            {"conv2",          &int8Model.conv2},
+            {"gru1_input",     &int8Model.gru1_input},
+            {"gru1_recurrent", &int8Model.gru1_recurrent},
+    };
+
+    /* The float weights of the GRU in half precision. */
+    RNNoise float16Model = model;
+    std::vector<std::vector<uint16_t>> halfWeights;
+    halfWeights.reserve(2);
+    for (LinearLayer *layer: {&float16Model.gru1_input, &float16Model.gru1_recurrent}) {
+        size_t weightCount = 0;
+        const int *idx = layer->weights_idx;
+        for (int i = 0; i < layer->nb_outputs; i += 8) {
+            weightCount += 32 * *idx;
+            idx += 1 + *idx;
+        }
+        halfWeights.emplace_back(weightCount);
+        for (size_t i = 0; i < weightCount; i++) {
+            halfWeights.back()[i] = toFloat16(layer->float_weights[i]);
+        }
+        layer->float16_weights = halfWeights.back().data();
+        layer->float_weights = nullptr;
+    }
+    const NamedLayer float16LinearLayers[] = {
+            {"gru1_input",     &float16Model.gru1_input},
+            {"gru1_recurrent", &float16Model.gru1_recurrent},
+    };
+
+    /* Enough for the inputs and the gates of any layer. */
+    const int maxInputs = 3 * 1024;
+    std::vector<float> input = randomSignal(maxInputs, 2, 1.f);
+    std::vector<float> output(maxInputs);
+    std::vector<float> state(maxInputs);
+
+    /* Separate buffers per batch entry like separate channels have. */
+    std::vector<std::vector<float>> batchInputs, batchOutputs, batchStates;
+    std::vector<const float *> batchInputPtrs;
+    std::vector<float *> batchOutputPtrs, batchStatePtrs;
+    for (int k = 0; k < MAX_BATCH; k++) {
+        batchInputs.push_back(randomSignal(maxInputs, 3 + k, 1.f));
+        batchOutputs.emplace_back(maxInputs);
+        batchStates.emplace_back(maxInputs);
+        batchInputPtrs.push_back(batchInputs.back().data());
+        batchOutputPtrs.push_back(batchOutputs.back().data());
+        batchStatePtrs.push_back(batchStates.back().data());
+    }
+
+    for (const auto &arch: availableArches()) {
+        const int archIdx = arch.first;
+        const std::string suffix = "/" + arch.second;
+
+        for (const auto &named: linearLayers) {
+            runBenchmark(options, results, std::string("compute_linear/") + named.name + suffix, 1, [&] {
+                compute_linear(named.layer, output.data(), input.data(), archIdx);
+            });
+        }
+
+        runBenchmark(options, results, "compute_linear_batch/gru1_recurrent" + suffix, MAX_BATCH, [&] {
+            compute_linear_batch(&model.gru1_recurrent, batchOutputPtrs.data(), batchInputPtrs.data(), MAX_BATCH,
+                                 archIdx);
+        });
+
+        for (const auto &named: int8LinearLayers) {
+            runBenchmark(options, results, std::string("compute_linear/") + named.name + "/int8" + suffix, 1, [&] {
+                compute_linear(named.layer, output.data(), input.data(), archIdx);
+            });
+        }
+        runBenchmark(options, results, "compute_linear_batch/gru1_recurrent/int8" + suffix, MAX_BATCH, [&] {
+            compute_linear_batch(&int8Model.gru1_recurrent, batchOutputPtrs.data(), batchInputPtrs.data(), MAX_BATCH,
+                                 archIdx);
+        });
+        for (const auto &named: float16LinearLayers) {
+            runBenchmark(options, results, std::string("compute_linear/") + named.name + "/float16" + suffix, 1, [&] {
+                compute_linear(named.layer, output.data(), input.data(), archIdx);
+            });
+        }
+
+        /* The GRU gates are the largest activations rnnoise computes. */
+        const int gateSize = 3 * GRU1_OUT_SIZE;
+        runBenchmark(options, results, "compute_activation/sigmoid" + suffix, 1, [&] {
+            compute_activation(output.data(), input.data(), gateSize, ACTIVATION_SIGMOID, archIdx);
+        });
+        runBenchmark(options, results, "compute_activation/tanh" + suffix, 1, [&] {
+            compute_activation(output.data(), input.data(), gateSize, ACTIVATION_TANH, archIdx);
+        });
+
+        runBenchmark(options, results, "compute_generic_conv1d/conv2" + suffix, 1, [&] {
+            compute_generic_conv1d(&model.conv2, output.data(), state.data(), input.data(), CONV2_IN_SIZE,
+                                   ACTIVATION_TANH, archIdx);
+        });
+        runBenchmark(options, results, "compute_generic_gru/gru1" + suffix, 1, [&] {
+            compute_generic_gru(&model.gru1_input, &model.gru1_recurrent, state.data(), input.data(), archIdx);
+        });
+        runBenchmark(options, results, "compute_generic_gru/gru1/int8" + suffix, 1, [&] {
+            compute_generic_gru(&int8Model.gru1_input, &int8Model.gru1_recurrent, state.data(), input.data(),
+                                archIdx);
+        });
+        runBenchmark(options, results, "compute_generic_gru/gru1/float16" + suffix, 1, [&] {
+            compute_generic_gru(&float16Model.gru1_input, &float16Model.gru1_recurrent, state.data(), input.data(),
+                                archIdx);
+        });
+        runBenchmark(options, results, "compute_generic_gru_batch/gru1" + suffix, MAX_BATCH, [&] {
+            compute_generic_gru_batch(&model.gru1_input, &model.gru1_recurrent, batchStatePtrs.data(),
+                                      batchInputPtrs.data(), MAX_BATCH, archIdx);
+        });
+        runBenchmark(options, results, "compute_generic_dense/dense_out" + suffix, 1, [&] {
+            compute_generic_dense(&model.dense_out, output.data(), input.data(), ACTIVATION_SIGMOID, archIdx);
+        });
+    }
+}
+
+static void benchFft(const BenchOptions &options, std::vector<BenchResult> &results) {
+    std::vector<float> signal = randomSignal(2 * k_windowSize, 4, 1.f);
+    std::vector<kiss_fft_cpx> in(k_windowSize);
+    std::vector<kiss_fft_cpx> out(k_windowSize);
+    for (int i = 0; i < k_windowSize; i++) {
+        in[i].r = signal[2 * i];
+        in[i].i = signal[2 * i + 1];
+    }
+
+    runBenchmark(options, results, "kiss_fft/960", 1, [&] {
+        rnn_fft(&rnn_kfft, in.data(), out.data(), 0);
+    });
+    runBenchmark(options, results, "kiss_ifft/960", 1, [&] {
+        rnn_ifft(&rnn_kfft, in.data(), out.data(), 0);
+    });
+
+    /* What rnnoise runs, including the window. */
+    std::vector<float> realOut(k_windowSize);
+    for (const auto &arch: availableArches()) {
+        const int archIdx = arch.first;
+        runBenchmark(options, results, "real_fft/960/" + arch.second, 1, [&] {
+            rnn_real_fft(&rnn_kfft_half, rnn_half_window, signal.data(), out.data(), archIdx);
+        });
+        runBenchmark(options, results, "real_ifft/960/" + arch.second, 1, [&] {
+            rnn_real_ifft(&rnn_kfft_half, rnn_half_window, in.data(), realOut.data(), archIdx);
+        });
+    }
+}
+
+static void benchPitch(const BenchOptions &options, std::vector<BenchResult> &results) {
+    /* Low-passed noise has a pitch-like correlation, so remove_doubling doesn't bail out early. */
+    std::vector<float> pitchBuf = randomSignal(k_pitchBufSize, 5, 10000.f);
+    for (int i = 1; i < k_pitchBufSize; i++) {
+        pitchBuf[i] = 0.9f * pitchBuf[i - 1] + 0.1f * pitchBuf[i];
+    }
+    std::vector<float> pitchRaw(k_pitchBufSize >> 1);
+    std::vector<float> pitchLp(k_pitchBufSize >> 1);
+    std::vector<float> searchLp(pitchLp.size());
+    std::vector<float> xcorr(k_pitchMaxPeriod >> 2);
+
+    for (const auto &arch: availableArches()) {
+        const int archIdx = arch.first;
+        const std::string suffix = "/" + arch.second;
+
+        /* What rnnoise runs per frame: only the new samples are decimated and filtered. */
+        runBenchmark(options, results, "pitch_downsample" + suffix, 1, [&] {
+            rnn_pitch_downsample(pitchBuf.data(), pitchRaw.data(), pitchLp.data(), k_pitchBufSize, k_frameSize,
+                                 archIdx);
+        });
+
+        /* The coarse search, 4x decimated. */
+        const int coarseLen = k_pitchFrameSize >> 2;
+        const int coarseLags = (k_pitchMaxPeriod - 3 * k_pitchMinPeriod) >> 2;
+        runBenchmark(options, results, "pitch_xcorr/coarse" + suffix, 1, [&] {
+            rnn_pitch_xcorr(pitchLp.data(), pitchLp.data(), xcorr.data(), coarseLen, coarseLags, archIdx);
+        });
+
+        runBenchmark(options, results, "pitch_search" + suffix, 1, [&] {
+            /* remove_doubling works in place. */
+            std::copy(pitchLp.begin(), pitchLp.end(), searchLp.begin());
+            int pitchIndex;
+            rnn_pitch_search(searchLp.data() + (k_pitchMaxPeriod >> 1), searchLp.data(), k_pitchFrameSize,
+                             k_pitchMaxPeriod - 3 * k_pitchMinPeriod, &pitchIndex, archIdx);
+            pitchIndex = k_pitchMaxPeriod - pitchIndex;
+            rnn_remove_doubling(searchLp.data(), k_pitchMaxPeriod, k_pitchMinPeriod, k_pitchFrameSize, &pitchIndex,
+                                pitchIndex, 0.5f);
+        });
+
+        /* What pitch tracking searches around a previous period of 300. */
+        const int trackedLag = k_pitchMaxPeriod - 300;
+        const int trackedRadius = 300 >> 3;
+        runBenchmark(options, results, "pitch_search/tracked" + suffix, 1, [&] {
+            std::copy(pitchLp.begin(), pitchLp.end(), searchLp.begin());
+            int pitchIndex;
+            rnn_pitch_search_range(searchLp.data() + (k_pitchMaxPeriod >> 1), searchLp.data(), k_pitchFrameSize,
+                                   k_pitchMaxPeriod - 3 * k_pitchMinPeriod, trackedLag - trackedRadius,
+                                   trackedLag + trackedRadius + 1, &pitchIndex, archIdx);
+            pitchIndex = k_pitchMaxPeriod - pitchIndex;
+            rnn_remove_doubling(searchLp.data(), k_pitchMaxPeriod, k_pitchMinPeriod, k_pitchFrameSize, &pitchIndex,
+                                pitchIndex, 0.5f);
+        });
+    }
+}
+
+static void benchFeatures(const BenchOptions &options, std::vector<BenchResult> &results) {
+    DenoiseState *st = rnnoise_create(nullptr);
+    std::vector<float> input = randomSignal(k_frameSize, 7, 10000.f);
+    std::vector<kiss_fft_cpx> X(FREQ_SIZE), P(FREQ_SIZE), filtered(FREQ_SIZE);
+    float Ex[NB_BANDS], Ep[NB_BANDS], Exp[NB_BANDS], features[NB_FEATURES];
+
+    /* The whole front end: analysis transform, pitch analysis, band features. */
+    runBenchmark(options, results, "compute_frame_features", 1, [&] {
+        rnn_compute_frame_features(st, X.data(), P.data(), Ex, Ep, Exp, features, input.data());
+    });
+
+    float g[NB_BANDS];
+    std::fill(g, g + NB_BANDS, 0.5f);
+    runBenchmark(options, results, "pitch_filter", 1, [&] {
+        std::copy(X.begin(), X.end(), filtered.begin());
+        rnn_pitch_filter(filtered.data(), P.data(), Ex, Ep, Exp, g);
+    });
+
+    rnnoise_destroy(st);
+}
+
+static void benchPlugin(const BenchOptions &options, std::vector<BenchResult> &results) {
+    for (uint32_t channels: {1u, 2u, 4u, 8u}) {
+        for (size_t blockFrames: {200u, 480u, 512u}) {
+            /* Mono and stereo also without their specialization, for comparison. */
+            for (bool generic: {false, true}) {
+                if (generic && channels > 2) {
+                    continue;
+                }
+                const std::string name = "plugin_process/" + std::to_string(channels) + "ch/"
+                                         + std::to_string(blockFrames) + (generic ? "/generic" : "");
+                if (!isSelected(options, name)) {
+                    continue;
+                }
+
+                std::unique_ptr<RnNoiseCommonPlugin> plugin = RnNoiseCommonPlugin::create(channels, blockFrames);
+                if (generic) {
+                    plugin.reset(new RnNoiseCommonPlugin(channels, blockFrames));
+                }
+                plugin->setHostBlockFrames(blockFrames);
+                plugin->init();
+
+                std::vector<std::vector<float>> inputs, outputs;
+                std::vector<const float *> in;
+                std::vector<float *> out;
+                for (uint32_t c = 0; c < channels; c++) {
+                    inputs.push_back(randomSignal(blockFrames, 6 + c, 0.3f));
+                    outputs.emplace_back(blockFrames);
+                    in.push_back(inputs.back().data());
+                    out.push_back(outputs.back().data());
+                }
+
+                double framesPerIteration = static_cast<double>(channels * blockFrames) / k_frameSize;
+                runBenchmark(options, results, name, framesPerIteration, [&] {
+                    plugin->process(in.data(), out.data(), blockFrames, 0.5f, 20, 0);
+                });
+
+                plugin->deinit();
+            }
+        }
+    }
+
+    /* Interleaved host buffers, deinterleaved on the way into the plugin's queues. */
+    for (uint32_t channels: {1u, 2u, 4u}) {
+        const size_t blockFrames = 480;
+        const std::string name = "plugin_process_interleaved/" + std::to_string(channels) + "ch/"
+                                 + std::to_string(blockFrames);
+        if (!isSelected(options, name)) {
+            continue;
+        }
+
+        std::unique_ptr<RnNoiseCommonPlugin> plugin = RnNoiseCommonPlugin::create(channels, blockFrames);
+        plugin->setHostBlockFrames(blockFrames);
+        plugin->init();
+
+        std::vector<float> input = randomSignal(channels * blockFrames, 6, 0.3f);
+        std::vector<float> output(channels * blockFrames);
+
+        double framesPerIteration = static_cast<double>(channels * blockFrames) / k_frameSize;
+        runBenchmark(options, results, name, framesPerIteration, [&] {
+            plugin->processInterleaved(input.data(), output.data(), blockFrames, channels, 0.5f, 20, 0);
+        });
+
+        plugin->deinit();
+    }
+}
+
+static void printJson(const std::vector<BenchResult> &results) {
+    std::printf("{\n");
+    std::printf("  \"arches\": [");
+    auto arches = availableArches();
+    for (size_t i = 0; i < arches.size(); i++) {
+        std::printf("%s\"%s\"", i ? ", " : "", arches[i].second.c_str());
+    }
+    std::printf("],\n");
+    std::printf("  \"profile\": %s,\n", RnNoiseCommonPlugin::isProfilingEnabled() ? "true" : "false");
+    std::printf("  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        std::printf("    {\"name\": \"%s\", \"iterations\": %llu, \"frames_per_iteration\": %.6g, "
+                    "\"ns_per_frame\": %.3f, \"frames_per_second\": %.3f}%s\n",
+                    result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+                    result.framesPerIteration, result.nsPerFrame, result.framesPerSecond,
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n");
+    std::printf("}\n");
+}
+
+static void printUsage(const char *program) {
+    std::fprintf(stderr,
+                 "Usage: %s [--json] [--filter <substring>] [--min-time <seconds>]\n"
+                 "  --json       Print the results as JSON once all benchmarks are done.\n"
+                 "  --filter     Only run benchmarks whose name contains the substring.\n"
+                 "  --min-time   How long each benchmark runs at least, 0.2 s by default.\n",
+                 program);
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            options.json = true;
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.minSeconds = std::atof(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    benchProcessFrame(options, results);
+    benchKernels(options, results);
+    benchFft(options, results);
+    benchPitch(options, results);
+    benchFeatures(options, results);
+    benchPlugin(options, results);
+
+    if (options.json) {
+        printJson(results);
+    }
+    return 0;
+}
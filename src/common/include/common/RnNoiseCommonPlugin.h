@@ -1,32 +1,126 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <cstring>
 #include <cassert>
+#include <cstdint>
 #include <atomic>
 
+#include "common/RnNoiseWorkerPool.h"
+
 struct DenoiseState;
+struct RNNModel;
 
+/* Accumulative counters only grow from init() on, consumers compare snapshots with since(). */
 struct RnNoiseStats {
     /* (Accumulative) How many blocks are unmuted due to grace period */
-    uint32_t vadGraceBlocks;
+    uint64_t vadGraceBlocks;
     /* (Accumulative) How many blocks are unmuted due to retroactive grace period */
-    uint32_t retroactiveVADGraceBlocks;
+    uint64_t retroactiveVADGraceBlocks;
 
     /* How many blocks are in an output queue in a single channel. Represents current latency. */
     uint32_t blocksWaitingForOutput;
 
-    /* How many output frames we are forced to zero out because there is not enough frames to write. */
+    /* (Accumulative) How many output frames we are forced to zero out because there is not enough frames to write. */
     uint64_t outputFramesForcedToBeZeroed;
+
+    /* Accumulative counters since the earlier snapshot, the rest as they are now. */
+    RnNoiseStats since(const RnNoiseStats &earlier) const;
+};
+
+/* Timings of one stage of rnnoise over all channels, only recorded in builds with RNNOISE_PROFILE. */
+struct RnNoiseStageTiming {
+    const char *name;
+    uint64_t count;
+    uint64_t minNs;
+    uint64_t meanNs;
+    /* Within 12.5% of the exact value. */
+    uint64_t p99Ns;
+    uint64_t maxNs;
+};
+
+struct RnNoiseMemoryFootprint {
+    /* rnnoise states of all channels. */
+    size_t stateBytes;
+    /* Weights, shared by all channels. */
+    size_t modelBytes;
+    /* Stack used by rnnoise for a batch of channels or blocks. */
+    size_t scratchBytes;
+    /* Input and output queues of all channels. */
+    size_t queueBytes;
 };
 
+template<uint32_t Channels>
+class RnNoiseCommonPluginT;
+
 class RnNoiseCommonPlugin {
 public:
 
-    explicit RnNoiseCommonPlugin(uint32_t channels) :
-            m_channelCount(channels) {}
+    /**
+     * @param channels
+     * @param maxBlockFrames The largest amount of frames the host is expected to pass to process()
+     * at once. Used to preallocate all the buffers in init(), larger inputs are processed in parts.
+     */
+    explicit RnNoiseCommonPlugin(uint32_t channels, size_t maxBlockFrames = k_defaultMaxBlockFrames) :
+            m_channelCount(channels), m_maxBlockFrames(maxBlockFrames > k_denoiseBlockSize ? maxBlockFrames : k_denoiseBlockSize) {}
+
+    virtual ~RnNoiseCommonPlugin() = default;
+
+    /**
+     * RnNoiseCommonPluginT for mono and stereo, whose loops are specialized for the channel count,
+     * RnNoiseCommonPlugin for any other channel count. Defined in RnNoiseCommonPluginT.cpp.
+     */
+    static std::unique_ptr<RnNoiseCommonPlugin> create(uint32_t channels,
+                                                       size_t maxBlockFrames = k_defaultMaxBlockFrames);
+
+    /**
+     * Denoise channels in parallel on a worker pool, takes effect on the next init().
+     * Mono and stereo are always processed on the calling thread since a single rnnoise
+     * batch covers them.
+     */
+    void setWorkerPoolConfig(const RnNoiseWorkerPool::Config &config);
+
+    /**
+     * Plans the latency for a host which always passes the same amount of frames to process().
+     * Output then starts with exactly getLatencyFrames() frames of silence and from there on
+     * every call has enough denoised frames, instead of zeroing the output until enough frames
+     * are queued. Takes effect on init(), or right away if nothing was processed since init().
+     * @param hostBlockFrames 0 if the block size is unknown or varies.
+     */
+    void setHostBlockFrames(size_t hostBlockFrames);
+
+    /**
+     * Full delay of the output relative to the input in frames for the planned host block size,
+     * including the delay of rnnoise itself.
+     */
+    uint32_t getLatencyFrames(uint32_t retroactiveVADGraceBlocks) const {
+        return computeLatencyFrames(m_hostBlockFrames, retroactiveVADGraceBlocks);
+    }
+
+    /**
+     * The smallest fixed delay which lets process() output hostBlockFrames denoised frames on
+     * every call. With an unknown host block size (0) the delay varies, the lower bound is returned.
+     */
+    static uint32_t computeLatencyFrames(size_t hostBlockFrames, uint32_t retroactiveVADGraceBlocks);
+
+    /**
+     * Switches to the rnnoise model in the file at path, or back to the built-in one for an empty
+     * path. Models come from RnNoiseModelCache, so instances using the same file share it.
+     * The model and the new rnnoise states are loaded on the calling thread, process() swaps
+     * them in at its next call without waiting. Never call it from the audio thread, nor
+     * concurrently with itself, init() or deinit().
+     * @return false if the model can't be loaded, the current one is kept then.
+     */
+    bool setModelPath(const std::string &path);
+
+    /* The path of the last model set by setModelPath(), empty for the built-in one. */
+    const std::string &getModelPath() const {
+        return m_modelPath;
+    }
 
     void init();
 
@@ -46,25 +140,194 @@ public:
     void process(const float *const *in, float **out, size_t sampleFrames, float vadThreshold,
                  uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks);
 
-    void resetStats();
+    /**
+     * process() for interleaved frames, sample c of frame i is at in[i * stride + c]. Samples are
+     * deinterleaved while they are queued for rnnoise and interleaved while the output is read
+     * from the queue, so no planar copies are needed. in and out may be the same buffer, samples
+     * of a frame past the channel count are left untouched.
+     * @param stride Samples from one frame to the next, at least the channel count.
+     */
+    void processInterleaved(const float *in, float *out, size_t sampleFrames, uint32_t stride, float vadThreshold,
+                            uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks);
+
+    /* The same for 16 bit samples, the output is rounded and saturated. */
+    void processInterleaved(const int16_t *in, int16_t *out, size_t sampleFrames, uint32_t stride,
+                            float vadThreshold, uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks);
+
+    /**
+     * Bulk processing for offline renders, not real-time safe. Output lines up with the input,
+     * there is no leading silence, so less than sampleFrames frames are written while rnnoise
+     * and the retroactive VAD catch up. flush() writes the rest after the last input.
+     * Must not be mixed with process() between init() calls.
+     * @return How many frames were written to the start of out.
+     */
+    size_t processOffline(const float *const *in, float **out, size_t sampleFrames, float vadThreshold,
+                          uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks);
+
+    /**
+     * Ends the input of processOffline() and writes at most maxFrames of the remaining output.
+     * Call it until it returns 0, at that point as many frames were written as were passed in.
+     * init() is needed to process another stream.
+     */
+    size_t flush(float **out, size_t maxFrames);
+
+    /* Safe to call from any thread, never blocks the processing thread. */
     const RnNoiseStats getStats() const;
 
+    static bool isProfilingEnabled();
+
+    /**
+     * Min/mean/p99/max of each rnnoise stage since init(), empty unless profiling is enabled.
+     * Safe to call from any thread. The processing thread refreshes the timings after each call
+     * to this, so they are one process() call behind.
+     */
+    std::vector<RnNoiseStageTiming> getStageTimings() const;
+
+    /* Memory used after init(), must not be called concurrently with init() or setModelPath(). */
+    RnNoiseMemoryFootprint getMemoryFootprint() const;
+
 private:
+    template<uint32_t Channels>
+    friend class RnNoiseCommonPluginT;
+
+    struct ChannelData;
+
+    /* How the host's samples are laid out, interleaved ones are stride samples apart. */
+    enum class SampleLayout {
+        PLANAR,
+        INTERLEAVED_FLOAT,
+        INTERLEAVED_INT16,
+    };
+
+    struct HostInput {
+        SampleLayout layout;
+        const float *const *planar;
+        const void *interleaved;
+        uint32_t stride;
+    };
+
+    struct HostOutput {
+        SampleLayout layout;
+        float **planar;
+        void *interleaved;
+        uint32_t stride;
+    };
+
+    /* Copies frames of a channel from frame on to dst, as floats in [-1, 1]. */
+    static void readHostInput(const HostInput &in, uint32_t channel, size_t frame, size_t frames, float *dst);
+
+    /* Writes frames of a channel from frame on, from src or silence if src is null. */
+    static void writeHostOutput(const HostOutput &out, uint32_t channel, size_t frame, size_t frames,
+                                const float *src);
 
     void createDenoiseState();
 
+    std::shared_ptr<DenoiseState> createChannelState() const;
+
+    /* Swaps in the states of a model change if there is one, called by the processing thread. */
+    void applyPendingStates();
+
+    /* Delay of the output queue alone for the planned host block size. */
+    static size_t computeQueueLatencyFrames(size_t hostBlockFrames, uint32_t retroactiveVADGraceBlocks);
+
+    void processHost(const HostInput &in, const HostOutput &out, size_t sampleFrames, float vadThreshold,
+                     uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks);
+
+    void processPart(const HostInput &in, const HostOutput &out, size_t offset, size_t sampleFrames,
+                     float vadThreshold, uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks,
+                     bool waitForEnoughFrames, RnNoiseStats &stats);
+
+    /* Denoises the input into the output queue, returns the index of the first new block. */
+    uint64_t denoiseInput(const HostInput &in, size_t offset, size_t sampleFrames);
+
+    /* Called at the end of init(), once the channels and their queues exist. */
+    virtual void onChannelsCreated() {}
+
+    /* Denoises all channels on the calling thread and sets the max VAD probability of the new blocks. */
+    virtual void denoiseAllChannels(const HostInput &in, size_t offset, size_t sampleFrames);
+
+    /* Max VAD probability over the channels of each block in [firstBlockIdx, endBlockIdx). */
+    void aggregateVadProbability(uint64_t firstBlockIdx, uint64_t endBlockIdx);
+
+    /* Copies frames of every channel from the output queue to out at outOffset, muted blocks as silence. */
+    virtual void writeOutput(const HostOutput &out, size_t outOffset, uint64_t blockIdx, size_t blockOffset,
+                             size_t frames) const;
+
+    /* Decides which of the blocks from firstNewOutputIdx on are muted, and unmutes older ones
+     * for the retroactive VAD.
+     */
+    void updateMuteStates(uint64_t firstNewOutputIdx, float vadThreshold, uint32_t vadGracePeriodBlocks,
+                          uint32_t retroactiveVADGraceBlocks, RnNoiseStats &stats);
+
+    /* Writes queued output of processOffline() from blocks before finalBlocks. */
+    size_t writeOfflineOutput(float **out, size_t outOffset, size_t maxFrames, uint64_t finalBlocks,
+                              RnNoiseStats &stats);
+
+    struct DenoiseJob;
+
+    static void denoiseChannelGroup(void *job, size_t groupIdx);
+
+    void denoiseChannels(const HostInput &in, size_t offset, size_t sampleFrames,
+                         size_t firstChannel, size_t channelCount);
+
+    /* Denoises a block of the channels into the given output queue slot, read from the host
+     * buffers at offset or, if in is null, from the channels' full input blocks.
+     */
+    void denoiseBlock(size_t slot, size_t firstChannel, size_t channelCount, const float *const *in, size_t offset);
+
+    /* Denoises blockCount consecutive blocks of a single channel from input into the output queue. */
+    void denoiseBlocks(uint64_t firstBlockIdx, size_t blockCount, ChannelData &channel, const float *input);
+
+    void readOutputQueue(const ChannelData &channel, uint64_t blockIdx, size_t blockOffset,
+                         float *out, size_t frames) const;
+
+    size_t blockSlot(uint64_t blockIdx) const {
+        return static_cast<size_t>(blockIdx % m_outputBlocksCapacity);
+    }
+
 private:
     static const size_t k_denoiseBlockSize = 480;
     static const uint32_t k_denoiseSampleRate = 48000;
+    static const size_t k_defaultMaxBlockFrames = k_denoiseBlockSize * 50;
+    static const size_t k_cacheLineSize = 64;
+    /* rnnoise shares weight loads between up to 4 channels. */
+    static const size_t k_maxChannelsPerGroup = 4;
+    /* Or between up to 4 blocks of a single channel. */
+    static const size_t k_maxBlocksPerDenoise = 4;
+    /* rnnoise applies the gains to the previous frame's spectrum and overlap-adds the result,
+     * so its output lags the input by two blocks.
+     */
+    static const size_t k_denoiseLatencyFrames = 2 * k_denoiseBlockSize;
 
     uint32_t m_channelCount;
+    size_t m_maxBlockFrames;
+    size_t m_hostBlockFrames = 0;
 
     uint64_t m_newOutputIdx = 0;
     uint64_t m_lastOutputIdxOverVADThreshold = 0;
 
+    /* The oldest block which is still kept in the output queue. */
+    uint64_t m_oldestOutputIdx = 0;
+    /* The block being written to the output and how many of its frames are already written. */
     uint64_t m_currentOutputIdxToOutput = 0;
+    size_t m_currentOutputOffset = 0;
+
+    /* How many frames of the incomplete block are waiting in ChannelData::inputBlock. */
+    size_t m_inputBlockFrames = 0;
 
     uint32_t m_prevRetroactiveVADGraceBlocks = 0;
+    /* Excess latency left after retroactiveVADGraceBlocks was reduced. */
+    uint32_t m_outputBlocksToDrop = 0;
+    /* Silence still to be written before the output queue, the planned latency. */
+    size_t m_primingFrames = 0;
+
+    /* processOffline() state, the settings are kept for flush(). */
+    uint64_t m_offlineInputFrames = 0;
+    uint64_t m_offlineOutputFrames = 0;
+    bool m_offlineFlushed = false;
+    float m_offlineVadThreshold = 0.f;
+    uint32_t m_offlineVadGracePeriodBlocks = 0;
+    uint32_t m_offlineRetroactiveVADGraceBlocks = 0;
 
     enum class ChunkUnmuteState {
         MUTED,
@@ -73,28 +336,86 @@ private:
         UNMUTED_RETRO_VAD,
     };
 
-    struct OutputChunk {
-        uint64_t idx;
-        float vadProbability;
-        float maxVadProbability;
-        ChunkUnmuteState muteState;
-        float frames[480];
-        size_t curOffset;
-    };
+    /* The output queue is a ring of m_outputBlocksCapacity blocks, block with index idx lives
+     * in the slot idx % m_outputBlocksCapacity. Metadata is shared by all channels since we
+     * either mute ALL channels or none.
+     */
+    size_t m_outputBlocksCapacity = 0;
+    std::vector<float> m_outputMaxVadProbability;
+    std::vector<ChunkUnmuteState> m_outputMuteState;
+    std::vector<float> m_crossfadeFrames;
 
     struct ChannelData {
         uint32_t idx;
 
         std::shared_ptr<DenoiseState> denoiseState;
 
-        std::vector<float> rnnoiseInput;
-        std::vector<std::unique_ptr<OutputChunk>> rnnoiseOutput;
-
-        std::vector<std::unique_ptr<OutputChunk>> outputBlocksCache;
+        /* k_maxBlocksPerDenoise blocks of input accumulated for rnnoise. Only a single channel
+         * group uses more than the first one.
+         */
+        float *inputBlock;
+        /* m_outputBlocksCapacity blocks of k_denoiseBlockSize frames. */
+        float *outputBlocks;
+        std::vector<float> vadProbability;
     };
     std::vector<ChannelData> m_channels;
 
-    std::atomic<RnNoiseStats> m_stats;
+    /* Per-channel arguments of rnnoise_process_frame_batch(), preallocated in init(). */
+    std::vector<DenoiseState *> m_batchStates;
+    std::vector<const float *> m_batchInputs;
+    std::vector<float *> m_batchOutputs;
+    std::vector<float> m_batchVadProbability;
+
+    RnNoiseWorkerPool::Config m_workerPoolConfig;
+    std::unique_ptr<RnNoiseWorkerPool> m_workerPool;
+    /* Channels are split into groups of m_channelGroupSize which are denoised in parallel. */
+    size_t m_channelGroupSize = 0;
+    size_t m_channelGroupCount = 0;
+
+    /* Backing memory for all blocks of all channels, blocks start at cache line boundary. */
+    std::vector<float> m_blocksStorage;
+
+    /* Only touched by the processing thread, then published for getStats(). */
+    RnNoiseStats m_stats{};
+
+    void publishStats();
+
+    /* A sequence lock: the processing thread never waits, readers retry if they raced a publish. */
+    struct PublishedStats {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> vadGraceBlocks{0};
+        std::atomic<uint64_t> retroactiveVADGraceBlocks{0};
+        std::atomic<uint32_t> blocksWaitingForOutput{0};
+        std::atomic<uint64_t> outputFramesForcedToBeZeroed{0};
+    };
+    PublishedStats m_publishedStats;
+
+    /* Called by the processing thread, summarizes the timings if they were asked for. */
+    void publishStageTimings();
+
+    /* RNNOISE_STAGE_COUNT, summaries are published with a sequence lock like the stats. */
+    static const size_t k_profiledStages = 13;
+    static const size_t k_valuesPerStageTiming = 5;
+    mutable std::atomic<bool> m_stageTimingsRequested{true};
+    std::atomic<uint32_t> m_stageTimingsSequence{0};
+    std::atomic<uint64_t> m_publishedStageTimings[k_profiledStages * k_valuesPerStageTiming]{};
+
+    RnNoiseMemoryFootprint m_memoryFootprint{};
+
+    std::string m_modelPath;
+    /* Kept so that the cache shares the model with other instances, nullptr for the built-in one. */
+    std::shared_ptr<RNNModel> m_model;
+
+    /* States for all channels prepared by setModelPath(). The processing thread swaps them with
+     * the current ones, which are then freed by the next setModelPath(), init() or deinit().
+     * It only ever try-locks the mutex, so setModelPath() can never block it.
+     */
+    struct PendingStates {
+        std::vector<std::shared_ptr<DenoiseState>> states;
+        bool applied;
+    };
+    std::mutex m_pendingStatesMutex;
+    std::unique_ptr<PendingStates> m_pendingStates;
 };
 
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+
+#include "common/RnNoiseCommonPlugin.h"
+
+/**
+ * RnNoiseCommonPlugin for a channel count known at compile time, the mono and stereo plugins.
+ * Channels live in fixed-size arrays, so the channel loops are unrolled, and the VAD probability
+ * of each denoised block is aggregated right after it is denoised.
+ * RnNoiseCommonPlugin stays the implementation for any other channel layout.
+ */
+template<uint32_t Channels>
+class RnNoiseCommonPluginT : public RnNoiseCommonPlugin {
+    static_assert(Channels == 1 || Channels == 2, "Only mono and stereo are specialized");
+
+public:
+    explicit RnNoiseCommonPluginT(size_t maxBlockFrames = k_defaultMaxBlockFrames) :
+            RnNoiseCommonPlugin(Channels, maxBlockFrames) {}
+
+private:
+    void onChannelsCreated() override;
+
+    void denoiseAllChannels(const HostInput &in, size_t offset, size_t sampleFrames) override;
+
+    void writeOutput(const HostOutput &out, size_t outOffset, uint64_t blockIdx, size_t blockOffset,
+                     size_t frames) const override;
+
+    /* Denoises blockCount consecutive blocks of the inputs starting at firstBlockIdx, mono takes
+     * up to k_maxBlocksPerDenoise of them at once, stereo a single block of both channels.
+     */
+    void denoisePendingBlocks(uint64_t firstBlockIdx, size_t blockCount, const float *const *inputs);
+
+    /* The channels' queues, fixed from init() on. */
+    std::array<float *, Channels> m_inputBlocks{};
+    std::array<float *, Channels> m_outputBlocks{};
+};
+
+extern template class RnNoiseCommonPluginT<1>;
+extern template class RnNoiseCommonPluginT<2>;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+struct RNNModel;
+
+/**
+ * Custom rnnoise models shared by every plugin instance of the process. A model stays loaded
+ * while anything holds it, instances loading the same file get the same model, so memory and
+ * load time don't grow with the amount of instances or channels.
+ */
+class RnNoiseModelCache {
+public:
+    /**
+     * The model in the file at path, keyed by the path and a hash of the contents so that an
+     * updated file is loaded again. Reads the whole file, never call it from the audio thread.
+     * The file is mapped, see rnnoise_model_from_filename(), so it must be updated by renaming
+     * a new file over it, not by writing to it while a model loaded from it is in use.
+     * Thread safe.
+     * @return nullptr if the file can't be read or isn't a valid model.
+     */
+    static std::shared_ptr<RNNModel> acquire(const std::string &path);
+
+    /* How many different models are loaded right now. Thread safe. */
+    static size_t loadedModels();
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads which run a task for a range of indices, e.g. for groups of channels
+ * of a single block. The calling thread takes part in the work and returns once every task is
+ * done. Workers spin for a while after the work is done so that the next block doesn't have
+ * to wake them up, and only then park.
+ */
+class RnNoiseWorkerPool {
+public:
+    struct Config {
+        /* Threads in addition to the calling one, 0 disables the pool. */
+        uint32_t workers = 0;
+        /* CPU each worker is pinned to, missing or negative entries leave the worker unpinned.
+         * Only supported on Linux and Windows.
+         */
+        std::vector<int> cpuAffinity;
+        /* How long an idle worker spins waiting for the next run() before parking. */
+        std::chrono::microseconds spinTime{500};
+    };
+
+    using Task = void (*)(void *context, size_t taskIdx);
+
+    /* Not real-time safe, starts the threads. */
+    explicit RnNoiseWorkerPool(const Config &config);
+
+    ~RnNoiseWorkerPool();
+
+    RnNoiseWorkerPool(const RnNoiseWorkerPool &) = delete;
+
+    RnNoiseWorkerPool &operator=(const RnNoiseWorkerPool &) = delete;
+
+    uint32_t getWorkerCount() const {
+        return static_cast<uint32_t>(m_threads.size());
+    }
+
+    /**
+     * Calls task(context, i) for every i < taskCount, in parallel, and waits for all of them.
+     * Doesn't allocate. Must not be called concurrently.
+     */
+    void run(size_t taskCount, Task task, void *context);
+
+private:
+    void workerLoop(uint32_t workerIdx);
+
+    void runTasks();
+
+    static void setCurrentThreadAffinity(int cpu);
+
+private:
+    /* Claimed tasks are packed into one word together with the run generation and the task
+     * count, so a worker that is late for a run can never claim a task of the next one.
+     */
+    static const int k_taskIdxBits = 20;
+    static const uint64_t k_taskIdxMask = (uint64_t(1) << k_taskIdxBits) - 1;
+
+    Config m_config;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<uint64_t> m_tasks{0};
+    std::atomic<Task> m_task{nullptr};
+    std::atomic<void *> m_context{nullptr};
+    std::atomic<size_t> m_doneTasks{0};
+    uint64_t m_generation = 0;
+
+    /* Last started generation, workers wait for it to change. */
+    std::atomic<uint64_t> m_startedGeneration{0};
+    std::atomic<uint32_t> m_parkedWorkers{0};
+    std::atomic<bool> m_stopping{false};
+    std::mutex m_parkMutex;
+    std::condition_variable m_parkCondition;
+};
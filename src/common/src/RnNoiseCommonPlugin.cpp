@@ -1,30 +1,185 @@
 #include "common/RnNoiseCommonPlugin.h"
+#include "common/RnNoiseModelCache.h"
 
 #include <cstring>
-#include <limits>
+#include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <thread>
 
 #include <rnnoise.h>
 
 static const uint32_t k_minVADGracePeriodBlocks = 20;
 static const uint32_t k_maxRetroactiveVADGraceBlocks = 99;
+/* A dropped block skips 10 ms of audio, more per call would be audible despite the crossfade. */
+static const uint32_t k_maxDroppedBlocksPerCall = 1;
+/* Full scale of 16 bit samples, the same scale rnnoise uses for floats. */
+static const float k_int16Scale = 32767.f;
+
+const size_t RnNoiseCommonPlugin::k_denoiseBlockSize;
+const size_t RnNoiseCommonPlugin::k_maxChannelsPerGroup;
+const size_t RnNoiseCommonPlugin::k_maxBlocksPerDenoise;
+const size_t RnNoiseCommonPlugin::k_denoiseLatencyFrames;
+const size_t RnNoiseCommonPlugin::k_profiledStages;
+const size_t RnNoiseCommonPlugin::k_valuesPerStageTiming;
+
+static size_t greatestCommonDivisor(size_t a, size_t b) {
+    while (b != 0) {
+        size_t rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+}
+
+struct RnNoiseCommonPlugin::DenoiseJob {
+    RnNoiseCommonPlugin *plugin;
+    const HostInput *in;
+    size_t offset;
+    size_t sampleFrames;
+};
+
+void RnNoiseCommonPlugin::setWorkerPoolConfig(const RnNoiseWorkerPool::Config &config) {
+    m_workerPoolConfig = config;
+}
+
+void RnNoiseCommonPlugin::setHostBlockFrames(size_t hostBlockFrames) {
+    m_hostBlockFrames = hostBlockFrames;
+
+    bool nothingProcessed = m_newOutputIdx == 0 && m_inputBlockFrames == 0 && m_currentOutputOffset == 0;
+    if (nothingProcessed) {
+        m_primingFrames = computeQueueLatencyFrames(m_hostBlockFrames, m_prevRetroactiveVADGraceBlocks);
+    }
+}
+
+uint32_t RnNoiseCommonPlugin::computeLatencyFrames(size_t hostBlockFrames, uint32_t retroactiveVADGraceBlocks) {
+    return static_cast<uint32_t>(k_denoiseLatencyFrames
+                                 + computeQueueLatencyFrames(hostBlockFrames, retroactiveVADGraceBlocks));
+}
+
+size_t RnNoiseCommonPlugin::computeQueueLatencyFrames(size_t hostBlockFrames, uint32_t retroactiveVADGraceBlocks) {
+    retroactiveVADGraceBlocks = std::min(retroactiveVADGraceBlocks, k_maxRetroactiveVADGraceBlocks);
+
+    /* After n calls n * hostBlockFrames frames were written, but only whole blocks were denoised,
+     * so the queue runs short by (n * hostBlockFrames) % k_denoiseBlockSize frames. The largest
+     * such remainder is k_denoiseBlockSize - gcd(hostBlockFrames, k_denoiseBlockSize).
+     */
+    size_t blockRemainderFrames = 0;
+    if (hostBlockFrames % k_denoiseBlockSize != 0) {
+        blockRemainderFrames = k_denoiseBlockSize - greatestCommonDivisor(hostBlockFrames, k_denoiseBlockSize);
+    }
+
+    return blockRemainderFrames + k_denoiseBlockSize * retroactiveVADGraceBlocks;
+}
+
+bool RnNoiseCommonPlugin::setModelPath(const std::string &path) {
+    std::shared_ptr<RNNModel> model;
+    if (!path.empty()) {
+        model = RnNoiseModelCache::acquire(path);
+        if (!model) {
+            return false;
+        }
+    }
+    m_modelPath = path;
+    m_model = std::move(model);
+
+    /* Before init() the states are created with the model there. */
+    if (m_channels.empty()) {
+        return true;
+    }
+
+    std::unique_ptr<PendingStates> pending(new PendingStates{{}, false});
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        pending->states.push_back(createChannelState());
+    }
+    RNNoiseMemoryFootprint footprint;
+    rnnoise_get_memory_footprint(pending->states.front().get(), &footprint);
+    m_memoryFootprint.modelBytes = static_cast<size_t>(footprint.model_bytes);
+
+    /* Whatever was pending before, either never swapped in or already swapped out, is freed here. */
+    std::unique_ptr<PendingStates> previous;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingStatesMutex);
+        previous = std::move(m_pendingStates);
+        m_pendingStates = std::move(pending);
+    }
+    return true;
+}
+
+void RnNoiseCommonPlugin::applyPendingStates() {
+    std::unique_lock<std::mutex> lock(m_pendingStatesMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !m_pendingStates || m_pendingStates->applied) {
+        return;
+    }
+
+    /* Only swaps, the old states are freed by the thread which set the model. */
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        std::swap(m_channels[i].denoiseState, m_pendingStates->states[i]);
+        m_batchStates[i] = m_channels[i].denoiseState.get();
+    }
+    m_pendingStates->applied = true;
+}
 
 void RnNoiseCommonPlugin::init() {
     deinit();
     createDenoiseState();
-    resetStats();
+    m_stats = {};
+    publishStats();
+    m_stageTimingsRequested = true;
+    publishStageTimings();
 }
 
 void RnNoiseCommonPlugin::deinit() {
+    m_workerPool.reset();
+    m_pendingStates.reset();
     m_channels.clear();
+    m_blocksStorage = {};
+    m_outputMaxVadProbability = {};
+    m_outputMuteState = {};
+    m_crossfadeFrames = {};
+    m_batchStates = {};
+    m_batchInputs = {};
+    m_batchOutputs = {};
+    m_batchVadProbability = {};
 }
 
 void
 RnNoiseCommonPlugin::process(const float *const *in, float **out, size_t sampleFrames, float vadThreshold,
                              uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks) {
+    processHost(HostInput{SampleLayout::PLANAR, in, nullptr, 1}, HostOutput{SampleLayout::PLANAR, out, nullptr, 1},
+                sampleFrames, vadThreshold, vadGracePeriodBlocks, retroactiveVADGraceBlocks);
+}
+
+void RnNoiseCommonPlugin::processInterleaved(const float *in, float *out, size_t sampleFrames, uint32_t stride,
+                                             float vadThreshold, uint32_t vadGracePeriodBlocks,
+                                             uint32_t retroactiveVADGraceBlocks) {
+    assert(stride >= m_channelCount);
+
+    /* A single channel without gaps is planar. */
+    if (stride == 1) {
+        process(&in, &out, sampleFrames, vadThreshold, vadGracePeriodBlocks, retroactiveVADGraceBlocks);
+        return;
+    }
+    processHost(HostInput{SampleLayout::INTERLEAVED_FLOAT, nullptr, in, stride},
+                HostOutput{SampleLayout::INTERLEAVED_FLOAT, nullptr, out, stride},
+                sampleFrames, vadThreshold, vadGracePeriodBlocks, retroactiveVADGraceBlocks);
+}
+
+void RnNoiseCommonPlugin::processInterleaved(const int16_t *in, int16_t *out, size_t sampleFrames, uint32_t stride,
+                                             float vadThreshold, uint32_t vadGracePeriodBlocks,
+                                             uint32_t retroactiveVADGraceBlocks) {
+    assert(stride >= m_channelCount);
+
+    processHost(HostInput{SampleLayout::INTERLEAVED_INT16, nullptr, in, stride},
+                HostOutput{SampleLayout::INTERLEAVED_INT16, nullptr, out, stride},
+                sampleFrames, vadThreshold, vadGracePeriodBlocks, retroactiveVADGraceBlocks);
+}
+
+void RnNoiseCommonPlugin::processHost(const HostInput &in, const HostOutput &out, size_t sampleFrames,
+                                      float vadThreshold, uint32_t vadGracePeriodBlocks,
+                                      uint32_t retroactiveVADGraceBlocks) {
     /* TODO: Option to output noise when channel is muted;
-     * TODO: Remove blocks in output queue when retroactiveVADGraceBlocks is reduced;
      */
 
     assert(vadThreshold >= 0.f && vadThreshold <= 1.f);
@@ -33,12 +188,7 @@ RnNoiseCommonPlugin::process(const float *const *in, float **out, size_t sampleF
         return;
     }
 
-    if (m_prevRetroactiveVADGraceBlocks > retroactiveVADGraceBlocks) {
-        /* TODO: do not be lazy and adjust output queue directly.
-         * For now, just re-init the plugin to prevent excess latency.
-         */
-        init();
-    }
+    applyPendingStates();
 
     /* For offline processing hosts could pass a lot of frames at once, there is also no
      * indicator whether additional frames are expected. By default, we accumulate enough
@@ -50,236 +200,716 @@ RnNoiseCommonPlugin::process(const float *const *in, float **out, size_t sampleF
      */
     bool waitForEnoughFrames = sampleFrames < (k_denoiseBlockSize * 50);
 
-    m_prevRetroactiveVADGraceBlocks = retroactiveVADGraceBlocks;
-
-    RnNoiseStats stats = m_stats.load();
+    RnNoiseStats &stats = m_stats;
 
     vadGracePeriodBlocks = std::max(vadGracePeriodBlocks, k_minVADGracePeriodBlocks);
     retroactiveVADGraceBlocks = std::min(retroactiveVADGraceBlocks, k_maxRetroactiveVADGraceBlocks);
 
-    /* Copy input data (since we are not allowed to change it inplace) */
-    for (auto &channel: m_channels) {
-        size_t newSamplesStart = channel.rnnoiseInput.size();
-        channel.rnnoiseInput.insert(channel.rnnoiseInput.end(), in[channel.idx], in[channel.idx] + sampleFrames);
-        float *inMultiplied = &channel.rnnoiseInput[newSamplesStart];
-        for (size_t i = 0; i < sampleFrames; i++) {
-            inMultiplied[i] = inMultiplied[i] * std::numeric_limits<short>::max();
+    /* Output queue holds retroactiveVADGraceBlocks blocks of latency. When it is reduced the excess
+     * blocks are dropped from the queue, when it is increased the queue just grows by waiting,
+     * or by writing the planned silence if the host block size is known.
+     */
+    if (retroactiveVADGraceBlocks < m_prevRetroactiveVADGraceBlocks) {
+        m_outputBlocksToDrop += m_prevRetroactiveVADGraceBlocks - retroactiveVADGraceBlocks;
+    } else {
+        uint32_t addedBlocks = retroactiveVADGraceBlocks - m_prevRetroactiveVADGraceBlocks;
+        uint32_t cancelledDrops = std::min(m_outputBlocksToDrop, addedBlocks);
+        m_outputBlocksToDrop -= cancelledDrops;
+        if (m_hostBlockFrames > 0) {
+            m_primingFrames += (addedBlocks - cancelledDrops) * k_denoiseBlockSize;
+        }
+    }
+    m_prevRetroactiveVADGraceBlocks = retroactiveVADGraceBlocks;
+
+    /* Queues are preallocated for m_maxBlockFrames, anything bigger is processed in parts. */
+    for (size_t offset = 0; offset < sampleFrames; offset += m_maxBlockFrames) {
+        processPart(in, out, offset, std::min(m_maxBlockFrames, sampleFrames - offset), vadThreshold,
+                    vadGracePeriodBlocks, retroactiveVADGraceBlocks, waitForEnoughFrames, stats);
+    }
+
+    publishStats();
+    publishStageTimings();
+}
+
+size_t
+RnNoiseCommonPlugin::processOffline(const float *const *in, float **out, size_t sampleFrames, float vadThreshold,
+                                    uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks) {
+    assert(vadThreshold >= 0.f && vadThreshold <= 1.f);
+    assert(!m_offlineFlushed);
+
+    applyPendingStates();
+
+    RnNoiseStats &stats = m_stats;
+
+    m_offlineVadThreshold = vadThreshold;
+    m_offlineVadGracePeriodBlocks = std::max(vadGracePeriodBlocks, k_minVADGracePeriodBlocks);
+    m_offlineRetroactiveVADGraceBlocks = std::min(retroactiveVADGraceBlocks, k_maxRetroactiveVADGraceBlocks);
+
+    /* Input goes to rnnoise in parts which fit the queue, each part lets us write out what is
+     * already denoised so the queue never holds more than a few blocks.
+     */
+    HostInput hostIn{SampleLayout::PLANAR, in, nullptr, 1};
+    size_t writtenFrames = 0;
+    for (size_t offset = 0; offset < sampleFrames; offset += m_maxBlockFrames) {
+        size_t partFrames = std::min(m_maxBlockFrames, sampleFrames - offset);
+        uint64_t firstNewOutputIdx = denoiseInput(hostIn, offset, partFrames);
+        updateMuteStates(firstNewOutputIdx, m_offlineVadThreshold, m_offlineVadGracePeriodBlocks,
+                         m_offlineRetroactiveVADGraceBlocks, stats);
+        m_offlineInputFrames += partFrames;
+
+        /* Later blocks can still unmute the last retroactiveVADGraceBlocks blocks. */
+        uint64_t finalBlocks = m_newOutputIdx - std::min<uint64_t>(m_newOutputIdx, m_offlineRetroactiveVADGraceBlocks);
+        writtenFrames += writeOfflineOutput(out, writtenFrames, sampleFrames - writtenFrames, finalBlocks, stats);
+    }
+
+    publishStats();
+    publishStageTimings();
+    return writtenFrames;
+}
+
+size_t RnNoiseCommonPlugin::flush(float **out, size_t maxFrames) {
+    RnNoiseStats &stats = m_stats;
+
+    if (!m_offlineFlushed) {
+        m_offlineFlushed = true;
+
+        /* Feed silence until rnnoise has output for every input frame, no more input means
+         * every block is final.
+         */
+        uint64_t neededFrames = m_offlineInputFrames + k_denoiseLatencyFrames;
+        uint64_t neededBlocks = (neededFrames + k_denoiseBlockSize - 1) / k_denoiseBlockSize;
+        std::vector<float> silence(k_denoiseBlockSize, 0.f);
+        std::vector<const float *> silenceInputs(m_channelCount, silence.data());
+        HostInput silenceInput{SampleLayout::PLANAR, silenceInputs.data(), nullptr, 1};
+        while (m_newOutputIdx < neededBlocks) {
+            uint64_t firstNewOutputIdx = denoiseInput(silenceInput, 0, k_denoiseBlockSize - m_inputBlockFrames);
+            updateMuteStates(firstNewOutputIdx, m_offlineVadThreshold, m_offlineVadGracePeriodBlocks,
+                             m_offlineRetroactiveVADGraceBlocks, stats);
         }
     }
 
-    size_t blocksFromRnnoise = m_channels[0].rnnoiseInput.size() / k_denoiseBlockSize;
+    size_t frames = static_cast<size_t>(std::min<uint64_t>(maxFrames, m_offlineInputFrames - m_offlineOutputFrames));
+    size_t writtenFrames = writeOfflineOutput(out, 0, frames, m_newOutputIdx, stats);
+
+    publishStats();
+    publishStageTimings();
+    return writtenFrames;
+}
+
+size_t RnNoiseCommonPlugin::writeOfflineOutput(float **out, size_t outOffset, size_t maxFrames,
+                                               uint64_t finalBlocks, RnNoiseStats &stats) {
+    /* Output frame i is rnnoise's output frame i + k_denoiseLatencyFrames, so the output lines
+     * up with the input without any leading silence.
+     */
+    uint64_t queueFrame = m_offlineOutputFrames + k_denoiseLatencyFrames;
+    uint64_t finalFrames = finalBlocks * k_denoiseBlockSize;
+    size_t frames = finalFrames > queueFrame
+                    ? static_cast<size_t>(std::min<uint64_t>(finalFrames - queueFrame, maxFrames)) : 0;
+
+    uint64_t blockIdx = queueFrame / k_denoiseBlockSize;
+    size_t blockOffset = static_cast<size_t>(queueFrame % k_denoiseBlockSize);
+    writeOutput(HostOutput{SampleLayout::PLANAR, out, nullptr, 1}, outOffset, blockIdx, blockOffset, frames);
+
+    m_offlineOutputFrames += frames;
+    queueFrame += frames;
+    m_currentOutputIdxToOutput = queueFrame / k_denoiseBlockSize;
+    m_currentOutputOffset = static_cast<size_t>(queueFrame % k_denoiseBlockSize);
+
+    /* Keep written blocks only for the retroactive VAD, like process() does. */
+    uint64_t retainedIdx = std::min(m_currentOutputIdxToOutput, m_newOutputIdx);
+    retainedIdx -= std::min<uint64_t>(retainedIdx, m_offlineRetroactiveVADGraceBlocks);
+    m_oldestOutputIdx = std::max(m_oldestOutputIdx, retainedIdx);
+
+    stats.blocksWaitingForOutput = m_newOutputIdx > m_currentOutputIdxToOutput
+                                   ? static_cast<uint32_t>(m_newOutputIdx - m_currentOutputIdxToOutput) : 0;
+    return frames;
+}
+
+void
+RnNoiseCommonPlugin::processPart(const HostInput &in, const HostOutput &out, size_t offset, size_t sampleFrames,
+                                 float vadThreshold, uint32_t vadGracePeriodBlocks,
+                                 uint32_t retroactiveVADGraceBlocks, bool waitForEnoughFrames,
+                                 RnNoiseStats &stats) {
+    uint64_t firstNewOutputIdx = denoiseInput(in, offset, sampleFrames);
+    updateMuteStates(firstNewOutputIdx, vadThreshold, vadGracePeriodBlocks, retroactiveVADGraceBlocks, stats);
+
+    /* The planned latency is written first and doesn't count as forced zeroes. */
+    size_t primingFrames = std::min(m_primingFrames, sampleFrames);
+    m_primingFrames -= primingFrames;
+    size_t framesWanted = sampleFrames - primingFrames;
+
+    size_t availableFrames = static_cast<size_t>(m_newOutputIdx - m_currentOutputIdxToOutput) * k_denoiseBlockSize
+                             - m_currentOutputOffset;
+    size_t framesNeeded = framesWanted + k_denoiseBlockSize * retroactiveVADGraceBlocks;
+    bool hasEnoughFrames = availableFrames >= framesNeeded;
+
+    /* Wait until there are enough frames to fill all the output. Yes, it creates latency but
+     * That's why it is STRONGLY recommended for sampleFrames to be divisible by k_denoiseBlockSize,
+     * or to plan the latency with setHostBlockFrames().
+     */
+    if (waitForEnoughFrames && !hasEnoughFrames) {
+        for (uint32_t channelIdx = 0; channelIdx < m_channelCount; channelIdx++) {
+            writeHostOutput(out, channelIdx, offset, sampleFrames, nullptr);
+        }
+
+        stats.outputFramesForcedToBeZeroed += framesWanted;
+        stats.blocksWaitingForOutput = 0;
+        return;
+    }
 
-    /* Do all the denoising. Separating output into chunks containing additional metadata
-     * allows to divide code in a more simple and comprehensible chunks, also allows to
-     * reuse memory allocations.
+    /* Drop at most as many blocks as we have over what current retroactiveVADGraceBlocks needs, and
+     * at most k_maxDroppedBlocksPerCall of them so the latency drops smoothly, each drop behind its
+     * own crossfade. The rest waits for the next calls.
      */
+    uint32_t blocksToDrop = 0;
+    if (m_outputBlocksToDrop > 0) {
+        size_t excessBlocks = availableFrames > framesNeeded ? (availableFrames - framesNeeded) / k_denoiseBlockSize : 0;
+        blocksToDrop = static_cast<uint32_t>(std::min<size_t>({m_outputBlocksToDrop, excessBlocks,
+                                                               k_maxDroppedBlocksPerCall}));
+        m_outputBlocksToDrop -= blocksToDrop;
+    }
+
+    size_t framesFromQueue = std::min(availableFrames - blocksToDrop * k_denoiseBlockSize, framesWanted);
+    size_t queueOffset = offset + primingFrames;
+    writeOutput(out, queueOffset, m_currentOutputIdxToOutput + blocksToDrop, m_currentOutputOffset, framesFromQueue);
     for (auto &channel: m_channels) {
-        for (size_t blockIdx = 0; blockIdx < blocksFromRnnoise; blockIdx++) {
-            std::unique_ptr<OutputChunk> outBlock;
-            if (channel.outputBlocksCache.empty()) {
-                outBlock = std::make_unique<OutputChunk>();
-            } else {
-                outBlock = std::move(channel.outputBlocksCache.back());
-                channel.outputBlocksCache.pop_back();
+        writeHostOutput(out, channel.idx, offset, primingFrames, nullptr);
+
+        if (blocksToDrop > 0) {
+            /* Crossfade from the dropped part of the queue to avoid a click. */
+            size_t fadeFrames = std::min(framesFromQueue, k_denoiseBlockSize);
+            float *fadeOut = m_crossfadeFrames.data();
+            float *fadeIn = m_crossfadeFrames.data() + k_denoiseBlockSize;
+            readOutputQueue(channel, m_currentOutputIdxToOutput, m_currentOutputOffset, fadeOut, fadeFrames);
+            readOutputQueue(channel, m_currentOutputIdxToOutput + blocksToDrop, m_currentOutputOffset, fadeIn,
+                            fadeFrames);
+            for (size_t i = 0; i < fadeFrames; i++) {
+                float fadeInGain = static_cast<float>(i + 1) / static_cast<float>(fadeFrames + 1);
+                fadeOut[i] = fadeOut[i] * (1.f - fadeInGain) + fadeIn[i] * fadeInGain;
             }
+            writeHostOutput(out, channel.idx, queueOffset, fadeFrames, fadeOut);
+        }
 
-            outBlock->curOffset = 0;
-            outBlock->idx = m_newOutputIdx + blockIdx;
-            outBlock->muteState = ChunkUnmuteState::UNMUTED_BY_DEFAULT;
+        writeHostOutput(out, channel.idx, queueOffset + framesFromQueue, framesWanted - framesFromQueue, nullptr);
+    }
 
-            float *currentIn = &channel.rnnoiseInput[blockIdx * k_denoiseBlockSize];
-            outBlock->vadProbability = rnnoise_process_frame(channel.denoiseState.get(),
-                                                             outBlock->frames,
-                                                             currentIn);
+    stats.outputFramesForcedToBeZeroed += framesWanted - framesFromQueue;
 
-            channel.rnnoiseOutput.push_back(std::move(outBlock));
-        }
+    size_t outputOffset = m_currentOutputOffset + framesFromQueue;
+    m_currentOutputIdxToOutput += blocksToDrop + outputOffset / k_denoiseBlockSize;
+    m_currentOutputOffset = outputOffset % k_denoiseBlockSize;
+
+    /* Already written blocks are kept for retroactiveVADGraceBlocks, the rest of the queue is free. */
+    uint64_t blocksToLeave = (m_newOutputIdx - m_currentOutputIdxToOutput) + retroactiveVADGraceBlocks;
+    if (m_newOutputIdx - m_oldestOutputIdx > blocksToLeave) {
+        m_oldestOutputIdx = m_newOutputIdx - blocksToLeave;
+    }
+
+    stats.blocksWaitingForOutput = static_cast<uint32_t>(m_newOutputIdx - m_currentOutputIdxToOutput);
+}
 
-        if (blocksFromRnnoise > 0) {
-            /* Erasing is cheap since it just copies the elements that are left to the beginning of the vector. */
-            channel.rnnoiseInput.erase(channel.rnnoiseInput.begin(),
-                                       channel.rnnoiseInput.begin() + blocksFromRnnoise * k_denoiseBlockSize);
+uint64_t RnNoiseCommonPlugin::denoiseInput(const HostInput &in, size_t offset, size_t sampleFrames) {
+    size_t blocksFromRnnoise = (m_inputBlockFrames + sampleFrames) / k_denoiseBlockSize;
+
+    /* Queue capacity accounts for the worst case, so this should never happen. But if it does,
+     * the oldest blocks are dropped instead of writing out of bounds.
+     */
+    if (m_newOutputIdx + blocksFromRnnoise - m_oldestOutputIdx > m_outputBlocksCapacity) {
+        m_oldestOutputIdx = m_newOutputIdx + blocksFromRnnoise - m_outputBlocksCapacity;
+        if (m_currentOutputIdxToOutput < m_oldestOutputIdx) {
+            m_currentOutputIdxToOutput = m_oldestOutputIdx;
+            m_currentOutputOffset = 0;
         }
     }
 
+    /* Do all the denoising, channel groups are independent until the VAD aggregation. */
+    if (m_workerPool) {
+        DenoiseJob job{this, &in, offset, sampleFrames};
+        m_workerPool->run(m_channelGroupCount, &RnNoiseCommonPlugin::denoiseChannelGroup, &job);
+        aggregateVadProbability(m_newOutputIdx, m_newOutputIdx + blocksFromRnnoise);
+    } else {
+        denoiseAllChannels(in, offset, sampleFrames);
+    }
+
+    m_inputBlockFrames = (m_inputBlockFrames + sampleFrames) % k_denoiseBlockSize;
+
+    uint64_t firstNewOutputIdx = m_newOutputIdx;
     m_newOutputIdx += blocksFromRnnoise;
+    return firstNewOutputIdx;
+}
+
+void RnNoiseCommonPlugin::denoiseAllChannels(const HostInput &in, size_t offset, size_t sampleFrames) {
+    uint64_t firstBlockIdx = m_newOutputIdx;
+    denoiseChannels(in, offset, sampleFrames, 0, m_channels.size());
+    aggregateVadProbability(firstBlockIdx, firstBlockIdx + (m_inputBlockFrames + sampleFrames) / k_denoiseBlockSize);
+}
 
+void RnNoiseCommonPlugin::aggregateVadProbability(uint64_t firstBlockIdx, uint64_t endBlockIdx) {
     /* We either mute ALL channels or none, so we have to calculate the max VAD
      * probability across each output block.
      */
-    for (uint32_t blockIdx = 0; blockIdx < blocksFromRnnoise; blockIdx++) {
-        float maxVadProbability = 0.f;
-        auto getCurOut = [blockIdx, blocksFromRnnoise](ChannelData &channel) {
-            return channel.rnnoiseOutput.rbegin()[blocksFromRnnoise - blockIdx - 1].get();
-        };
+    for (uint64_t blockIdx = firstBlockIdx; blockIdx < endBlockIdx; blockIdx++) {
+        size_t slot = blockSlot(blockIdx);
 
+        float maxVadProbability = 0.f;
         for (auto &channel: m_channels) {
-            maxVadProbability = std::max(getCurOut(channel)->vadProbability, maxVadProbability);
+            maxVadProbability = std::max(channel.vadProbability[slot], maxVadProbability);
         }
 
-        for (auto &channel: m_channels) {
-            getCurOut(channel)->maxVadProbability = maxVadProbability;
-        }
+        m_outputMaxVadProbability[slot] = maxVadProbability;
+    }
+}
+
+void RnNoiseCommonPlugin::updateMuteStates(uint64_t firstNewOutputIdx, float vadThreshold,
+                                           uint32_t vadGracePeriodBlocks, uint32_t retroactiveVADGraceBlocks,
+                                           RnNoiseStats &stats) {
+    uint64_t blocksFromRnnoise = m_newOutputIdx - firstNewOutputIdx;
+
+    /* The max VAD probability over the channels was set along with the denoising. */
+    for (uint64_t blockIdx = firstNewOutputIdx; blockIdx < m_newOutputIdx; blockIdx++) {
+        size_t slot = blockSlot(blockIdx);
+
+        float maxVadProbability = m_outputMaxVadProbability[slot];
+        m_outputMuteState[slot] = ChunkUnmuteState::UNMUTED_BY_DEFAULT;
 
         if (maxVadProbability >= vadThreshold) {
-            m_lastOutputIdxOverVADThreshold = getCurOut(m_channels[0])->idx;
+            m_lastOutputIdxOverVADThreshold = blockIdx;
         } else {
             /* Calculate grace period */
-            for (auto &channel: m_channels) {
-                auto curOut = getCurOut(channel);
-                bool inVadPeriod = (curOut->idx - m_lastOutputIdxOverVADThreshold) <= vadGracePeriodBlocks;
-                if (inVadPeriod) {
-                    assert(curOut->muteState == ChunkUnmuteState::UNMUTED_BY_DEFAULT);
-                    curOut->muteState = ChunkUnmuteState::UNMUTED_VAD;
-                    if (channel.idx == 0) {
-                        stats.vadGraceBlocks++;
-                    }
-                } else {
-                    curOut->muteState = ChunkUnmuteState::MUTED;
-                }
+            bool inVadPeriod = (blockIdx - m_lastOutputIdxOverVADThreshold) <= vadGracePeriodBlocks;
+            if (inVadPeriod) {
+                m_outputMuteState[slot] = ChunkUnmuteState::UNMUTED_VAD;
+                stats.vadGraceBlocks++;
+            } else {
+                m_outputMuteState[slot] = ChunkUnmuteState::MUTED;
             }
         }
     }
 
     if (retroactiveVADGraceBlocks > 0) {
-        for (auto &channel: m_channels) {
-            uint64_t lastBlockIdxOverVADThreshold = 0;
-            for (uint32_t blockIdx = 0; blockIdx < (blocksFromRnnoise + retroactiveVADGraceBlocks); blockIdx++) {
-                if (blockIdx >= channel.rnnoiseOutput.size()) {
-                    break;
-                }
-
-                auto &outBlock = channel.rnnoiseOutput.rbegin()[blockIdx];
-                if (outBlock->maxVadProbability >= vadThreshold) {
-                    lastBlockIdxOverVADThreshold = outBlock->idx;
-                } else if (outBlock->muteState == ChunkUnmuteState::MUTED) {
-                    bool inVadPeriod = (lastBlockIdxOverVADThreshold - outBlock->idx) <= retroactiveVADGraceBlocks;
-                    if (inVadPeriod) {
-                        outBlock->muteState = ChunkUnmuteState::UNMUTED_RETRO_VAD;
-                        if (channel.idx == 0) {
-                            stats.retroactiveVADGraceBlocks++;
-                        }
-                    }
+        uint64_t blocksToCheck = std::min<uint64_t>(blocksFromRnnoise + retroactiveVADGraceBlocks,
+                                                    m_newOutputIdx - m_oldestOutputIdx);
+        uint64_t lastBlockIdxOverVADThreshold = 0;
+        for (uint64_t blockIdx = m_newOutputIdx; blockIdx-- > m_newOutputIdx - blocksToCheck;) {
+            size_t slot = blockSlot(blockIdx);
+            if (m_outputMaxVadProbability[slot] >= vadThreshold) {
+                lastBlockIdxOverVADThreshold = blockIdx;
+            } else if (m_outputMuteState[slot] == ChunkUnmuteState::MUTED) {
+                bool inVadPeriod = (lastBlockIdxOverVADThreshold - blockIdx) <= retroactiveVADGraceBlocks;
+                if (inVadPeriod) {
+                    m_outputMuteState[slot] = ChunkUnmuteState::UNMUTED_RETRO_VAD;
+                    stats.retroactiveVADGraceBlocks++;
                 }
             }
         }
     }
+}
 
-    for (auto &channel: m_channels) {
-        for (size_t blockIdx = channel.rnnoiseOutput.size() - blocksFromRnnoise;
-             blockIdx < channel.rnnoiseOutput.size(); blockIdx++) {
-            auto &outBlock = channel.rnnoiseOutput[blockIdx];
-            for (float &frame: outBlock->frames) {
-                frame /= std::numeric_limits<short>::max();
+void RnNoiseCommonPlugin::denoiseChannelGroup(void *job, size_t groupIdx) {
+    auto &denoiseJob = *static_cast<DenoiseJob *>(job);
+    RnNoiseCommonPlugin &plugin = *denoiseJob.plugin;
+    size_t firstChannel = groupIdx * plugin.m_channelGroupSize;
+    size_t channelCount = std::min(plugin.m_channelGroupSize, plugin.m_channels.size() - firstChannel);
+    plugin.denoiseChannels(*denoiseJob.in, denoiseJob.offset, denoiseJob.sampleFrames, firstChannel, channelCount);
+}
+
+void RnNoiseCommonPlugin::denoiseChannels(const HostInput &in, size_t offset, size_t sampleFrames,
+                                          size_t firstChannel, size_t channelCount) {
+    /* Input is accumulated in the channels' input blocks until there are enough frames for
+     * rnnoise, then all channels of the group are denoised at once so they share the RNN
+     * weight loads. A single channel instead collects up to k_maxBlocksPerDenoise blocks
+     * which share the weight loads of the parts of the RNN which don't need the previous
+     * block. Output goes directly into the output queue.
+     * Whole blocks of planar input are denoised straight from the host buffers when nothing is
+     * accumulated, rnnoise reads and writes the host's [-1, 1] samples itself. Interleaved input
+     * is deinterleaved by the copy into the input blocks.
+     */
+    bool planar = in.layout == SampleLayout::PLANAR;
+    bool batchBlocks = channelCount == 1;
+    size_t inputBlockFrames = m_inputBlockFrames;
+    size_t pendingBlocks = 0;
+    uint64_t blockIdx = m_newOutputIdx;
+    for (size_t frameIdx = 0; frameIdx < sampleFrames;) {
+        size_t remainingFrames = sampleFrames - frameIdx;
+        if (planar && inputBlockFrames == 0 && pendingBlocks == 0 && remainingFrames >= k_denoiseBlockSize) {
+            if (!batchBlocks) {
+                denoiseBlock(blockSlot(blockIdx), firstChannel, channelCount, in.planar, offset + frameIdx);
+                blockIdx++;
+                frameIdx += k_denoiseBlockSize;
+            } else {
+                auto &channel = m_channels[firstChannel];
+                size_t blockCount = std::min(remainingFrames / k_denoiseBlockSize, k_maxBlocksPerDenoise);
+                denoiseBlocks(blockIdx, blockCount, channel, in.planar[channel.idx] + offset + frameIdx);
+                blockIdx += blockCount;
+                frameIdx += blockCount * k_denoiseBlockSize;
             }
+            continue;
         }
-    }
-
-    bool hasEnoughFrames = !m_channels[0].rnnoiseOutput.empty();
-    if (hasEnoughFrames)
-    {
-        int32_t blockIdxRelative = static_cast<int32_t>(m_newOutputIdx - m_currentOutputIdxToOutput) - 1;
-        blockIdxRelative = std::max(blockIdxRelative, 0);
 
-        size_t firstBlockFrames =
-                k_denoiseBlockSize - m_channels[0].rnnoiseOutput.rbegin()[blockIdxRelative]->curOffset;
-        size_t totalFrames = blockIdxRelative * k_denoiseBlockSize + firstBlockFrames;
-        hasEnoughFrames = totalFrames >= (sampleFrames + k_denoiseBlockSize * retroactiveVADGraceBlocks);
+        size_t toCopy = std::min(k_denoiseBlockSize - inputBlockFrames, remainingFrames);
+        size_t inputOffset = pendingBlocks * k_denoiseBlockSize + inputBlockFrames;
+        for (size_t channelIdx = firstChannel; channelIdx < firstChannel + channelCount; channelIdx++) {
+            auto &channel = m_channels[channelIdx];
+            readHostInput(in, channel.idx, offset + frameIdx, toCopy, channel.inputBlock + inputOffset);
+        }
+        inputBlockFrames += toCopy;
+        frameIdx += toCopy;
+
+        if (inputBlockFrames == k_denoiseBlockSize) {
+            inputBlockFrames = 0;
+            if (!batchBlocks) {
+                denoiseBlock(blockSlot(blockIdx), firstChannel, channelCount, nullptr, 0);
+                blockIdx++;
+            } else if (++pendingBlocks == k_maxBlocksPerDenoise) {
+                auto &channel = m_channels[firstChannel];
+                denoiseBlocks(blockIdx, pendingBlocks, channel, channel.inputBlock);
+                blockIdx += pendingBlocks;
+                pendingBlocks = 0;
+            }
+        }
     }
 
-    /* Wait until there are enough frames to fill all the output. Yes, it creates latency but
-     * That's why it is STRONGLY recommended for sampleFrames to be divisible by k_denoiseBlockSize.
-     */
-    if (waitForEnoughFrames && !hasEnoughFrames) {
-        for (uint32_t channelIdx = 0; channelIdx < m_channelCount; channelIdx++) {
-            std::fill(out[channelIdx], out[channelIdx] + sampleFrames, 0.f);
-        }
+    if (pendingBlocks > 0) {
+        auto &channel = m_channels[firstChannel];
+        denoiseBlocks(blockIdx, pendingBlocks, channel, channel.inputBlock);
+        /* The incomplete block goes back to the start for the next call. */
+        std::copy(channel.inputBlock + pendingBlocks * k_denoiseBlockSize,
+                  channel.inputBlock + pendingBlocks * k_denoiseBlockSize + inputBlockFrames, channel.inputBlock);
+    }
+}
 
-        stats.outputFramesForcedToBeZeroed += sampleFrames;
-        stats.blocksWaitingForOutput = 0;
-        m_stats.store(stats);
-        return;
+void RnNoiseCommonPlugin::denoiseBlocks(uint64_t firstBlockIdx, size_t blockCount, ChannelData &channel,
+                                        const float *input) {
+    for (size_t blockIdx = 0; blockIdx < blockCount;) {
+        /* Slots of consecutive blocks are contiguous until the ring wraps around. */
+        size_t slot = blockSlot(firstBlockIdx + blockIdx);
+        size_t count = std::min(blockCount - blockIdx, m_outputBlocksCapacity - slot);
+        float *outBlocks = &channel.outputBlocks[slot * k_denoiseBlockSize];
+
+        rnnoise_process_frames_normalized(channel.denoiseState.get(), outBlocks, input + blockIdx * k_denoiseBlockSize,
+                                          &channel.vadProbability[slot], static_cast<int>(count));
+        blockIdx += count;
     }
+}
 
-    uint64_t newOutputIdxToOutput = 0;
-    for (auto &channel: m_channels) {
-        size_t toOutputFrames = sampleFrames;
-        size_t curOutFrameIdx = 0;
-        int32_t blockIdxRelative = static_cast<int32_t>(m_newOutputIdx - m_currentOutputIdxToOutput) - 1;
-        while (curOutFrameIdx < sampleFrames && blockIdxRelative >= 0) {
-            auto &outBlock = channel.rnnoiseOutput.rbegin()[blockIdxRelative];
-            size_t copyFromThisBlock = std::min(k_denoiseBlockSize - outBlock->curOffset, toOutputFrames);
-            if (outBlock->muteState == ChunkUnmuteState::MUTED) {
-                // TODO: Maybe we should output some noise instead? Make it an option?
-                std::fill(out[channel.idx] + curOutFrameIdx, out[channel.idx] + curOutFrameIdx + copyFromThisBlock, 0.f);
-            } else {
-                std::copy(outBlock->frames + outBlock->curOffset,
-                          outBlock->frames + outBlock->curOffset + copyFromThisBlock,
-                          out[channel.idx] + curOutFrameIdx);
-            }
+void RnNoiseCommonPlugin::denoiseBlock(size_t slot, size_t firstChannel, size_t channelCount,
+                                       const float *const *in, size_t offset) {
+    for (size_t i = firstChannel; i < firstChannel + channelCount; i++) {
+        auto &channel = m_channels[i];
+        m_batchInputs[i] = in ? in[channel.idx] + offset : channel.inputBlock;
+        m_batchOutputs[i] = &channel.outputBlocks[slot * k_denoiseBlockSize];
+    }
 
-            outBlock->curOffset += copyFromThisBlock;
-            if (outBlock->curOffset == k_denoiseBlockSize) {
-                blockIdxRelative--;
-            }
+    rnnoise_process_frame_batch_normalized(&m_batchStates[firstChannel], &m_batchOutputs[firstChannel],
+                                           &m_batchInputs[firstChannel], &m_batchVadProbability[firstChannel],
+                                           static_cast<int>(channelCount));
 
-            curOutFrameIdx += copyFromThisBlock;
-            toOutputFrames -= copyFromThisBlock;
-        }
+    for (size_t i = firstChannel; i < firstChannel + channelCount; i++) {
+        m_channels[i].vadProbability[slot] = m_batchVadProbability[i];
+    }
+}
 
-        blockIdxRelative = std::max(blockIdxRelative, 0);
+std::shared_ptr<DenoiseState> RnNoiseCommonPlugin::createChannelState() const {
+    return std::shared_ptr<DenoiseState>(rnnoise_create(m_model.get()), [](DenoiseState *st) {
+        rnnoise_destroy(st);
+    });
+}
 
-        if (channel.idx == 0) {
-            stats.outputFramesForcedToBeZeroed += sampleFrames - curOutFrameIdx;
+void RnNoiseCommonPlugin::readOutputQueue(const ChannelData &channel, uint64_t blockIdx, size_t blockOffset,
+                                          float *out, size_t frames) const {
+    size_t curOutFrameIdx = 0;
+    while (curOutFrameIdx < frames) {
+        size_t slot = blockSlot(blockIdx);
+        size_t copyFromThisBlock = std::min(k_denoiseBlockSize - blockOffset, frames - curOutFrameIdx);
+        if (m_outputMuteState[slot] == ChunkUnmuteState::MUTED) {
+            // TODO: Maybe we should output some noise instead? Make it an option?
+            std::fill(out + curOutFrameIdx, out + curOutFrameIdx + copyFromThisBlock, 0.f);
+        } else {
+            const float *outBlock = &channel.outputBlocks[slot * k_denoiseBlockSize];
+            std::copy(outBlock + blockOffset, outBlock + blockOffset + copyFromThisBlock, out + curOutFrameIdx);
         }
 
-        for (; curOutFrameIdx < sampleFrames; curOutFrameIdx++) {
-            out[channel.idx][curOutFrameIdx] = 0.f;
+        blockIdx++;
+        blockOffset = 0;
+        curOutFrameIdx += copyFromThisBlock;
+    }
+}
+
+void RnNoiseCommonPlugin::writeOutput(const HostOutput &out, size_t outOffset, uint64_t blockIdx, size_t blockOffset,
+                                      size_t frames) const {
+    size_t curOutFrameIdx = 0;
+    while (curOutFrameIdx < frames) {
+        size_t slot = blockSlot(blockIdx);
+        size_t copyFromThisBlock = std::min(k_denoiseBlockSize - blockOffset, frames - curOutFrameIdx);
+        bool muted = m_outputMuteState[slot] == ChunkUnmuteState::MUTED;
+        for (auto &channel: m_channels) {
+            const float *outBlock = &channel.outputBlocks[slot * k_denoiseBlockSize + blockOffset];
+            writeHostOutput(out, channel.idx, outOffset + curOutFrameIdx, copyFromThisBlock,
+                            muted ? nullptr : outBlock);
         }
 
-        newOutputIdxToOutput = m_newOutputIdx - 1 - blockIdxRelative;
+        blockIdx++;
+        blockOffset = 0;
+        curOutFrameIdx += copyFromThisBlock;
     }
+}
 
-    m_currentOutputIdxToOutput = newOutputIdxToOutput;
-    uint32_t blocksToLeave = static_cast<uint32_t>(m_newOutputIdx - m_currentOutputIdxToOutput) + retroactiveVADGraceBlocks;
-
-    /* Move output blocks we don't need to the cache to save on allocations. */
-    if (blocksToLeave < m_channels[0].rnnoiseOutput.size()) {
-        for (auto &channel: m_channels) {
-            uint32_t blocksToRemove = static_cast<uint32_t>(channel.rnnoiseOutput.size()) - blocksToLeave;
-            channel.outputBlocksCache.insert(channel.outputBlocksCache.end(),
-                                             std::make_move_iterator(channel.rnnoiseOutput.begin()),
-                                             std::make_move_iterator(
-                                                       channel.rnnoiseOutput.begin() + blocksToRemove));
-            channel.rnnoiseOutput.erase(channel.rnnoiseOutput.begin(),
-                                        channel.rnnoiseOutput.begin() + blocksToRemove);
+void RnNoiseCommonPlugin::readHostInput(const HostInput &in, uint32_t channel, size_t frame, size_t frames,
+                                        float *dst) {
+    switch (in.layout) {
+        case SampleLayout::PLANAR: {
+            const float *src = in.planar[channel] + frame;
+            std::copy(src, src + frames, dst);
+            break;
+        }
+        case SampleLayout::INTERLEAVED_FLOAT: {
+            const float *src = static_cast<const float *>(in.interleaved) + frame * in.stride + channel;
+            for (size_t i = 0; i < frames; i++) {
+                dst[i] = src[i * in.stride];
+            }
+            break;
+        }
+        case SampleLayout::INTERLEAVED_INT16: {
+            const int16_t *src = static_cast<const int16_t *>(in.interleaved) + frame * in.stride + channel;
+            for (size_t i = 0; i < frames; i++) {
+                dst[i] = src[i * in.stride] * (1.f / k_int16Scale);
+            }
+            break;
         }
     }
+}
 
-    stats.blocksWaitingForOutput = static_cast<uint32_t>(m_newOutputIdx - m_currentOutputIdxToOutput);
-    m_stats.store(stats);
+void RnNoiseCommonPlugin::writeHostOutput(const HostOutput &out, uint32_t channel, size_t frame, size_t frames,
+                                          const float *src) {
+    switch (out.layout) {
+        case SampleLayout::PLANAR: {
+            float *dst = out.planar[channel] + frame;
+            if (src) {
+                std::copy(src, src + frames, dst);
+            } else {
+                std::fill(dst, dst + frames, 0.f);
+            }
+            break;
+        }
+        case SampleLayout::INTERLEAVED_FLOAT: {
+            float *dst = static_cast<float *>(out.interleaved) + frame * out.stride + channel;
+            for (size_t i = 0; i < frames; i++) {
+                dst[i * out.stride] = src ? src[i] : 0.f;
+            }
+            break;
+        }
+        case SampleLayout::INTERLEAVED_INT16: {
+            int16_t *dst = static_cast<int16_t *>(out.interleaved) + frame * out.stride + channel;
+            for (size_t i = 0; i < frames; i++) {
+                float sample = src ? src[i] * k_int16Scale : 0.f;
+                sample = std::min(k_int16Scale, std::max(-k_int16Scale - 1.f, sample));
+                dst[i * out.stride] = static_cast<int16_t>(std::floor(.5f + sample));
+            }
+            break;
+        }
+    }
 }
 
 void RnNoiseCommonPlugin::createDenoiseState() {
     m_newOutputIdx = 0;
     m_lastOutputIdxOverVADThreshold = 0;
+    m_oldestOutputIdx = 0;
     m_currentOutputIdxToOutput = 0;
+    m_currentOutputOffset = 0;
+    m_inputBlockFrames = 0;
     m_prevRetroactiveVADGraceBlocks = 0;
+    m_outputBlocksToDrop = 0;
+    m_primingFrames = computeQueueLatencyFrames(m_hostBlockFrames, 0);
+    m_offlineInputFrames = 0;
+    m_offlineOutputFrames = 0;
+    m_offlineFlushed = false;
+
+    /* Worst case is waiting for sampleFrames + retroactiveVADGraceBlocks blocks to be ready with almost
+     * the same amount already queued, plus retroactiveVADGraceBlocks of already written blocks.
+     */
+    size_t maxBlocksPerCall = (m_maxBlockFrames + k_denoiseBlockSize - 1) / k_denoiseBlockSize;
+    m_outputBlocksCapacity = 2 * maxBlocksPerCall + 2 * k_maxRetroactiveVADGraceBlocks + 4;
+
+    m_channels.reserve(m_channelCount);
+
+    m_outputMaxVadProbability.assign(m_outputBlocksCapacity, 0.f);
+    m_outputMuteState.assign(m_outputBlocksCapacity, ChunkUnmuteState::MUTED);
+    /* The faded out and the faded in frames. */
+    m_crossfadeFrames.assign(2 * k_denoiseBlockSize, 0.f);
+
+    size_t channelFrames = (k_maxBlocksPerDenoise + m_outputBlocksCapacity) * k_denoiseBlockSize;
+    size_t cacheLineFloats = k_cacheLineSize / sizeof(float);
+    m_blocksStorage.assign(m_channelCount * channelFrames + cacheLineFloats, 0.f);
+
+    auto storageAddress = reinterpret_cast<uintptr_t>(m_blocksStorage.data());
+    auto alignedAddress = (storageAddress + k_cacheLineSize - 1) & ~static_cast<uintptr_t>(k_cacheLineSize - 1);
+    float *channelStorage = reinterpret_cast<float *>(alignedAddress);
 
     for (uint32_t i = 0; i < m_channelCount; i++) {
-        auto denoiseState = std::shared_ptr<DenoiseState>(rnnoise_create(nullptr), [](DenoiseState *st) {
-            rnnoise_destroy(st);
-        });
+        m_channels.push_back(ChannelData{i, createChannelState(), channelStorage, channelStorage + k_maxBlocksPerDenoise * k_denoiseBlockSize,
+                                         std::vector<float>(m_outputBlocksCapacity, 0.f)});
+        channelStorage += channelFrames;
+    }
 
-        m_channels.push_back(ChannelData{i, denoiseState, {}, {}, {}});
+    m_batchStates.clear();
+    m_batchInputs.clear();
+    for (auto &channel: m_channels) {
+        m_batchStates.push_back(channel.denoiseState.get());
+        m_batchInputs.push_back(channel.inputBlock);
     }
+    m_batchOutputs.assign(m_channelCount, nullptr);
+    m_batchVadProbability.assign(m_channelCount, 0.f);
+
+    m_memoryFootprint = {};
+    m_memoryFootprint.queueBytes = m_blocksStorage.size() * sizeof(float)
+                                   + m_channelCount * m_outputBlocksCapacity * sizeof(float);
+    if (!m_channels.empty()) {
+        RNNoiseMemoryFootprint footprint;
+        rnnoise_get_memory_footprint(m_channels.front().denoiseState.get(), &footprint);
+        m_memoryFootprint.stateBytes = m_channelCount * static_cast<size_t>(footprint.state_bytes);
+        m_memoryFootprint.modelBytes = static_cast<size_t>(footprint.model_bytes);
+        /* Either a batch of channels or, for a single channel, a batch of blocks. */
+        m_memoryFootprint.scratchBytes = static_cast<size_t>(footprint.batch_scratch_bytes);
+    }
+
+    /* Mono and stereo fit into a single rnnoise batch, a pool would only add overhead. */
+    uint32_t workers = m_channelCount > 2 ? m_workerPoolConfig.workers : 0;
+    size_t threads = std::max<size_t>(std::min<size_t>(workers + 1, m_channelCount), 1);
+    m_channelGroupSize = std::min<size_t>(std::max<size_t>((m_channelCount + threads - 1) / threads, 1),
+                                          k_maxChannelsPerGroup);
+    m_channelGroupCount = (m_channelCount + m_channelGroupSize - 1) / m_channelGroupSize;
+    if (workers > 0 && m_channelGroupCount > 1) {
+        RnNoiseWorkerPool::Config config = m_workerPoolConfig;
+        config.workers = static_cast<uint32_t>(std::min<size_t>(workers, m_channelGroupCount - 1));
+        m_workerPool.reset(new RnNoiseWorkerPool(config));
+    }
+
+    onChannelsCreated();
 }
 
-void RnNoiseCommonPlugin::resetStats() {
-    m_stats.store(RnNoiseStats {});
+void RnNoiseCommonPlugin::publishStats() {
+    /* Single writer, so the sequence doesn't need a read-modify-write. An odd sequence tells
+     * readers that the fields are being written.
+     */
+    uint32_t sequence = m_publishedStats.sequence.load(std::memory_order_relaxed);
+    m_publishedStats.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_publishedStats.vadGraceBlocks.store(m_stats.vadGraceBlocks, std::memory_order_relaxed);
+    m_publishedStats.retroactiveVADGraceBlocks.store(m_stats.retroactiveVADGraceBlocks, std::memory_order_relaxed);
+    m_publishedStats.blocksWaitingForOutput.store(m_stats.blocksWaitingForOutput, std::memory_order_relaxed);
+    m_publishedStats.outputFramesForcedToBeZeroed.store(m_stats.outputFramesForcedToBeZeroed,
+                                                        std::memory_order_relaxed);
+
+    m_publishedStats.sequence.store(sequence + 2, std::memory_order_release);
 }
 
 const RnNoiseStats RnNoiseCommonPlugin::getStats() const {
-    return m_stats.load();
+    RnNoiseStats stats{};
+    while (true) {
+        uint32_t sequence = m_publishedStats.sequence.load(std::memory_order_acquire);
+        if (sequence & 1u) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        stats.vadGraceBlocks = m_publishedStats.vadGraceBlocks.load(std::memory_order_relaxed);
+        stats.retroactiveVADGraceBlocks = m_publishedStats.retroactiveVADGraceBlocks.load(std::memory_order_relaxed);
+        stats.blocksWaitingForOutput = m_publishedStats.blocksWaitingForOutput.load(std::memory_order_relaxed);
+        stats.outputFramesForcedToBeZeroed = m_publishedStats.outputFramesForcedToBeZeroed.load(
+                std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_publishedStats.sequence.load(std::memory_order_relaxed) == sequence) {
+            return stats;
+        }
+    }
+}
+
+bool RnNoiseCommonPlugin::isProfilingEnabled() {
+#ifdef RNNOISE_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void RnNoiseCommonPlugin::publishStageTimings() {
+    static_assert(k_profiledStages == RNNOISE_STAGE_COUNT, "Stage count mismatch");
+
+#ifdef RNNOISE_PROFILE
+    if (!m_stageTimingsRequested.exchange(false, std::memory_order_relaxed)) {
+        return;
+    }
+
+    RNNoiseStageTiming timings[RNNOISE_STAGE_COUNT];
+    rnnoise_get_stage_timings(m_batchStates.data(), static_cast<int>(m_batchStates.size()), timings);
+
+    uint32_t sequence = m_stageTimingsSequence.load(std::memory_order_relaxed);
+    m_stageTimingsSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t stage = 0; stage < k_profiledStages; stage++) {
+        std::atomic<uint64_t> *values = &m_publishedStageTimings[stage * k_valuesPerStageTiming];
+        values[0].store(timings[stage].count, std::memory_order_relaxed);
+        values[1].store(timings[stage].min_ns, std::memory_order_relaxed);
+        values[2].store(timings[stage].mean_ns, std::memory_order_relaxed);
+        values[3].store(timings[stage].p99_ns, std::memory_order_relaxed);
+        values[4].store(timings[stage].max_ns, std::memory_order_relaxed);
+    }
+
+    m_stageTimingsSequence.store(sequence + 2, std::memory_order_release);
+#endif
+}
+
+std::vector<RnNoiseStageTiming> RnNoiseCommonPlugin::getStageTimings() const {
+    std::vector<RnNoiseStageTiming> timings;
+    if (!isProfilingEnabled()) {
+        return timings;
+    }
+
+    timings.resize(k_profiledStages);
+    while (true) {
+        uint32_t sequence = m_stageTimingsSequence.load(std::memory_order_acquire);
+        if (sequence & 1u) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (size_t stage = 0; stage < k_profiledStages; stage++) {
+            const std::atomic<uint64_t> *values = &m_publishedStageTimings[stage * k_valuesPerStageTiming];
+            timings[stage] = RnNoiseStageTiming{rnnoise_stage_name(static_cast<int>(stage)),
+                                                values[0].load(std::memory_order_relaxed),
+                                                values[1].load(std::memory_order_relaxed),
+                                                values[2].load(std::memory_order_relaxed),
+                                                values[3].load(std::memory_order_relaxed),
+                                                values[4].load(std::memory_order_relaxed)};
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_stageTimingsSequence.load(std::memory_order_relaxed) == sequence) {
+            break;
+        }
+    }
+
+    m_stageTimingsRequested.store(true, std::memory_order_relaxed);
+    return timings;
+}
+
+RnNoiseMemoryFootprint RnNoiseCommonPlugin::getMemoryFootprint() const {
+    return m_memoryFootprint;
+}
+
+RnNoiseStats RnNoiseStats::since(const RnNoiseStats &earlier) const {
+    /* Counters restart on init(), the earlier snapshot then belongs to the previous stream. */
+    auto delta = [](uint64_t current, uint64_t previous) {
+        return current >= previous ? current - previous : current;
+    };
+
+    RnNoiseStats stats = *this;
+    stats.vadGraceBlocks = delta(vadGraceBlocks, earlier.vadGraceBlocks);
+    stats.retroactiveVADGraceBlocks = delta(retroactiveVADGraceBlocks, earlier.retroactiveVADGraceBlocks);
+    stats.outputFramesForcedToBeZeroed = delta(outputFramesForcedToBeZeroed, earlier.outputFramesForcedToBeZeroed);
+    return stats;
 }
 
@@ -0,0 +1,200 @@
+#include "common/RnNoiseCommonPluginT.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RNNOISE_PLUGIN_SSE
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RNNOISE_PLUGIN_NEON
+#endif
+
+#include <rnnoise.h>
+
+/* Splits interleaved stereo frames into the two channels, four frames per shuffle. */
+static void deinterleaveStereo(const float *in, float *left, float *right, size_t frames) {
+    size_t i = 0;
+#if defined(RNNOISE_PLUGIN_SSE)
+    for (; i + 4 <= frames; i += 4) {
+        __m128 first = _mm_loadu_ps(in + 2 * i);
+        __m128 second = _mm_loadu_ps(in + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif defined(RNNOISE_PLUGIN_NEON)
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t frames4 = vld2q_f32(in + 2 * i);
+        vst1q_f32(left + i, frames4.val[0]);
+        vst1q_f32(right + i, frames4.val[1]);
+    }
+#endif
+    for (; i < frames; i++) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+static void interleaveStereo(const float *left, const float *right, float *out, size_t frames) {
+    size_t i = 0;
+#if defined(RNNOISE_PLUGIN_SSE)
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+#elif defined(RNNOISE_PLUGIN_NEON)
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t frames4 = {{vld1q_f32(left + i), vld1q_f32(right + i)}};
+        vst2q_f32(out + 2 * i, frames4);
+    }
+#endif
+    for (; i < frames; i++) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+std::unique_ptr<RnNoiseCommonPlugin> RnNoiseCommonPlugin::create(uint32_t channels, size_t maxBlockFrames) {
+    switch (channels) {
+        case 1:
+            return std::unique_ptr<RnNoiseCommonPlugin>(new RnNoiseCommonPluginT<1>(maxBlockFrames));
+        case 2:
+            return std::unique_ptr<RnNoiseCommonPlugin>(new RnNoiseCommonPluginT<2>(maxBlockFrames));
+        default:
+            return std::unique_ptr<RnNoiseCommonPlugin>(new RnNoiseCommonPlugin(channels, maxBlockFrames));
+    }
+}
+
+template<uint32_t Channels>
+void RnNoiseCommonPluginT<Channels>::onChannelsCreated() {
+    for (uint32_t c = 0; c < Channels; c++) {
+        m_inputBlocks[c] = m_channels[c].inputBlock;
+        m_outputBlocks[c] = m_channels[c].outputBlocks;
+    }
+}
+
+template<uint32_t Channels>
+void RnNoiseCommonPluginT<Channels>::denoiseAllChannels(const HostInput &in, size_t offset,
+                                                        size_t sampleFrames) {
+    /* Same as RnNoiseCommonPlugin::denoiseChannels() for all the channels at once. Packed
+     * stereo frames are split with SIMD shuffles on the way into the input blocks.
+     */
+    const size_t maxPendingBlocks = Channels == 1 ? k_maxBlocksPerDenoise : 1;
+    const bool planar = in.layout == SampleLayout::PLANAR;
+    const bool packedStereo = Channels == 2 && in.layout == SampleLayout::INTERLEAVED_FLOAT && in.stride == 2;
+    size_t inputBlockFrames = m_inputBlockFrames;
+    size_t pendingBlocks = 0;
+    uint64_t blockIdx = m_newOutputIdx;
+    for (size_t frameIdx = 0; frameIdx < sampleFrames;) {
+        size_t remainingFrames = sampleFrames - frameIdx;
+        if (planar && inputBlockFrames == 0 && pendingBlocks == 0 && remainingFrames >= k_denoiseBlockSize) {
+            std::array<const float *, Channels> inputs;
+            for (uint32_t c = 0; c < Channels; c++) {
+                inputs[c] = in.planar[c] + offset + frameIdx;
+            }
+            size_t blockCount = std::min(remainingFrames / k_denoiseBlockSize, maxPendingBlocks);
+            denoisePendingBlocks(blockIdx, blockCount, inputs.data());
+            blockIdx += blockCount;
+            frameIdx += blockCount * k_denoiseBlockSize;
+            continue;
+        }
+
+        size_t toCopy = std::min(k_denoiseBlockSize - inputBlockFrames, remainingFrames);
+        size_t inputOffset = pendingBlocks * k_denoiseBlockSize + inputBlockFrames;
+        if (packedStereo) {
+            const float *frames = static_cast<const float *>(in.interleaved) + 2 * (offset + frameIdx);
+            deinterleaveStereo(frames, m_inputBlocks[0] + inputOffset, m_inputBlocks[Channels - 1] + inputOffset,
+                               toCopy);
+        } else {
+            for (uint32_t c = 0; c < Channels; c++) {
+                readHostInput(in, c, offset + frameIdx, toCopy, m_inputBlocks[c] + inputOffset);
+            }
+        }
+        inputBlockFrames += toCopy;
+        frameIdx += toCopy;
+
+        if (inputBlockFrames == k_denoiseBlockSize) {
+            inputBlockFrames = 0;
+            if (++pendingBlocks == maxPendingBlocks) {
+                denoisePendingBlocks(blockIdx, pendingBlocks, m_inputBlocks.data());
+                blockIdx += pendingBlocks;
+                pendingBlocks = 0;
+            }
+        }
+    }
+
+    if (pendingBlocks > 0) {
+        denoisePendingBlocks(blockIdx, pendingBlocks, m_inputBlocks.data());
+        /* The incomplete block goes back to the start for the next call. */
+        for (uint32_t c = 0; c < Channels; c++) {
+            float *pending = m_inputBlocks[c] + pendingBlocks * k_denoiseBlockSize;
+            std::copy(pending, pending + inputBlockFrames, m_inputBlocks[c]);
+        }
+    }
+}
+
+template<uint32_t Channels>
+void RnNoiseCommonPluginT<Channels>::denoisePendingBlocks(uint64_t firstBlockIdx, size_t blockCount,
+                                                          const float *const *inputs) {
+    for (size_t blockIdx = 0; blockIdx < blockCount;) {
+        /* Slots of consecutive blocks are contiguous until the ring wraps around. */
+        size_t slot = blockSlot(firstBlockIdx + blockIdx);
+        size_t count = std::min(blockCount - blockIdx, m_outputBlocksCapacity - slot);
+
+        /* VAD probability of block b of channel c at b * Channels + c. */
+        float vadProbability[Channels * k_maxBlocksPerDenoise];
+        if (Channels == 1) {
+            rnnoise_process_frames_normalized(m_batchStates[0], m_outputBlocks[0] + slot * k_denoiseBlockSize,
+                                              inputs[0] + blockIdx * k_denoiseBlockSize, vadProbability,
+                                              static_cast<int>(count));
+        } else {
+            float *outputs[Channels];
+            for (uint32_t c = 0; c < Channels; c++) {
+                outputs[c] = m_outputBlocks[c] + slot * k_denoiseBlockSize;
+            }
+            rnnoise_process_frame_batch_normalized(m_batchStates.data(), outputs, inputs, vadProbability,
+                                                   Channels);
+        }
+
+        for (size_t b = 0; b < count; b++) {
+            float maxVadProbability = 0.f;
+            for (uint32_t c = 0; c < Channels; c++) {
+                maxVadProbability = std::max(vadProbability[b * Channels + c], maxVadProbability);
+            }
+            m_outputMaxVadProbability[slot + b] = maxVadProbability;
+        }
+        blockIdx += count;
+    }
+}
+
+template<uint32_t Channels>
+void RnNoiseCommonPluginT<Channels>::writeOutput(const HostOutput &out, size_t outOffset, uint64_t blockIdx,
+                                                 size_t blockOffset, size_t frames) const {
+    const bool packedStereo = Channels == 2 && out.layout == SampleLayout::INTERLEAVED_FLOAT && out.stride == 2;
+    size_t curOutFrameIdx = 0;
+    while (curOutFrameIdx < frames) {
+        size_t slot = blockSlot(blockIdx);
+        size_t copyFromThisBlock = std::min(k_denoiseBlockSize - blockOffset, frames - curOutFrameIdx);
+        bool muted = m_outputMuteState[slot] == ChunkUnmuteState::MUTED;
+        if (packedStereo && !muted) {
+            float *frameOut = static_cast<float *>(out.interleaved) + 2 * (outOffset + curOutFrameIdx);
+            interleaveStereo(m_outputBlocks[0] + slot * k_denoiseBlockSize + blockOffset,
+                             m_outputBlocks[Channels - 1] + slot * k_denoiseBlockSize + blockOffset, frameOut,
+                             copyFromThisBlock);
+        } else {
+            for (uint32_t c = 0; c < Channels; c++) {
+                const float *outBlock = m_outputBlocks[c] + slot * k_denoiseBlockSize + blockOffset;
+                writeHostOutput(out, c, outOffset + curOutFrameIdx, copyFromThisBlock, muted ? nullptr : outBlock);
+            }
+        }
+
+        blockIdx++;
+        blockOffset = 0;
+        curOutFrameIdx += copyFromThisBlock;
+    }
+}
+
+template class RnNoiseCommonPluginT<1>;
+template class RnNoiseCommonPluginT<2>;
@@ -0,0 +1,74 @@
+#include "common/RnNoiseModelCache.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <rnnoise.h>
+
+namespace {
+    struct Cache {
+        std::mutex mutex;
+        /* Weak, so that a model is freed as soon as the last instance drops it. */
+        std::map<std::pair<std::string, uint64_t>, std::weak_ptr<RNNModel>> models;
+    };
+
+    Cache &cache() {
+        static Cache instance;
+        return instance;
+    }
+
+    /* 64-bit FNV-1a. */
+    uint64_t hashBytes(const unsigned char *data, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+std::shared_ptr<RNNModel> RnNoiseModelCache::acquire(const std::string &path) {
+    /* The key is hashed from the weights the model runs on, a second read of the file could see
+     * another file replaced in between.
+     */
+    RNNModel *loaded = rnnoise_model_from_filename(path.c_str());
+    if (loaded == nullptr) {
+        return nullptr;
+    }
+    std::shared_ptr<RNNModel> model(loaded, [](RNNModel *m) {
+        rnnoise_model_free(m);
+    });
+    int size = 0;
+    auto data = static_cast<const unsigned char *>(rnnoise_model_get_data(loaded, &size));
+    auto key = std::make_pair(path, hashBytes(data, static_cast<size_t>(size)));
+
+    Cache &instance = cache();
+    /* Instances loading the same contents at once all end up with the first model. */
+    std::lock_guard<std::mutex> lock(instance.mutex);
+
+    for (auto it = instance.models.begin(); it != instance.models.end();) {
+        it = it->second.expired() ? instance.models.erase(it) : std::next(it);
+    }
+
+    auto found = instance.models.find(key);
+    if (found != instance.models.end()) {
+        if (auto cached = found->second.lock()) {
+            return cached;
+        }
+    }
+
+    instance.models[key] = model;
+    return model;
+}
+
+size_t RnNoiseModelCache::loadedModels() {
+    Cache &instance = cache();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    size_t count = 0;
+    for (auto &entry: instance.models) {
+        count += entry.second.expired() ? 0 : 1;
+    }
+    return count;
+}
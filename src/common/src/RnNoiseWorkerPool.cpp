@@ -0,0 +1,120 @@
+#include "common/RnNoiseWorkerPool.h"
+
+#include <cassert>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+const int RnNoiseWorkerPool::k_taskIdxBits;
+const uint64_t RnNoiseWorkerPool::k_taskIdxMask;
+
+RnNoiseWorkerPool::RnNoiseWorkerPool(const Config &config) : m_config(config) {
+    for (uint32_t i = 0; i < m_config.workers; i++) {
+        m_threads.emplace_back(&RnNoiseWorkerPool::workerLoop, this, i);
+    }
+}
+
+RnNoiseWorkerPool::~RnNoiseWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_parkMutex);
+        m_stopping = true;
+    }
+    m_parkCondition.notify_all();
+
+    for (auto &thread: m_threads) {
+        thread.join();
+    }
+}
+
+void RnNoiseWorkerPool::run(size_t taskCount, Task task, void *context) {
+    assert(taskCount <= k_taskIdxMask);
+
+    if (taskCount == 0) {
+        return;
+    }
+
+    m_generation++;
+    m_task = task;
+    m_context = context;
+    m_doneTasks = 0;
+    m_tasks = (m_generation << (2 * k_taskIdxBits)) | (static_cast<uint64_t>(taskCount) << k_taskIdxBits);
+    m_startedGeneration = m_generation;
+
+    if (m_parkedWorkers > 0) {
+        std::lock_guard<std::mutex> lock(m_parkMutex);
+        m_parkCondition.notify_all();
+    }
+
+    runTasks();
+
+    /* Only tasks which are already being processed are left, so this is short. */
+    while (m_doneTasks < taskCount) {
+        std::this_thread::yield();
+    }
+}
+
+void RnNoiseWorkerPool::runTasks() {
+    uint64_t tasks = m_tasks;
+    while (true) {
+        uint64_t taskIdx = tasks & k_taskIdxMask;
+        uint64_t taskCount = (tasks >> k_taskIdxBits) & k_taskIdxMask;
+        if (taskIdx >= taskCount) {
+            return;
+        }
+
+        if (m_tasks.compare_exchange_weak(tasks, tasks + 1)) {
+            /* The run can't finish before this task does, so task and context belong to it. */
+            m_task.load()(m_context, static_cast<size_t>(taskIdx));
+            m_doneTasks++;
+            tasks = m_tasks;
+        }
+    }
+}
+
+void RnNoiseWorkerPool::workerLoop(uint32_t workerIdx) {
+    if (workerIdx < m_config.cpuAffinity.size() && m_config.cpuAffinity[workerIdx] >= 0) {
+        setCurrentThreadAffinity(m_config.cpuAffinity[workerIdx]);
+    }
+
+    uint64_t seenGeneration = 0;
+    while (true) {
+        auto spinUntil = std::chrono::steady_clock::now() + m_config.spinTime;
+        while (m_startedGeneration == seenGeneration && !m_stopping
+               && std::chrono::steady_clock::now() < spinUntil) {
+            std::this_thread::yield();
+        }
+
+        if (m_startedGeneration == seenGeneration && !m_stopping) {
+            std::unique_lock<std::mutex> lock(m_parkMutex);
+            m_parkedWorkers++;
+            m_parkCondition.wait(lock, [this, seenGeneration] {
+                return m_startedGeneration != seenGeneration || m_stopping;
+            });
+            m_parkedWorkers--;
+        }
+
+        if (m_stopping) {
+            return;
+        }
+
+        seenGeneration = m_startedGeneration;
+        runTasks();
+    }
+}
+
+void RnNoiseWorkerPool::setCurrentThreadAffinity(int cpu) {
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+#else
+    (void) cpu;
+#endif
+}
@@ -2,6 +2,85 @@
 #include <catch.hpp>
 
 #include "common/RnNoiseCommonPlugin.h"
+#include "common/RnNoiseModelCache.h"
+
+#include <rnnoise.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* rnnoise internals, the int8 kernels are checked on the layers of the built-in model and the
+ * real-input transforms against the complex ones.
+ */
+extern "C" {
+#include "cpu_support.h"
+#include "kiss_fft.h"
+#include "nnet.h"
+#include "rnnoise_data.h"
+
+extern const WeightArray rnnoise_arrays[];
+extern const kiss_fft_state rnn_kfft;
+extern const kiss_fft_state rnn_kfft_half;
+extern const float rnn_half_window[];
+}
+
+static std::atomic<bool> g_countAllocations{false};
+static std::atomic<size_t> g_allocationsCount{0};
+
+void *operator new(size_t size) {
+    if (g_countAllocations) {
+        g_allocationsCount++;
+    }
+    void *ptr = std::malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+#ifdef _MSC_VER
+#define TESTS_NOINLINE __declspec(noinline)
+#else
+#define TESTS_NOINLINE __attribute__((noinline))
+#endif
+
+/* Not inlined, otherwise GCC sees free() on a pointer from operator new and warns with -Wmismatched-new-delete. */
+TESTS_NOINLINE void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+/* C++14 deallocates through the sized overload, which has to be replaced along with the unsized one. */
+void operator delete(void *ptr, size_t) noexcept {
+    ::operator delete(ptr);
+}
+
+/* Sets or, with nullptr, clears the RNNOISE_ARCH override for the lifetime of the guard. */
+struct ArchOverride {
+    explicit ArchOverride(const char *arch) { set(arch); }
+    ~ArchOverride() { set(nullptr); }
+
+    static void set(const char *arch) {
+#ifdef _WIN32
+        _putenv_s("RNNOISE_ARCH", arch != nullptr ? arch : "");
+#else
+        if (arch != nullptr) {
+            setenv("RNNOISE_ARCH", arch, 1);
+        } else {
+            unsetenv("RNNOISE_ARCH");
+        }
+#endif
+    }
+};
 
 TEST_CASE("Init -> Deinit cycle", "[common_plugin]") {
     auto channels = GENERATE(1, 2, 4);
@@ -78,8 +157,8 @@ TEST_CASE("All options", "[common_plugin]") {
 TEST_CASE("Change Retroactive VAD", "[common_plugin]") {
     auto sampleFrames = 512;
     auto channels = 2;
-    auto startRetroactiveVADGraceBlocks = 10;
-    auto endRetroactiveVADGraceBlocks = 2;
+    const uint32_t startRetroactiveVADGraceBlocks = 10;
+    const uint32_t endRetroactiveVADGraceBlocks = 2;
 
     CAPTURE(startRetroactiveVADGraceBlocks, endRetroactiveVADGraceBlocks, channels, sampleFrames);
 
@@ -95,12 +174,13 @@ TEST_CASE("Change Retroactive VAD", "[common_plugin]") {
         outputs.push_back(new float[sampleFrames * iterations]);
     }
 
-    for (int i = 0; i < startRetroactiveVADGraceBlocks; i++) {
+    for (uint32_t i = 0; i < startRetroactiveVADGraceBlocks; i++) {
         plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.0,
                        2, startRetroactiveVADGraceBlocks);
     }
 
-    for (int i = 0; i < endRetroactiveVADGraceBlocks; i++) {
+    /* A single excess block is dropped per call. */
+    for (uint32_t i = 0; i < startRetroactiveVADGraceBlocks; i++) {
         plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.0,
                        2, endRetroactiveVADGraceBlocks);
     }
@@ -108,3 +188,1482 @@ TEST_CASE("Change Retroactive VAD", "[common_plugin]") {
     const RnNoiseStats stats = plugin.getStats();
     REQUIRE(stats.blocksWaitingForOutput <= endRetroactiveVADGraceBlocks + 1);
 }
+
+TEST_CASE("No allocations while processing", "[common_plugin]") {
+    auto channels = GENERATE(1, 2);
+    auto retroactiveVADGraceBlocks = GENERATE(0, 3);
+    auto sampleFrames = GENERATE(200, 480, 512);
+
+    CAPTURE(channels, retroactiveVADGraceBlocks, sampleFrames);
+
+    RnNoiseCommonPlugin plugin(channels, sampleFrames);
+    plugin.init();
+
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames, 0.1f));
+    std::vector<std::vector<float>> outputData(channels, std::vector<float>(sampleFrames));
+
+    auto inputs = std::vector<const float *>();
+    auto outputs = std::vector<float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        inputs.push_back(inputData[ch].data());
+        outputs.push_back(outputData[ch].data());
+    }
+
+    g_allocationsCount = 0;
+    g_countAllocations = true;
+    for (int i = 0; i < 100; i++) {
+        plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.5f, 20, retroactiveVADGraceBlocks);
+    }
+    g_countAllocations = false;
+
+    REQUIRE(g_allocationsCount == 0);
+}
+
+TEST_CASE("Input bigger than max block", "[common_plugin]") {
+    auto channels = 2;
+    auto maxBlockFrames = 512;
+    auto sampleFrames = GENERATE(1000, 480 * 60);
+
+    CAPTURE(maxBlockFrames, sampleFrames);
+
+    RnNoiseCommonPlugin plugin(channels, maxBlockFrames);
+    plugin.init();
+
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames, 0.1f));
+    std::vector<std::vector<float>> outputData(channels, std::vector<float>(sampleFrames));
+
+    auto inputs = std::vector<const float *>();
+    auto outputs = std::vector<float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        inputs.push_back(inputData[ch].data());
+        outputs.push_back(outputData[ch].data());
+    }
+
+    for (int i = 0; i < 5; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            std::fill(outputData[ch].begin(), outputData[ch].end(), -1.f);
+        }
+
+        plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.5f, 20, 2);
+
+        for (int ch = 0; ch < channels; ch++) {
+            for (int j = 0; j < sampleFrames; j++) {
+                if (outputData[ch][j] == -1.f) {
+                    CAPTURE(ch, j);
+                    FAIL("No output written");
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Reduce Retroactive VAD without gaps", "[common_plugin]") {
+    auto sampleFrames = GENERATE(480, 512);
+    auto channels = 2;
+    const uint32_t startRetroactiveVADGraceBlocks = 10;
+    auto endRetroactiveVADGraceBlocks = GENERATE(0u, 2u);
+
+    CAPTURE(sampleFrames, startRetroactiveVADGraceBlocks, endRetroactiveVADGraceBlocks);
+
+    RnNoiseCommonPlugin plugin(channels, sampleFrames);
+    plugin.init();
+
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames, 0.1f));
+    std::vector<std::vector<float>> outputData(channels, std::vector<float>(sampleFrames));
+
+    auto inputs = std::vector<const float *>();
+    auto outputs = std::vector<float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        inputs.push_back(inputData[ch].data());
+        outputs.push_back(outputData[ch].data());
+    }
+
+    for (int i = 0; i < 30; i++) {
+        plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.f, 20, startRetroactiveVADGraceBlocks);
+    }
+
+    const uint64_t zeroedFramesBefore = plugin.getStats().outputFramesForcedToBeZeroed;
+    REQUIRE(plugin.getStats().blocksWaitingForOutput >= startRetroactiveVADGraceBlocks);
+
+    /* The excess goes one block per call, not all at once. */
+    bool gradual = true;
+    g_allocationsCount = 0;
+    g_countAllocations = true;
+    for (int i = 0; i < 12; i++) {
+        uint32_t waitingBlocks = plugin.getStats().blocksWaitingForOutput;
+        plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.f, 20, endRetroactiveVADGraceBlocks);
+        gradual &= plugin.getStats().blocksWaitingForOutput + 2 >= waitingBlocks;
+    }
+    g_countAllocations = false;
+
+    const RnNoiseStats stats = plugin.getStats();
+    REQUIRE(g_allocationsCount == 0);
+    REQUIRE(gradual);
+    REQUIRE(stats.outputFramesForcedToBeZeroed == zeroedFramesBefore);
+    REQUIRE(stats.blocksWaitingForOutput <= endRetroactiveVADGraceBlocks + 2);
+}
+
+TEST_CASE("Channels match separate mono instances", "[common_plugin]") {
+    /* 5 channels don't fit in a single rnnoise batch. Groups and a single channel take different
+     * rnnoise entry points, which have to agree on every arch.
+     */
+    auto channels = GENERATE(2, 5);
+    auto sampleFrames = GENERATE(480, 512);
+    auto arch = GENERATE("c", "sse4_1", "avx2");
+
+    CAPTURE(channels, sampleFrames, arch);
+    ArchOverride override(arch);
+
+    const int iterations = 20;
+    std::minstd_rand rng(42);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames * iterations));
+    for (auto &channelData: inputData) {
+        for (auto &sample: channelData) {
+            sample = noise(rng);
+        }
+    }
+
+    /* Zero threshold so nothing is muted and channels don't affect each other. */
+    RnNoiseCommonPlugin plugin(channels, sampleFrames);
+    plugin.init();
+
+    std::vector<std::vector<float>> outputData(channels, std::vector<float>(sampleFrames * iterations));
+    for (int i = 0; i < iterations; i++) {
+        auto inputs = std::vector<const float *>();
+        auto outputs = std::vector<float *>();
+        for (int ch = 0; ch < channels; ch++) {
+            inputs.push_back(inputData[ch].data() + i * sampleFrames);
+            outputs.push_back(outputData[ch].data() + i * sampleFrames);
+        }
+        plugin.process(inputs.data(), outputs.data(), sampleFrames, 0.f, 20, 0);
+    }
+
+    for (int ch = 0; ch < channels; ch++) {
+        RnNoiseCommonPlugin monoPlugin(1, sampleFrames);
+        monoPlugin.init();
+
+        std::vector<float> monoOutput(sampleFrames * iterations);
+        for (int i = 0; i < iterations; i++) {
+            const float *input = inputData[ch].data() + i * sampleFrames;
+            float *output = monoOutput.data() + i * sampleFrames;
+            monoPlugin.process(&input, &output, sampleFrames, 0.f, 20, 0);
+        }
+
+        CAPTURE(ch);
+        REQUIRE(monoOutput == outputData[ch]);
+    }
+}
+
+TEST_CASE("Parallel channels match sequential", "[common_plugin]") {
+    auto channels = GENERATE(2, 3, 8);
+    auto workers = GENERATE(1, 3);
+    auto sampleFrames = GENERATE(480, 512);
+
+    CAPTURE(channels, workers, sampleFrames);
+
+    const int iterations = 10;
+    std::minstd_rand rng(7);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames));
+    std::vector<std::vector<float>> sequentialData(channels, std::vector<float>(sampleFrames));
+    std::vector<std::vector<float>> parallelData(channels, std::vector<float>(sampleFrames));
+
+    auto inputs = std::vector<const float *>();
+    auto sequentialOutputs = std::vector<float *>();
+    auto parallelOutputs = std::vector<float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        inputs.push_back(inputData[ch].data());
+        sequentialOutputs.push_back(sequentialData[ch].data());
+        parallelOutputs.push_back(parallelData[ch].data());
+    }
+
+    RnNoiseCommonPlugin sequentialPlugin(channels, sampleFrames);
+    sequentialPlugin.init();
+
+    RnNoiseWorkerPool::Config config;
+    config.workers = workers;
+    config.cpuAffinity = {0};
+    RnNoiseCommonPlugin parallelPlugin(channels, sampleFrames);
+    parallelPlugin.setWorkerPoolConfig(config);
+    parallelPlugin.init();
+
+    for (int i = 0; i < iterations; i++) {
+        for (auto &channelData: inputData) {
+            for (auto &sample: channelData) {
+                sample = noise(rng);
+            }
+        }
+
+        sequentialPlugin.process(inputs.data(), sequentialOutputs.data(), sampleFrames, 0.5f, 20, 2);
+
+        g_allocationsCount = 0;
+        g_countAllocations = true;
+        parallelPlugin.process(inputs.data(), parallelOutputs.data(), sampleFrames, 0.5f, 20, 2);
+        g_countAllocations = false;
+        REQUIRE(g_allocationsCount == 0);
+
+        REQUIRE(parallelData == sequentialData);
+    }
+}
+
+TEST_CASE("Planned latency", "[common_plugin]") {
+    auto sampleFrames = GENERATE(200, 441, 480, 512, 1024);
+    auto retroactiveVADGraceBlocks = GENERATE(0, 2);
+
+    CAPTURE(sampleFrames, retroactiveVADGraceBlocks);
+
+    const size_t blockSize = 480;
+    const size_t iterations = 40;
+    std::minstd_rand rng(3);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<float> inputData(sampleFrames * iterations);
+    for (auto &sample: inputData) {
+        sample = noise(rng);
+    }
+
+    /* Blocks of rnnoise's own size don't need any queueing, so this is plain rnnoise output. */
+    RnNoiseCommonPlugin referencePlugin(1, blockSize);
+    referencePlugin.setHostBlockFrames(blockSize);
+    referencePlugin.init();
+    REQUIRE(referencePlugin.getLatencyFrames(0) == 2 * blockSize);
+
+    std::vector<float> referenceData(inputData.size() / blockSize * blockSize);
+    for (size_t offset = 0; offset < referenceData.size(); offset += blockSize) {
+        const float *input = inputData.data() + offset;
+        float *output = referenceData.data() + offset;
+        referencePlugin.process(&input, &output, blockSize, 0.f, 20, 0);
+    }
+    REQUIRE(referencePlugin.getStats().outputFramesForcedToBeZeroed == 0);
+
+    RnNoiseCommonPlugin plugin(1, sampleFrames);
+    plugin.init();
+    /* Like LADSPA, which only learns the block size on the first run. */
+    plugin.setHostBlockFrames(sampleFrames);
+
+    std::vector<float> outputData(inputData.size());
+    for (size_t i = 0; i < iterations; i++) {
+        const float *input = inputData.data() + i * sampleFrames;
+        float *output = outputData.data() + i * sampleFrames;
+        plugin.process(&input, &output, sampleFrames, 0.f, 20, retroactiveVADGraceBlocks);
+    }
+
+    REQUIRE(plugin.getStats().outputFramesForcedToBeZeroed == 0);
+
+    uint32_t latencyFrames = plugin.getLatencyFrames(retroactiveVADGraceBlocks);
+    REQUIRE(latencyFrames == RnNoiseCommonPlugin::computeLatencyFrames(sampleFrames, retroactiveVADGraceBlocks));
+    REQUIRE(latencyFrames >= 2 * blockSize + blockSize * retroactiveVADGraceBlocks);
+    REQUIRE(latencyFrames < 3 * blockSize + blockSize * retroactiveVADGraceBlocks);
+
+    size_t queueLatencyFrames = latencyFrames - 2 * blockSize;
+    for (size_t i = 0; i < queueLatencyFrames; i++) {
+        REQUIRE(outputData[i] == 0.f);
+    }
+    size_t comparedFrames = std::min(referenceData.size(), outputData.size() - queueLatencyFrames);
+    REQUIRE(std::equal(referenceData.begin(), referenceData.begin() + comparedFrames,
+                       outputData.begin() + queueLatencyFrames));
+}
+
+TEST_CASE("Offline output is aligned with the input", "[common_plugin]") {
+    auto channels = GENERATE(1, 2);
+    auto vadThreshold = GENERATE(0.f, 0.5f);
+    auto retroactiveVADGraceBlocks = GENERATE(0, 2);
+
+    CAPTURE(channels, vadThreshold, retroactiveVADGraceBlocks);
+
+    const size_t blockSize = 480;
+    const size_t totalFrames = 60 * blockSize + 123;
+    std::minstd_rand rng(11);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(totalFrames));
+    for (auto &channelData: inputData) {
+        for (auto &sample: channelData) {
+            sample = noise(rng);
+        }
+    }
+
+    /* Real-time output with blocks of rnnoise's size is delayed exactly by its latency. Trailing
+     * silence pushes the end of the input out.
+     */
+    RnNoiseCommonPlugin referencePlugin(channels, blockSize);
+    referencePlugin.setHostBlockFrames(blockSize);
+    referencePlugin.init();
+    const size_t latencyFrames = referencePlugin.getLatencyFrames(retroactiveVADGraceBlocks);
+    const size_t referenceFrames = (totalFrames + latencyFrames + blockSize - 1) / blockSize * blockSize;
+
+    std::vector<std::vector<float>> referenceInput(channels, std::vector<float>(referenceFrames, 0.f));
+    std::vector<std::vector<float>> referenceData(channels, std::vector<float>(referenceFrames));
+    for (int ch = 0; ch < channels; ch++) {
+        std::copy(inputData[ch].begin(), inputData[ch].end(), referenceInput[ch].begin());
+    }
+    for (size_t offset = 0; offset < referenceFrames; offset += blockSize) {
+        auto inputs = std::vector<const float *>();
+        auto outputs = std::vector<float *>();
+        for (int ch = 0; ch < channels; ch++) {
+            inputs.push_back(referenceInput[ch].data() + offset);
+            outputs.push_back(referenceData[ch].data() + offset);
+        }
+        referencePlugin.process(inputs.data(), outputs.data(), blockSize, vadThreshold, 20, retroactiveVADGraceBlocks);
+    }
+
+    /* Odd block sizes, including one bigger than the max block. */
+    RnNoiseCommonPlugin plugin(channels, 4 * blockSize);
+    plugin.init();
+
+    std::vector<std::vector<float>> outputData(channels, std::vector<float>(totalFrames));
+    const size_t callFrames[] = {1, 100, 441, 2500, 7};
+    size_t inputOffset = 0;
+    size_t outputOffset = 0;
+    for (size_t i = 0; inputOffset < totalFrames; i++) {
+        size_t frames = std::min(callFrames[i % 5], totalFrames - inputOffset);
+        auto inputs = std::vector<const float *>();
+        auto outputs = std::vector<float *>();
+        for (int ch = 0; ch < channels; ch++) {
+            inputs.push_back(inputData[ch].data() + inputOffset);
+            outputs.push_back(outputData[ch].data() + outputOffset);
+        }
+        size_t written = plugin.processOffline(inputs.data(), outputs.data(), frames, vadThreshold, 20,
+                                               retroactiveVADGraceBlocks);
+        REQUIRE(written <= frames);
+        inputOffset += frames;
+        outputOffset += written;
+    }
+
+    while (true) {
+        auto outputs = std::vector<float *>();
+        for (int ch = 0; ch < channels; ch++) {
+            outputs.push_back(outputData[ch].data() + outputOffset);
+        }
+        size_t written = plugin.flush(outputs.data(), 300);
+        if (written == 0) {
+            break;
+        }
+        outputOffset += written;
+    }
+
+    REQUIRE(outputOffset == totalFrames);
+    REQUIRE(plugin.getStats().outputFramesForcedToBeZeroed == 0);
+
+    for (int ch = 0; ch < channels; ch++) {
+        CAPTURE(ch);
+        REQUIRE(std::equal(outputData[ch].begin(), outputData[ch].end(), referenceData[ch].begin() + latencyFrames));
+    }
+}
+
+TEST_CASE("Stats are read while processing", "[common_plugin]") {
+    const size_t sampleFrames = 512;
+    const int iterations = 200;
+
+    RnNoiseCommonPlugin plugin(1, sampleFrames);
+    plugin.init();
+
+    std::minstd_rand rng(5);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<float> inputData(sampleFrames);
+    std::vector<float> outputData(sampleFrames);
+    const float *input = inputData.data();
+    float *output = outputData.data();
+
+    /* The reader sums up deltas of its snapshots, counters must never go backwards. */
+    std::atomic<bool> done{false};
+    RnNoiseStats readerSum{};
+    bool monotonic = true;
+    std::thread reader([&] {
+        RnNoiseStats last{};
+        while (true) {
+            bool finished = done;
+            RnNoiseStats stats = plugin.getStats();
+            monotonic = monotonic && stats.vadGraceBlocks >= last.vadGraceBlocks
+                        && stats.outputFramesForcedToBeZeroed >= last.outputFramesForcedToBeZeroed;
+            RnNoiseStats delta = stats.since(last);
+            readerSum.vadGraceBlocks += delta.vadGraceBlocks;
+            readerSum.outputFramesForcedToBeZeroed += delta.outputFramesForcedToBeZeroed;
+            last = stats;
+            if (finished) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    for (int i = 0; i < iterations; i++) {
+        for (auto &sample: inputData) {
+            sample = noise(rng);
+        }
+        plugin.process(&input, &output, sampleFrames, 0.5f, 20, 1);
+    }
+    done = true;
+    reader.join();
+
+    const RnNoiseStats stats = plugin.getStats();
+    REQUIRE(monotonic);
+    REQUIRE(stats.outputFramesForcedToBeZeroed > 0);
+    REQUIRE(readerSum.vadGraceBlocks == stats.vadGraceBlocks);
+    REQUIRE(readerSum.outputFramesForcedToBeZeroed == stats.outputFramesForcedToBeZeroed);
+
+    plugin.init();
+    REQUIRE(plugin.getStats().outputFramesForcedToBeZeroed == 0);
+    REQUIRE(plugin.getStats().since(stats).outputFramesForcedToBeZeroed == 0);
+}
+
+TEST_CASE("Stage timings and memory footprint", "[common_plugin]") {
+    auto channels = GENERATE(1, 2);
+    const size_t sampleFrames = 480;
+
+    CAPTURE(channels);
+
+    RnNoiseCommonPlugin plugin(channels, sampleFrames);
+    plugin.init();
+
+    const RnNoiseMemoryFootprint footprint = plugin.getMemoryFootprint();
+    REQUIRE(footprint.stateBytes > 0);
+    REQUIRE(footprint.modelBytes > 0);
+    REQUIRE(footprint.scratchBytes > 0);
+    REQUIRE(footprint.queueBytes >= channels * sampleFrames * sizeof(float));
+
+    std::vector<float> inputData(channels * sampleFrames, 0.1f);
+    std::vector<float> outputData(channels * sampleFrames);
+    std::vector<const float *> input;
+    std::vector<float *> output;
+    for (int c = 0; c < channels; c++) {
+        input.push_back(&inputData[c * sampleFrames]);
+        output.push_back(&outputData[c * sampleFrames]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        plugin.process(input.data(), output.data(), sampleFrames, 0.5f, 20, 0);
+    }
+    /* Timings are refreshed by the process() call after they were asked for. */
+    plugin.getStageTimings();
+    plugin.process(input.data(), output.data(), sampleFrames, 0.5f, 20, 0);
+
+    const std::vector<RnNoiseStageTiming> timings = plugin.getStageTimings();
+    if (!RnNoiseCommonPlugin::isProfilingEnabled()) {
+        REQUIRE(timings.empty());
+        return;
+    }
+
+    REQUIRE_FALSE(timings.empty());
+    for (const auto &timing: timings) {
+        CAPTURE(timing.name);
+        REQUIRE(timing.count == 5u * channels);
+        REQUIRE(timing.minNs <= timing.meanNs);
+        REQUIRE(timing.meanNs <= timing.maxNs);
+        REQUIRE(timing.p99Ns <= timing.maxNs);
+    }
+}
+
+/* Harmonics of a gliding pitch with short pauses and a bit of noise, 16 bit scale like rnnoise takes. */
+static std::vector<float> voicedSignal(size_t frames, size_t frameSize) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> noise(-300.f, 300.f);
+    std::vector<float> signal(frames * frameSize);
+    const double pi = 3.14159265358979323846;
+    double phase = 0;
+    for (size_t i = 0; i < signal.size(); i++) {
+        const size_t frame = i / frameSize;
+        const double t = static_cast<double>(i) / 48000;
+        const double f0 = 120 + 60 * std::sin(2 * pi * 0.3 * t) + ((frame / 150) % 2) * 80;
+        const double envelope = (frame / 40) % 3 != 2 ? 3000 : 60;
+        phase += 2 * pi * f0 / 48000;
+        double sample = 0;
+        for (int h = 1; h <= 12; h++) {
+            sample += std::sin(h * phase) / h;
+        }
+        signal[i] = static_cast<float>(envelope * sample) + noise(generator);
+    }
+    return signal;
+}
+
+TEST_CASE("Pitch tracking stays close to the full search", "[rnnoise]") {
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 600;
+    const std::vector<float> input = voicedSignal(frames, frameSize);
+
+    DenoiseState *full = rnnoise_create(nullptr);
+    DenoiseState *tracked = rnnoise_create(nullptr);
+    rnnoise_set_pitch_tracking(tracked, 1);
+
+    std::vector<float> fullOutput(frameSize), trackedOutput(frameSize);
+    float maxVadDifference = 0;
+    double outputEnergy = 0, differenceEnergy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        const float *in = &input[i * frameSize];
+        const float fullVad = rnnoise_process_frame(full, fullOutput.data(), in);
+        const float trackedVad = rnnoise_process_frame(tracked, trackedOutput.data(), in);
+        maxVadDifference = std::max(maxVadDifference, std::abs(fullVad - trackedVad));
+        for (size_t j = 0; j < frameSize; j++) {
+            outputEnergy += fullOutput[j] * static_cast<double>(fullOutput[j]);
+            const double difference = fullOutput[j] - static_cast<double>(trackedOutput[j]);
+            differenceEnergy += difference * difference;
+        }
+    }
+
+    const double snr = 10 * std::log10(outputEnergy / std::max(differenceEnergy, 1e-9));
+    CAPTURE(maxVadDifference, snr);
+    REQUIRE(maxVadDifference < 0.05f);
+    REQUIRE(snr > 30);
+
+    RNNoiseStageTiming fullTimings[RNNOISE_STAGE_COUNT];
+    RNNoiseStageTiming trackedTimings[RNNOISE_STAGE_COUNT];
+    if (rnnoise_get_stage_timings(&full, 1, fullTimings) == 0) {
+        rnnoise_get_stage_timings(&tracked, 1, trackedTimings);
+        CAPTURE(fullTimings[RNNOISE_STAGE_PITCH_SEARCH].mean_ns, trackedTimings[RNNOISE_STAGE_PITCH_SEARCH].mean_ns);
+        REQUIRE(trackedTimings[RNNOISE_STAGE_PITCH_SEARCH].mean_ns < fullTimings[RNNOISE_STAGE_PITCH_SEARCH].mean_ns);
+    }
+
+    rnnoise_destroy(full);
+    rnnoise_destroy(tracked);
+}
+
+TEST_CASE("Multiple frames match frame by frame processing", "[rnnoise]") {
+    auto chunkFrames = GENERATE(1, 3, 4, 7);
+    CAPTURE(chunkFrames);
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 56;
+    std::vector<float> input = voicedSignal(frames, frameSize);
+    /* Silent frames don't advance the RNN state. */
+    std::fill(input.begin() + 20 * frameSize, input.begin() + 26 * frameSize, 0.f);
+
+    DenoiseState *single = rnnoise_create(nullptr);
+    DenoiseState *multiple = rnnoise_create(nullptr);
+
+    std::vector<float> singleOutput(frames * frameSize), singleVad(frames);
+    for (size_t i = 0; i < frames; i++) {
+        singleVad[i] = rnnoise_process_frame(single, &singleOutput[i * frameSize], &input[i * frameSize]);
+    }
+
+    /* In place, like the plugin may pass it. */
+    std::vector<float> multipleOutput = input, multipleVad(frames);
+    for (size_t i = 0; i < frames; i += chunkFrames) {
+        const int count = static_cast<int>(std::min<size_t>(chunkFrames, frames - i));
+        rnnoise_process_frames(multiple, &multipleOutput[i * frameSize], &multipleOutput[i * frameSize],
+                               &multipleVad[i], count);
+    }
+
+    REQUIRE(multipleOutput == singleOutput);
+    REQUIRE(multipleVad == singleVad);
+
+    rnnoise_destroy(single);
+    rnnoise_destroy(multiple);
+}
+
+TEST_CASE("Normalized and int16 variants match the 16 bit scale float API", "[rnnoise]") {
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 40;
+    const float scale = 32767.f;
+    const std::vector<float> voice = voicedSignal(frames, frameSize);
+
+    /* Inputs which convert exactly to the 16 bit scale, like rnnoise converts them. */
+    std::vector<float> normalizedInput(voice.size()), scaledInput(voice.size());
+    std::vector<short> int16Input(voice.size());
+    for (size_t i = 0; i < voice.size(); i++) {
+        normalizedInput[i] = voice[i] / scale;
+        scaledInput[i] = normalizedInput[i] * scale;
+        int16Input[i] = static_cast<short>(std::lround(std::min(32767.f, std::max(-32768.f, voice[i]))));
+    }
+
+    DenoiseState *scaled = rnnoise_create(nullptr);
+    DenoiseState *fromShorts = rnnoise_create(nullptr);
+    DenoiseState *normalized = rnnoise_create(nullptr);
+    DenoiseState *int16 = rnnoise_create(nullptr);
+    DenoiseState *batched[2] = {rnnoise_create(nullptr), rnnoise_create(nullptr)};
+    DenoiseState *multiple = rnnoise_create(nullptr);
+
+    std::vector<float> scaledOutput(frameSize), fromShortsInput(frameSize), fromShortsOutput(frameSize);
+    std::vector<float> normalizedOutput(frameSize), batchedOutput(2 * frameSize);
+    std::vector<short> int16Output(frameSize);
+    std::vector<float> expectedNormalized(frames * frameSize), expectedVad(frames);
+    for (size_t i = 0; i < frames; i++) {
+        const size_t offset = i * frameSize;
+        const float scaledVad = rnnoise_process_frame(scaled, scaledOutput.data(), &scaledInput[offset]);
+        const float normalizedVad = rnnoise_process_frame_normalized(normalized, normalizedOutput.data(),
+                                                                     &normalizedInput[offset]);
+        REQUIRE(normalizedVad == scaledVad);
+        for (size_t j = 0; j < frameSize; j++) {
+            expectedNormalized[offset + j] = scaledOutput[j] / scale;
+        }
+        REQUIRE(std::equal(normalizedOutput.begin(), normalizedOutput.end(), &expectedNormalized[offset]));
+        expectedVad[i] = scaledVad;
+
+        float *outputs[2] = {&batchedOutput[0], &batchedOutput[frameSize]};
+        const float *inputs[2] = {&normalizedInput[offset], &normalizedInput[offset]};
+        float batchedVad[2];
+        rnnoise_process_frame_batch_normalized(batched, outputs, inputs, batchedVad, 2);
+        REQUIRE(batchedVad[0] == scaledVad);
+        REQUIRE(batchedVad[1] == scaledVad);
+        REQUIRE(std::equal(normalizedOutput.begin(), normalizedOutput.end(), outputs[0]));
+        REQUIRE(std::equal(normalizedOutput.begin(), normalizedOutput.end(), outputs[1]));
+
+        std::copy(&int16Input[offset], &int16Input[offset] + frameSize, fromShortsInput.begin());
+        const float fromShortsVad = rnnoise_process_frame(fromShorts, fromShortsOutput.data(), fromShortsInput.data());
+        const float int16Vad = rnnoise_process_frame_int16(int16, int16Output.data(), &int16Input[offset]);
+        REQUIRE(int16Vad == fromShortsVad);
+        for (size_t j = 0; j < frameSize; j++) {
+            const float clamped = std::min(32767.f, std::max(-32768.f, fromShortsOutput[j]));
+            REQUIRE(int16Output[j] == static_cast<short>(std::floor(.5f + clamped)));
+        }
+    }
+
+    /* In place, like the plugin may pass it. */
+    std::vector<float> multipleOutput = normalizedInput, multipleVad(frames);
+    for (size_t i = 0; i < frames; i += 3) {
+        const int count = static_cast<int>(std::min<size_t>(3, frames - i));
+        rnnoise_process_frames_normalized(multiple, &multipleOutput[i * frameSize], &multipleOutput[i * frameSize],
+                                          &multipleVad[i], count);
+    }
+    REQUIRE(multipleOutput == expectedNormalized);
+    REQUIRE(multipleVad == expectedVad);
+
+    for (DenoiseState *st : {scaled, fromShorts, normalized, int16, batched[0], batched[1], multiple}) {
+        rnnoise_destroy(st);
+    }
+}
+
+TEST_CASE("Mono and stereo specializations match the generic plugin", "[common_plugin]") {
+    auto channels = GENERATE(1, 2);
+    auto sampleFrames = GENERATE(200, 480, 512, 1500);
+
+    CAPTURE(channels, sampleFrames);
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t iterations = 150 * frameSize / sampleFrames;
+    const size_t maxBlockFrames = 1000;
+    /* Silent stretches get muted, the second channel lags so its VAD probabilities differ. */
+    std::vector<float> voice = voicedSignal(sampleFrames * iterations / frameSize + 2, frameSize);
+    for (size_t i = 0; i < voice.size(); i++) {
+        if ((i / frameSize) % 70 >= 40) {
+            voice[i] = 0.f;
+        }
+    }
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(sampleFrames * iterations));
+    for (int ch = 0; ch < channels; ch++) {
+        for (size_t i = 0; i < inputData[ch].size(); i++) {
+            inputData[ch][i] = voice[i + ch * frameSize] / 32768.f;
+        }
+    }
+
+    std::unique_ptr<RnNoiseCommonPlugin> specialized = RnNoiseCommonPlugin::create(channels, maxBlockFrames);
+    RnNoiseCommonPlugin generic(channels, maxBlockFrames);
+    specialized->init();
+    generic.init();
+
+    std::vector<std::vector<float>> specializedData(channels, std::vector<float>(sampleFrames));
+    std::vector<std::vector<float>> genericData(channels, std::vector<float>(sampleFrames));
+    auto specializedOutputs = std::vector<float *>();
+    auto genericOutputs = std::vector<float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        specializedOutputs.push_back(specializedData[ch].data());
+        genericOutputs.push_back(genericData[ch].data());
+    }
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto inputs = std::vector<const float *>();
+        for (int ch = 0; ch < channels; ch++) {
+            inputs.push_back(inputData[ch].data() + i * sampleFrames);
+        }
+        /* Shrinking the retroactive grace drops queued blocks with a crossfade. */
+        uint32_t retroactiveVADGraceBlocks = (i * 4 / iterations) % 2 == 0 ? 3 : 1;
+
+        g_allocationsCount = 0;
+        g_countAllocations = true;
+        specialized->process(inputs.data(), specializedOutputs.data(), sampleFrames, 0.5f, 20,
+                             retroactiveVADGraceBlocks);
+        g_countAllocations = false;
+        REQUIRE(g_allocationsCount == 0);
+
+        generic.process(inputs.data(), genericOutputs.data(), sampleFrames, 0.5f, 20, retroactiveVADGraceBlocks);
+
+        CAPTURE(i);
+        REQUIRE(specializedData == genericData);
+    }
+
+    const RnNoiseStats specializedStats = specialized->getStats();
+    const RnNoiseStats genericStats = generic.getStats();
+    REQUIRE(specializedStats.vadGraceBlocks == genericStats.vadGraceBlocks);
+    REQUIRE(specializedStats.retroactiveVADGraceBlocks == genericStats.retroactiveVADGraceBlocks);
+    REQUIRE(specializedStats.outputFramesForcedToBeZeroed == genericStats.outputFramesForcedToBeZeroed);
+
+    /* And the offline path, which writes the queue out the same way. */
+    specialized->init();
+    generic.init();
+    std::vector<std::vector<float>> specializedOffline(channels, std::vector<float>(inputData[0].size()));
+    std::vector<std::vector<float>> genericOffline(channels, std::vector<float>(inputData[0].size()));
+    auto inputs = std::vector<const float *>();
+    for (int ch = 0; ch < channels; ch++) {
+        inputs.push_back(inputData[ch].data());
+        specializedOutputs[ch] = specializedOffline[ch].data();
+        genericOutputs[ch] = genericOffline[ch].data();
+    }
+    size_t specializedFrames = specialized->processOffline(inputs.data(), specializedOutputs.data(),
+                                                           inputData[0].size(), 0.5f, 20, 2);
+    size_t genericFrames = generic.processOffline(inputs.data(), genericOutputs.data(), inputData[0].size(),
+                                                  0.5f, 20, 2);
+    REQUIRE(specializedFrames == genericFrames);
+    while (specializedFrames < inputData[0].size()) {
+        for (int ch = 0; ch < channels; ch++) {
+            specializedOutputs[ch] = specializedOffline[ch].data() + specializedFrames;
+            genericOutputs[ch] = genericOffline[ch].data() + genericFrames;
+        }
+        size_t frames = specialized->flush(specializedOutputs.data(), inputData[0].size() - specializedFrames);
+        REQUIRE(frames > 0);
+        REQUIRE(generic.flush(genericOutputs.data(), inputData[0].size() - genericFrames) == frames);
+        specializedFrames += frames;
+        genericFrames += frames;
+    }
+    REQUIRE(specializedOffline == genericOffline);
+}
+
+TEST_CASE("Interleaved processing matches planar processing", "[common_plugin]") {
+    auto channels = GENERATE(1, 2, 3);
+    auto padding = GENERATE(0, 1);
+    auto sampleFrames = GENERATE(200, 480, 1500);
+
+    const uint32_t stride = static_cast<uint32_t>(channels + padding);
+    CAPTURE(channels, stride, sampleFrames);
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t iterations = 100 * frameSize / sampleFrames;
+    const size_t maxBlockFrames = 1000;
+    const float int16Scale = 32767.f;
+    std::vector<float> voice = voicedSignal(sampleFrames * iterations / frameSize + 3, frameSize);
+    for (size_t i = 0; i < voice.size(); i++) {
+        if ((i / frameSize) % 70 >= 40) {
+            voice[i] = 0.f;
+        }
+    }
+
+    /* Planar float input and the same as interleaved floats and as 16 bit samples. The planar
+     * reference of the 16 bit samples holds the floats they are converted to.
+     */
+    const size_t totalFrames = sampleFrames * iterations;
+    std::vector<std::vector<float>> inputData(channels, std::vector<float>(totalFrames));
+    std::vector<std::vector<float>> int16InputData(channels, std::vector<float>(totalFrames));
+    std::vector<float> interleavedInput(totalFrames * stride, 2.f);
+    std::vector<int16_t> int16Input(totalFrames * stride, 12345);
+    for (int ch = 0; ch < channels; ch++) {
+        for (size_t i = 0; i < totalFrames; i++) {
+            float sample = voice[i + ch * frameSize] / 32768.f;
+            int16_t sample16 = static_cast<int16_t>(std::lround(sample * int16Scale));
+            inputData[ch][i] = sample;
+            int16InputData[ch][i] = sample16 * (1.f / int16Scale);
+            interleavedInput[i * stride + ch] = sample;
+            int16Input[i * stride + ch] = sample16;
+        }
+    }
+
+    std::unique_ptr<RnNoiseCommonPlugin> planar = RnNoiseCommonPlugin::create(channels, maxBlockFrames);
+    std::unique_ptr<RnNoiseCommonPlugin> interleaved = RnNoiseCommonPlugin::create(channels, maxBlockFrames);
+    std::unique_ptr<RnNoiseCommonPlugin> int16Planar = RnNoiseCommonPlugin::create(channels, maxBlockFrames);
+    std::unique_ptr<RnNoiseCommonPlugin> int16 = RnNoiseCommonPlugin::create(channels, maxBlockFrames);
+    for (auto *plugin: {planar.get(), interleaved.get(), int16Planar.get(), int16.get()}) {
+        plugin->init();
+    }
+
+    std::vector<std::vector<float>> planarData(channels, std::vector<float>(sampleFrames));
+    std::vector<std::vector<float>> int16PlanarData(channels, std::vector<float>(sampleFrames));
+    std::vector<float *> planarOutputs, int16PlanarOutputs;
+    for (int ch = 0; ch < channels; ch++) {
+        planarOutputs.push_back(planarData[ch].data());
+        int16PlanarOutputs.push_back(int16PlanarData[ch].data());
+    }
+    std::vector<float> interleavedOutput(sampleFrames * stride, 3.f);
+
+    for (size_t i = 0; i < iterations; i++) {
+        CAPTURE(i);
+        std::vector<const float *> inputs, int16Inputs;
+        for (int ch = 0; ch < channels; ch++) {
+            inputs.push_back(inputData[ch].data() + i * sampleFrames);
+            int16Inputs.push_back(int16InputData[ch].data() + i * sampleFrames);
+        }
+        /* Shrinking the retroactive grace drops queued blocks with a crossfade. */
+        uint32_t retroactiveVADGraceBlocks = (i * 4 / iterations) % 2 == 0 ? 3 : 1;
+
+        planar->process(inputs.data(), planarOutputs.data(), sampleFrames, 0.5f, 20, retroactiveVADGraceBlocks);
+        int16Planar->process(int16Inputs.data(), int16PlanarOutputs.data(), sampleFrames, 0.5f, 20,
+                             retroactiveVADGraceBlocks);
+
+        g_allocationsCount = 0;
+        g_countAllocations = true;
+        interleaved->processInterleaved(&interleavedInput[i * sampleFrames * stride], interleavedOutput.data(),
+                                        sampleFrames, stride, 0.5f, 20, retroactiveVADGraceBlocks);
+        /* In place. */
+        int16_t *int16Frames = &int16Input[i * sampleFrames * stride];
+        int16->processInterleaved(int16Frames, int16Frames, sampleFrames, stride, 0.5f, 20,
+                                  retroactiveVADGraceBlocks);
+        g_countAllocations = false;
+        REQUIRE(g_allocationsCount == 0);
+
+        bool floatMatches = true, int16Matches = true, paddingKept = true;
+        for (size_t frame = 0; frame < static_cast<size_t>(sampleFrames); frame++) {
+            for (int ch = 0; ch < channels; ch++) {
+                floatMatches &= interleavedOutput[frame * stride + ch] == planarData[ch][frame];
+                float expected = std::min(int16Scale, std::max(-int16Scale - 1.f, int16PlanarData[ch][frame] * int16Scale));
+                int16Matches &= int16Frames[frame * stride + ch] == static_cast<int16_t>(std::floor(.5f + expected));
+            }
+            for (uint32_t pad = channels; pad < stride; pad++) {
+                paddingKept &= interleavedOutput[frame * stride + pad] == 3.f && int16Frames[frame * stride + pad] == 12345;
+            }
+        }
+        REQUIRE(floatMatches);
+        REQUIRE(int16Matches);
+        REQUIRE(paddingKept);
+    }
+
+    const RnNoiseStats planarStats = planar->getStats();
+    const RnNoiseStats interleavedStats = interleaved->getStats();
+    REQUIRE(interleavedStats.retroactiveVADGraceBlocks == planarStats.retroactiveVADGraceBlocks);
+    REQUIRE(interleavedStats.outputFramesForcedToBeZeroed == planarStats.outputFramesForcedToBeZeroed);
+}
+
+TEST_CASE("Malformed models are rejected", "[rnnoise]") {
+    REQUIRE(rnnoise_model_from_filename("/nonexistent/model.rnnn") == nullptr);
+
+    /* A record header claiming more data than there is. */
+    std::vector<int> blob(16, 0);
+    std::memcpy(blob.data(), "DNNw", 4);
+    blob[3] = 128;
+    blob[4] = 128;
+    REQUIRE(rnnoise_model_from_buffer(blob.data(), static_cast<int>(blob.size() * sizeof(int))) == nullptr);
+
+    /* Records must be padded to 64 bytes so that they stay aligned. */
+    blob[3] = 4;
+    blob[4] = 4;
+    blob.resize(17);
+    REQUIRE(rnnoise_model_from_buffer(blob.data(), static_cast<int>(blob.size() * sizeof(int))) == nullptr);
+}
+
+TEST_CASE("Model changes are swapped in without allocating", "[common_plugin]") {
+    const size_t sampleFrames = 480;
+    RnNoiseCommonPlugin plugin(2, sampleFrames);
+    plugin.init();
+
+    REQUIRE_FALSE(plugin.setModelPath("/nonexistent/model.rnnn"));
+    REQUIRE(plugin.getModelPath().empty());
+
+    std::vector<float> inputData = voicedSignal(60, sampleFrames);
+    for (auto &sample: inputData) {
+        sample /= 32768.f;
+    }
+    std::vector<float> outputLeft(sampleFrames), outputRight(sampleFrames);
+    float *outputs[] = {outputLeft.data(), outputRight.data()};
+
+    double outputEnergy = 0;
+    for (int i = 0; i < 60; i++) {
+        /* Prepared off the processing thread, picked up by the next process(). */
+        if (i % 20 == 10) {
+            REQUIRE(plugin.setModelPath(""));
+        }
+
+        const float *input = &inputData[i * sampleFrames];
+        const float *inputs[] = {input, input};
+        g_allocationsCount = 0;
+        g_countAllocations = true;
+        plugin.process(inputs, outputs, sampleFrames, 0.f, 20, 0);
+        g_countAllocations = false;
+        REQUIRE(g_allocationsCount == 0);
+
+        for (float sample: outputLeft) {
+            outputEnergy += sample * static_cast<double>(sample);
+        }
+    }
+    REQUIRE(outputEnergy > 0);
+}
+
+/* Half precision rounded to nearest, values below its normal range are flushed to zero. */
+static uint16_t toFloat16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t absBits = bits & 0x7fffffff;
+    if (absBits < 0x38800000) {
+        return static_cast<uint16_t>(sign);
+    }
+    return static_cast<uint16_t>(sign | ((absBits - 0x38000000 + 0x1000) >> 13));
+}
+
+static float fromFloat16(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t bits = (half & 0x7fff) != 0 ? sign | (((half & 0x7fffu) << 13) + 0x38000000) : sign;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+enum class ModelWeights {
+    Int8,
+    Float16,
+};
+
+/* The built-in model as a weights blob, like `dump_weights_blob --int8` or `--float16` write it:
+ * without the float weights of the layers which have int8 weights as well, or with the float
+ * weights in half precision instead of the int8 ones.
+ */
+static std::vector<unsigned char> modelBlob(ModelWeights weights) {
+    const std::string floatSuffix = "_weights_float";
+    const std::string int8Suffix = "_weights_int8";
+    auto hasArray = [](const std::string &name) {
+        for (const WeightArray *array = rnnoise_arrays; array->name != nullptr; array++) {
+            if (name == array->name) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto prefix = [](const std::string &name, const std::string &suffix) {
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return name.substr(0, name.size() - suffix.size());
+        }
+        return std::string();
+    };
+
+    std::vector<unsigned char> blob;
+    for (const WeightArray *array = rnnoise_arrays; array->name != nullptr; array++) {
+        const std::string name = array->name;
+        const std::string floatPrefix = prefix(name, floatSuffix);
+        const std::string int8Prefix = prefix(name, int8Suffix);
+        if (weights == ModelWeights::Int8 && !floatPrefix.empty() && hasArray(floatPrefix + int8Suffix)) {
+            continue;
+        }
+        if (weights == ModelWeights::Float16 && !int8Prefix.empty() && hasArray(int8Prefix + floatSuffix)) {
+            continue;
+        }
+
+        WeightHead head{};
+        std::memcpy(head.head, "DNNw", 4);
+        head.version = WEIGHT_BLOB_VERSION;
+        head.type = array->type;
+        head.size = array->size;
+        const auto *data = static_cast<const unsigned char *>(array->data);
+        std::vector<uint16_t> halfData;
+        if (weights == ModelWeights::Float16 && !floatPrefix.empty() && array->type == WEIGHT_TYPE_float) {
+            const auto *floatData = static_cast<const float *>(array->data);
+            for (size_t i = 0; i < array->size / sizeof(float); i++) {
+                halfData.push_back(toFloat16(floatData[i]));
+            }
+            head.type = WEIGHT_TYPE_float16;
+            head.size = static_cast<int>(halfData.size() * sizeof(uint16_t));
+            data = reinterpret_cast<const unsigned char *>(halfData.data());
+        }
+        head.block_size = (head.size + WEIGHT_BLOCK_SIZE - 1) / WEIGHT_BLOCK_SIZE * WEIGHT_BLOCK_SIZE;
+        std::strncpy(head.name, array->name, sizeof(head.name) - 1);
+        const auto *headBytes = reinterpret_cast<const unsigned char *>(&head);
+        blob.insert(blob.end(), headBytes, headBytes + sizeof(head));
+        blob.insert(blob.end(), data, data + head.size);
+        blob.resize(blob.size() + head.block_size - head.size);
+    }
+    return blob;
+}
+
+TEST_CASE("Real-input transforms match the complex transforms", "[rnnoise]") {
+    const int halfSize = rnn_kfft_half.nfft;
+    const int size = rnn_kfft.nfft;
+    REQUIRE(size == 2 * halfSize);
+
+    std::minstd_rand generator(7);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> input(size);
+    for (auto &sample: input) {
+        sample = distribution(generator);
+    }
+
+    for (const float *halfWindow: {static_cast<const float *>(nullptr), rnn_half_window}) {
+        CAPTURE(halfWindow != nullptr);
+        /* The window is symmetric, only its first half is stored. */
+        std::vector<float> window(size, 1.f);
+        for (int i = 0; halfWindow != nullptr && i < halfSize; i++) {
+            window[i] = window[size - 1 - i] = halfWindow[i];
+        }
+
+        std::vector<kiss_fft_cpx> complexInput(size), complexSpectrum(size);
+        for (int i = 0; i < size; i++) {
+            complexInput[i].r = input[i] * window[i];
+            complexInput[i].i = 0;
+        }
+        rnn_fft(&rnn_kfft, complexInput.data(), complexSpectrum.data(), 0);
+
+        std::vector<kiss_fft_cpx> spectrum(halfSize + 1);
+        rnn_real_fft(&rnn_kfft_half, halfWindow, input.data(), spectrum.data(), 0);
+        float maxSpectrumDifference = 0;
+        for (int i = 0; i <= halfSize; i++) {
+            maxSpectrumDifference = std::max({maxSpectrumDifference,
+                                              std::abs(spectrum[i].r - complexSpectrum[i].r),
+                                              std::abs(spectrum[i].i - complexSpectrum[i].i)});
+        }
+
+        /* The inverse of the Hermitian extension of the half spectrum is real. */
+        std::vector<kiss_fft_cpx> complexOutput(size);
+        for (int i = 0; i <= halfSize; i++) {
+            complexSpectrum[i] = spectrum[i];
+            if (i > 0 && i < halfSize) {
+                complexSpectrum[size - i].r = spectrum[i].r;
+                complexSpectrum[size - i].i = -spectrum[i].i;
+            }
+        }
+        rnn_ifft(&rnn_kfft, complexSpectrum.data(), complexOutput.data(), 0);
+
+        std::vector<float> output(size);
+        rnn_real_ifft(&rnn_kfft_half, halfWindow, spectrum.data(), output.data(), 0);
+        float maxOutputDifference = 0;
+        for (int i = 0; i < size; i++) {
+            maxOutputDifference = std::max(maxOutputDifference,
+                                           std::abs(output[i] - complexOutput[i].r * window[i]));
+        }
+
+        /* The spectrum is scaled by 1/size, the inverse isn't scaled. */
+        CAPTURE(maxSpectrumDifference, maxOutputDifference);
+        REQUIRE(maxSpectrumDifference < 1e-7f);
+        REQUIRE(maxOutputDifference < 1e-6f);
+    }
+}
+
+TEST_CASE("Vectorized FFT butterflies match the C butterflies", "[rnnoise]") {
+    const int size = rnn_kfft_half.nfft;
+
+    std::minstd_rand generator(8);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<kiss_fft_cpx> input(size);
+    for (auto &value: input) {
+        value.r = distribution(generator);
+        value.i = distribution(generator);
+    }
+    std::vector<float> realInput(2 * size);
+    for (auto &sample: realInput) {
+        sample = distribution(generator);
+    }
+
+    std::vector<kiss_fft_cpx> reference = input;
+    rnn_fft_impl(&rnn_kfft_half, reference.data());
+    std::vector<kiss_fft_cpx> referenceSpectrum(size + 1);
+    rnn_real_fft(&rnn_kfft_half, rnn_half_window, realInput.data(), referenceSpectrum.data(), 0);
+    std::vector<float> referenceOutput(2 * size);
+    rnn_real_ifft(&rnn_kfft_half, rnn_half_window, referenceSpectrum.data(), referenceOutput.data(), 0);
+
+    /* Every stage of the real-input transforms' plan is vectorized. NEON builds take the NEON
+     * butterflies whatever the arch.
+     */
+    const int maxArch = std::min(rnn_select_arch(), 2);
+    for (int arch = 0; arch <= maxArch; arch++) {
+        std::vector<kiss_fft_cpx> output = input;
+        rnn_fft_impl_arch(&rnn_kfft_half, output.data(), arch);
+        float maxDifference = 0;
+        for (int i = 0; i < size; i++) {
+            maxDifference = std::max({maxDifference, std::abs(output[i].r - reference[i].r),
+                                      std::abs(output[i].i - reference[i].i)});
+        }
+
+        std::vector<kiss_fft_cpx> spectrum(size + 1);
+        rnn_real_fft(&rnn_kfft_half, rnn_half_window, realInput.data(), spectrum.data(), arch);
+        float maxSpectrumDifference = 0;
+        for (int i = 0; i <= size; i++) {
+            maxSpectrumDifference = std::max({maxSpectrumDifference,
+                                              std::abs(spectrum[i].r - referenceSpectrum[i].r),
+                                              std::abs(spectrum[i].i - referenceSpectrum[i].i)});
+        }
+
+        std::vector<float> realOutput(2 * size);
+        rnn_real_ifft(&rnn_kfft_half, rnn_half_window, referenceSpectrum.data(), realOutput.data(), arch);
+        float maxOutputDifference = 0;
+        for (int i = 0; i < 2 * size; i++) {
+            maxOutputDifference = std::max(maxOutputDifference, std::abs(realOutput[i] - referenceOutput[i]));
+        }
+
+        /* The unscaled butterflies sum up to size values of magnitude 1. */
+        CAPTURE(arch, maxDifference, maxSpectrumDifference, maxOutputDifference);
+        REQUIRE(maxDifference < 1e-4f);
+        REQUIRE(maxSpectrumDifference < 1e-7f);
+        REQUIRE(maxOutputDifference < 1e-6f);
+    }
+}
+
+TEST_CASE("Int8 kernels stay close to the float weights", "[rnnoise]") {
+    RNNoise model;
+    REQUIRE(init_rnnoise(&model, rnnoise_arrays) == 0);
+    const LinearLayer *layers[] = {&model.conv2, &model.gru1_input, &model.gru1_recurrent, &model.gru3_recurrent};
+
+    /* The quantized layers all take tanh() or GRU outputs. */
+    std::minstd_rand generator(5);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<std::vector<float>> inputs(MAX_BATCH);
+    for (auto &input: inputs) {
+        input.resize(1024);
+        for (auto &sample: input) {
+            sample = distribution(generator);
+        }
+    }
+
+    const int maxArch = std::min(rnn_select_arch(), 2);
+    for (const LinearLayer *layer: layers) {
+        REQUIRE(layer->weights != nullptr);
+        if (layer->float_weights == nullptr) {
+            WARN("The built-in model has no float weights to compare with");
+            return;
+        }
+        LinearLayer floatLayer = *layer, int8Layer = *layer;
+        floatLayer.weights = nullptr;
+        int8Layer.float_weights = nullptr;
+        const int outputs = layer->nb_outputs;
+
+        std::vector<float> floatOutput(outputs), referenceOutput(outputs), int8Output(outputs);
+        compute_linear(&floatLayer, floatOutput.data(), inputs[0].data(), 0);
+        compute_linear(&int8Layer, referenceOutput.data(), inputs[0].data(), 0);
+
+        for (int arch = 0; arch <= maxArch; arch++) {
+            CAPTURE(layer->nb_inputs, outputs, arch);
+            compute_linear(&int8Layer, int8Output.data(), inputs[0].data(), arch);
+
+            /* Every arch quantizes the inputs the same way, only the summation order differs. */
+            double outputEnergy = 0, errorEnergy = 0;
+            float maxArchDifference = 0;
+            for (int i = 0; i < outputs; i++) {
+                outputEnergy += floatOutput[i] * static_cast<double>(floatOutput[i]);
+                const double error = int8Output[i] - static_cast<double>(floatOutput[i]);
+                errorEnergy += error * error;
+                maxArchDifference = std::max(maxArchDifference, std::abs(int8Output[i] - referenceOutput[i]));
+            }
+            const double snr = 10 * std::log10(outputEnergy / std::max(errorEnergy, 1e-20));
+            CAPTURE(snr, maxArchDifference);
+            REQUIRE(snr > 30);
+            REQUIRE(maxArchDifference < 1e-4f);
+
+            std::vector<std::vector<float>> batchOutputs(MAX_BATCH, std::vector<float>(outputs));
+            std::vector<float *> batchOutputPtrs;
+            std::vector<const float *> batchInputPtrs;
+            for (int k = 0; k < MAX_BATCH; k++) {
+                batchOutputPtrs.push_back(batchOutputs[k].data());
+                batchInputPtrs.push_back(inputs[k].data());
+            }
+            compute_linear_batch(&int8Layer, batchOutputPtrs.data(), batchInputPtrs.data(), MAX_BATCH, arch);
+            for (int k = 0; k < MAX_BATCH; k++) {
+                compute_linear(&int8Layer, int8Output.data(), inputs[k].data(), arch);
+                for (int i = 0; i < outputs; i++) {
+                    REQUIRE(std::abs(batchOutputs[k][i] - int8Output[i]) < 1e-5f);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Half precision kernels match the float kernels", "[rnnoise]") {
+    RNNoise model;
+    REQUIRE(init_rnnoise(&model, rnnoise_arrays) == 0);
+    const LinearLayer *layers[] = {&model.conv1, &model.conv2, &model.gru1_input, &model.gru1_recurrent,
+                                   &model.dense_out};
+
+    std::minstd_rand generator(6);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<std::vector<float>> inputs(MAX_BATCH);
+    for (auto &input: inputs) {
+        input.resize(1024);
+        for (auto &sample: input) {
+            sample = distribution(generator);
+        }
+    }
+
+    const int maxArch = std::min(rnn_select_arch(), 2);
+    for (const LinearLayer *layer: layers) {
+        if (layer->float_weights == nullptr) {
+            continue;
+        }
+        size_t weightCount = static_cast<size_t>(layer->nb_inputs) * layer->nb_outputs;
+        if (layer->weights_idx != nullptr) {
+            weightCount = 0;
+            const int *idx = layer->weights_idx;
+            for (int i = 0; i < layer->nb_outputs; i += 8) {
+                weightCount += 32 * *idx;
+                idx += 1 + *idx;
+            }
+        }
+
+        /* The float kernels on exactly the weights the half precision ones expand. */
+        std::vector<uint16_t> halfWeights(weightCount);
+        std::vector<float> expandedWeights(weightCount);
+        for (size_t i = 0; i < weightCount; i++) {
+            halfWeights[i] = toFloat16(layer->float_weights[i]);
+            expandedWeights[i] = fromFloat16(halfWeights[i]);
+        }
+        LinearLayer halfLayer = *layer, expandedLayer = *layer;
+        halfLayer.weights = nullptr;
+        halfLayer.float_weights = nullptr;
+        halfLayer.float16_weights = halfWeights.data();
+        expandedLayer.weights = nullptr;
+        expandedLayer.float_weights = expandedWeights.data();
+        const int outputs = layer->nb_outputs;
+
+        std::vector<float> expandedOutput(outputs), halfOutput(outputs);
+        for (int arch = 0; arch <= maxArch; arch++) {
+            CAPTURE(layer->nb_inputs, outputs, arch);
+            compute_linear(&expandedLayer, expandedOutput.data(), inputs[0].data(), arch);
+            compute_linear(&halfLayer, halfOutput.data(), inputs[0].data(), arch);
+            for (int i = 0; i < outputs; i++) {
+                REQUIRE(std::abs(halfOutput[i] - expandedOutput[i]) < 1e-5f);
+            }
+
+            std::vector<std::vector<float>> batchOutputs(MAX_BATCH, std::vector<float>(outputs));
+            std::vector<float *> batchOutputPtrs;
+            std::vector<const float *> batchInputPtrs;
+            for (int k = 0; k < MAX_BATCH; k++) {
+                batchOutputPtrs.push_back(batchOutputs[k].data());
+                batchInputPtrs.push_back(inputs[k].data());
+            }
+            compute_linear_batch(&halfLayer, batchOutputPtrs.data(), batchInputPtrs.data(), MAX_BATCH, arch);
+            for (int k = 0; k < MAX_BATCH; k++) {
+                compute_linear(&expandedLayer, expandedOutput.data(), inputs[k].data(), arch);
+                for (int i = 0; i < outputs; i++) {
+                    REQUIRE(std::abs(batchOutputs[k][i] - expandedOutput[i]) < 1e-5f);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Int8 and half precision models stay close to the float model", "[rnnoise]") {
+    const ModelWeights weights = GENERATE(ModelWeights::Int8, ModelWeights::Float16);
+    const double minSnr = weights == ModelWeights::Int8 ? 30 : 60;
+    CAPTURE(weights == ModelWeights::Int8 ? "int8" : "float16");
+
+    const std::vector<unsigned char> blob = modelBlob(weights);
+    RNNModel *model = rnnoise_model_from_buffer(blob.data(), static_cast<int>(blob.size()));
+    REQUIRE(model != nullptr);
+
+    DenoiseState *reference = rnnoise_create(nullptr);
+    DenoiseState *quantized = rnnoise_create(model);
+    rnnoise_model_free(model);
+
+    RNNoiseMemoryFootprint referenceFootprint, quantizedFootprint;
+    rnnoise_get_memory_footprint(reference, &referenceFootprint);
+    rnnoise_get_memory_footprint(quantized, &quantizedFootprint);
+    CAPTURE(referenceFootprint.model_bytes, quantizedFootprint.model_bytes);
+    REQUIRE(quantizedFootprint.model_bytes <= referenceFootprint.model_bytes);
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 600;
+    const std::vector<float> input = voicedSignal(frames, frameSize);
+    std::vector<float> referenceOutput(frameSize), quantizedOutput(frameSize);
+    float maxVadDifference = 0;
+    double outputEnergy = 0, differenceEnergy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        const float *in = &input[i * frameSize];
+        const float referenceVad = rnnoise_process_frame(reference, referenceOutput.data(), in);
+        const float quantizedVad = rnnoise_process_frame(quantized, quantizedOutput.data(), in);
+        maxVadDifference = std::max(maxVadDifference, std::abs(referenceVad - quantizedVad));
+        for (size_t j = 0; j < frameSize; j++) {
+            outputEnergy += referenceOutput[j] * static_cast<double>(referenceOutput[j]);
+            const double difference = referenceOutput[j] - static_cast<double>(quantizedOutput[j]);
+            differenceEnergy += difference * difference;
+        }
+    }
+
+    const double snr = 10 * std::log10(outputEnergy / std::max(differenceEnergy, 1e-9));
+    CAPTURE(maxVadDifference, snr);
+    REQUIRE(maxVadDifference < 0.05f);
+    REQUIRE(snr > minSnr);
+
+    rnnoise_destroy(reference);
+    rnnoise_destroy(quantized);
+}
+
+TEST_CASE("Model cache follows files replaced by rename", "[common_plugin]") {
+    const std::string path = "model_cache_test.rnnn";
+    const std::string newPath = path + ".new";
+    auto writeFile = [](const std::string &filePath, const std::vector<unsigned char> &blob) {
+        FILE *file = std::fopen(filePath.c_str(), "wb");
+        REQUIRE(file != nullptr);
+        REQUIRE(std::fwrite(blob.data(), 1, blob.size(), file) == blob.size());
+        std::fclose(file);
+    };
+    auto modelData = [](const std::shared_ptr<RNNModel> &model) {
+        int size = 0;
+        auto data = static_cast<const unsigned char *>(rnnoise_model_get_data(model.get(), &size));
+        return std::vector<unsigned char>(data, data + size);
+    };
+
+    const std::vector<unsigned char> int8Blob = modelBlob(ModelWeights::Int8);
+    const std::vector<unsigned char> float16Blob = modelBlob(ModelWeights::Float16);
+    writeFile(path, int8Blob);
+
+    std::shared_ptr<RNNModel> first = RnNoiseModelCache::acquire(path);
+    REQUIRE(first != nullptr);
+    REQUIRE(RnNoiseModelCache::acquire(path) == first);
+    REQUIRE(modelData(first) == int8Blob);
+
+#ifndef _WIN32
+    /* Windows refuses to replace a file while it is mapped. */
+    writeFile(newPath, float16Blob);
+    REQUIRE(std::rename(newPath.c_str(), path.c_str()) == 0);
+
+    std::shared_ptr<RNNModel> second = RnNoiseModelCache::acquire(path);
+    REQUIRE(second != nullptr);
+    REQUIRE(second != first);
+    REQUIRE(modelData(second) == float16Blob);
+    REQUIRE(modelData(first) == int8Blob);
+    REQUIRE(RnNoiseModelCache::loadedModels() == 2);
+    second.reset();
+#endif
+
+    first.reset();
+    REQUIRE(RnNoiseModelCache::loadedModels() == 0);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Batches and multiple frames match single frames on every arch", "[rnnoise]") {
+    ArchOverride::set(nullptr);
+    const char *const archNames[] = {"c", "sse4_1", "avx2"};
+    const int maxArch = std::min(rnn_select_arch(), 2);
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 60;
+    const size_t streams = 4;
+    /* Every stream its own signal, so the batched states differ. */
+    const std::vector<float> voice = voicedSignal(frames + streams, frameSize);
+
+    for (int arch = 0; arch <= maxArch; arch++) {
+        ArchOverride override(archNames[arch]);
+        CAPTURE(archNames[arch]);
+
+        std::vector<std::vector<float>> singleOutput(streams, std::vector<float>(frames * frameSize));
+        std::vector<std::vector<float>> singleVad(streams, std::vector<float>(frames));
+        for (size_t s = 0; s < streams; s++) {
+            DenoiseState *st = rnnoise_create(nullptr);
+            for (size_t i = 0; i < frames; i++) {
+                singleVad[s][i] = rnnoise_process_frame(st, &singleOutput[s][i * frameSize],
+                                                        &voice[(i + s) * frameSize]);
+            }
+            rnnoise_destroy(st);
+        }
+
+        for (size_t count = 1; count <= streams; count++) {
+            CAPTURE(count);
+            std::vector<DenoiseState *> states(count);
+            for (auto &st: states) {
+                st = rnnoise_create(nullptr);
+            }
+            std::vector<std::vector<float>> batchOutput(count, std::vector<float>(frames * frameSize));
+            std::vector<std::vector<float>> batchVad(count, std::vector<float>(frames));
+            for (size_t i = 0; i < frames; i++) {
+                std::vector<float *> outputs(count);
+                std::vector<const float *> inputs(count);
+                std::vector<float> vad(count);
+                for (size_t s = 0; s < count; s++) {
+                    outputs[s] = &batchOutput[s][i * frameSize];
+                    inputs[s] = &voice[(i + s) * frameSize];
+                }
+                rnnoise_process_frame_batch(states.data(), outputs.data(), inputs.data(), vad.data(),
+                                            static_cast<int>(count));
+                for (size_t s = 0; s < count; s++) {
+                    batchVad[s][i] = vad[s];
+                }
+            }
+            for (size_t s = 0; s < count; s++) {
+                REQUIRE(batchOutput[s] == singleOutput[s]);
+                REQUIRE(batchVad[s] == singleVad[s]);
+                rnnoise_destroy(states[s]);
+            }
+        }
+
+        DenoiseState *st = rnnoise_create(nullptr);
+        std::vector<float> framesOutput(frames * frameSize), framesVad(frames);
+        for (size_t i = 0; i < frames; i += 4) {
+            rnnoise_process_frames(st, &framesOutput[i * frameSize], &voice[i * frameSize], &framesVad[i], 4);
+        }
+        rnnoise_destroy(st);
+        REQUIRE(framesOutput == singleOutput[0]);
+        REQUIRE(framesVad == singleVad[0]);
+    }
+}
+
+TEST_CASE("Every arch forced through RNNOISE_ARCH gives the same output", "[rnnoise]") {
+    ArchOverride::set(nullptr);
+    const int detectedArch = rnn_select_arch();
+    const char *const archNames[] = {"c", "sse4_1", "avx2"};
+    const int maxArch = std::min(detectedArch, 2);
+
+    {
+        /* Never above what the CPU supports. */
+        ArchOverride override("avx2");
+        REQUIRE(rnn_select_arch() == maxArch);
+    }
+
+    const size_t frameSize = rnnoise_get_frame_size();
+    const size_t frames = 300;
+    const float scale = 32767.f;
+    std::vector<float> input = voicedSignal(frames, frameSize);
+    /* Exactly the samples rnnoise gets from the normalized input. */
+    std::vector<float> normalizedInput(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        normalizedInput[i] = input[i] / scale;
+        input[i] = normalizedInput[i] * scale;
+    }
+    std::vector<std::vector<float>> outputs, vads;
+    for (int arch = 0; arch <= maxArch; arch++) {
+        ArchOverride override(archNames[arch]);
+        REQUIRE(rnn_select_arch() == arch);
+        CAPTURE(archNames[arch]);
+
+        DenoiseState *st = rnnoise_create(nullptr);
+        std::vector<float> output(frames * frameSize), vad(frames);
+        for (size_t i = 0; i < frames; i++) {
+            vad[i] = rnnoise_process_frame(st, &output[i * frameSize], &input[i * frameSize]);
+        }
+        rnnoise_destroy(st);
+
+        /* Every other entry point gives the same output as rnnoise_process_frame() on this arch. */
+        DenoiseState *batched[2] = {rnnoise_create(nullptr), rnnoise_create(nullptr)};
+        DenoiseState *multiple = rnnoise_create(nullptr);
+        DenoiseState *normalized = rnnoise_create(nullptr);
+        std::vector<float> batchedOutput(2 * frames * frameSize), batchedVad(2 * frames);
+        std::vector<float> multipleOutput(frames * frameSize), multipleVad(frames);
+        std::vector<float> normalizedOutput(frames * frameSize), normalizedVad(frames);
+        for (size_t i = 0; i < frames; i++) {
+            float *batchOutputs[2] = {&batchedOutput[i * frameSize], &batchedOutput[(frames + i) * frameSize]};
+            const float *batchInputs[2] = {&input[i * frameSize], &input[i * frameSize]};
+            rnnoise_process_frame_batch(batched, batchOutputs, batchInputs, &batchedVad[2 * i], 2);
+            normalizedVad[i] = rnnoise_process_frame_normalized(normalized, &normalizedOutput[i * frameSize],
+                                                                &normalizedInput[i * frameSize]);
+        }
+        for (size_t i = 0; i < frames; i += 3) {
+            rnnoise_process_frames(multiple, &multipleOutput[i * frameSize], &input[i * frameSize], &multipleVad[i],
+                                   3);
+        }
+        for (DenoiseState *state: {batched[0], batched[1], multiple, normalized}) {
+            rnnoise_destroy(state);
+        }
+
+        bool batchMatches = true, normalizedMatches = true;
+        for (size_t i = 0; i < frames; i++) {
+            batchMatches &= batchedVad[2 * i] == vad[i] && batchedVad[2 * i + 1] == vad[i];
+            normalizedMatches &= normalizedVad[i] == vad[i];
+        }
+        for (size_t j = 0; j < output.size(); j++) {
+            batchMatches &= batchedOutput[j] == output[j] && batchedOutput[output.size() + j] == output[j];
+            normalizedMatches &= normalizedOutput[j] == output[j] / scale;
+        }
+        REQUIRE(batchMatches);
+        REQUIRE(multipleOutput == output);
+        REQUIRE(multipleVad == vad);
+        REQUIRE(normalizedMatches);
+
+        outputs.push_back(std::move(output));
+        vads.push_back(std::move(vad));
+    }
+
+    /* The SIMD paths only differ in the rounding of their sums. */
+    for (int arch = 1; arch <= maxArch; arch++) {
+        CAPTURE(archNames[arch]);
+        float maxVadDifference = 0;
+        double outputEnergy = 0, differenceEnergy = 0;
+        for (size_t i = 0; i < frames; i++) {
+            maxVadDifference = std::max(maxVadDifference, std::abs(vads[0][i] - vads[arch][i]));
+        }
+        for (size_t j = 0; j < outputs[0].size(); j++) {
+            outputEnergy += outputs[0][j] * static_cast<double>(outputs[0][j]);
+            const double difference = outputs[0][j] - static_cast<double>(outputs[arch][j]);
+            differenceEnergy += difference * difference;
+        }
+        const double snr = 10 * std::log10(outputEnergy / std::max(differenceEnergy, 1e-9));
+        CAPTURE(maxVadDifference, snr);
+        REQUIRE(maxVadDifference < 1e-3f);
+        REQUIRE(snr > 90);
+    }
+}
@@ -2,6 +2,10 @@
 #include "RnNoisePluginEditor.h"
 
 #include "common/RnNoiseCommonPlugin.h"
+#include "common/RnNoiseModelCache.h"
+
+/* Not a parameter, hosts can't automate a file. */
+static const juce::Identifier k_modelPathProperty("model_path");
 
 //==============================================================================
 RnNoiseAudioProcessor::RnNoiseAudioProcessor()
@@ -75,13 +79,61 @@ void RnNoiseAudioProcessor::changeProgramName(int index, const juce::String &new
 
 //==============================================================================
 void RnNoiseAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock) {
-    juce::ignoreUnused(sampleRate, samplesPerBlock);
+    juce::ignoreUnused(sampleRate);
+
+    auto channels = static_cast<uint32_t>(getTotalNumInputChannels());
+    std::lock_guard<std::mutex> lock(m_pluginMutex);
+    /* The bus is mono or stereo, which get the specialized plugin. */
+    m_rnNoisePlugin = RnNoiseCommonPlugin::create(channels, static_cast<size_t>(std::max(samplesPerBlock, 0)));
+    m_rnNoisePlugin->setHostBlockFrames(static_cast<size_t>(std::max(samplesPerBlock, 0)));
+    m_rnNoisePlugin->setModelPath(getModelPath().toStdString());
+
+    m_inputChannels.assign(channels, nullptr);
+    m_outputChannels.assign(channels, nullptr);
+
+    m_offlineMaxBlockFrames = static_cast<size_t>(std::max(samplesPerBlock, 1));
+    prepareProcessingMode(isNonRealtime());
+}
 
-    m_rnNoisePlugin = std::make_shared<RnNoiseCommonPlugin>(static_cast<uint32_t>(getTotalNumInputChannels()));
+void RnNoiseAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept {
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    updateProcessingMode();
+}
+
+void RnNoiseAudioProcessor::prepareProcessingMode(bool offline) {
     m_rnNoisePlugin->init();
+
+    /* Renders take the bulk path, its output is delayed by the worst case latency for any block
+     * sizes, so the host can compensate it exactly even if the block size varies. The tail of a
+     * render only comes out if the host renders that latency past its end.
+     */
+    m_offline = offline;
+    m_offlineQueues.clear();
+    m_offlineQueueFrames = 0;
+    if (m_offline) {
+        auto retroactiveVADGraceBlocks = static_cast<uint32_t>(m_vadRetroactiveGracePeriodParam->get());
+        m_latencyRetroactiveVADGraceBlocks = retroactiveVADGraceBlocks;
+        m_offlineQueueFrames = RnNoiseCommonPlugin::computeLatencyFrames(k_anyBlockFrames, retroactiveVADGraceBlocks);
+        m_offlineQueues.assign(m_inputChannels.size(),
+                               std::vector<float>(m_offlineQueueFrames + m_offlineMaxBlockFrames, 0.f));
+        setLatencySamples(static_cast<int>(m_offlineQueueFrames));
+    } else {
+        updateLatency(static_cast<uint32_t>(m_vadRetroactiveGracePeriodParam->get()));
+    }
+}
+
+void RnNoiseAudioProcessor::updateProcessingMode() {
+    /* Some wrappers switch on the audio thread right before processing, so the lock is only tried,
+     * processBlock() tries again while the mode is behind.
+     */
+    std::unique_lock<std::mutex> lock(m_pluginMutex, std::try_to_lock);
+    if (lock.owns_lock() && m_rnNoisePlugin && isNonRealtime() != m_offline) {
+        prepareProcessingMode(isNonRealtime());
+    }
 }
 
 void RnNoiseAudioProcessor::releaseResources() {
+    std::lock_guard<std::mutex> lock(m_pluginMutex);
     m_rnNoisePlugin.reset();
 }
 
@@ -115,16 +167,64 @@ void RnNoiseAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    const float *in[8] = {nullptr};
-    float *out[8] = {nullptr};
-    for (int channel = 0; channel < totalNumInputChannels; ++channel) {
-        in[channel] = buffer.getReadPointer(channel);
-        out[channel] = buffer.getWritePointer(channel);
+    for (size_t channel = 0; channel < m_inputChannels.size(); ++channel) {
+        m_inputChannels[channel] = buffer.getReadPointer(static_cast<int>(channel));
+        m_outputChannels[channel] = buffer.getWritePointer(static_cast<int>(channel));
+    }
+
+    if (isNonRealtime() != m_offline) {
+        updateProcessingMode();
+    }
+
+    auto retroactiveVADGraceBlocks = static_cast<uint32_t>(m_vadRetroactiveGracePeriodParam->get());
+
+    if (m_offline) {
+        processOfflineBlock(buffer, retroactiveVADGraceBlocks);
+        return;
+    }
+
+    if (retroactiveVADGraceBlocks != m_latencyRetroactiveVADGraceBlocks) {
+        updateLatency(retroactiveVADGraceBlocks);
     }
 
-    m_rnNoisePlugin->process(in, out, static_cast<size_t>(buffer.getNumSamples()), m_vadThresholdParam->get(),
+    m_rnNoisePlugin->process(m_inputChannels.data(), m_outputChannels.data(), static_cast<size_t>(buffer.getNumSamples()), m_vadThresholdParam->get(),
                              static_cast<uint32_t>(m_vadGracePeriodParam->get()),
-                             static_cast<uint32_t>(m_vadRetroactiveGracePeriodParam->get()));
+                             retroactiveVADGraceBlocks);
+}
+
+void RnNoiseAudioProcessor::processOfflineBlock(juce::AudioBuffer<float> &buffer, uint32_t retroactiveVADGraceBlocks) {
+    auto numSamples = static_cast<size_t>(buffer.getNumSamples());
+    for (size_t blockOffset = 0; blockOffset < numSamples; blockOffset += m_offlineMaxBlockFrames) {
+        size_t blockFrames = std::min(m_offlineMaxBlockFrames, numSamples - blockOffset);
+
+        /* Aligned output is appended to the queues which start with the reported latency of silence. */
+        size_t queuedFrames = m_offlineQueueFrames;
+        for (size_t channel = 0; channel < m_inputChannels.size(); ++channel) {
+            m_inputChannels[channel] = buffer.getReadPointer(static_cast<int>(channel), static_cast<int>(blockOffset));
+            m_outputChannels[channel] = m_offlineQueues[channel].data() + queuedFrames;
+        }
+        queuedFrames += m_rnNoisePlugin->processOffline(m_inputChannels.data(), m_outputChannels.data(), blockFrames,
+                                                        m_vadThresholdParam->get(),
+                                                        static_cast<uint32_t>(m_vadGracePeriodParam->get()),
+                                                        retroactiveVADGraceBlocks);
+
+        /* Only a bigger retroactive grace than the one the latency was reported for can run the queue dry. */
+        size_t framesFromQueue = std::min(queuedFrames, blockFrames);
+        for (size_t channel = 0; channel < m_offlineQueues.size(); ++channel) {
+            auto &queue = m_offlineQueues[channel];
+            float *channelOut = buffer.getWritePointer(static_cast<int>(channel), static_cast<int>(blockOffset));
+            std::copy(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(framesFromQueue), channelOut);
+            std::fill(channelOut + framesFromQueue, channelOut + blockFrames, 0.f);
+            std::copy(queue.begin() + static_cast<std::ptrdiff_t>(framesFromQueue),
+                      queue.begin() + static_cast<std::ptrdiff_t>(queuedFrames), queue.begin());
+        }
+        m_offlineQueueFrames = queuedFrames - framesFromQueue;
+    }
+}
+
+void RnNoiseAudioProcessor::updateLatency(uint32_t retroactiveVADGraceBlocks) {
+    m_latencyRetroactiveVADGraceBlocks = retroactiveVADGraceBlocks;
+    setLatencySamples(static_cast<int>(m_rnNoisePlugin->getLatencyFrames(retroactiveVADGraceBlocks)));
 }
 
 //==============================================================================
@@ -149,9 +249,30 @@ void RnNoiseAudioProcessor::setStateInformation(const void *data, int sizeInByte
     if (!xml || !xml->hasTagName(m_parameters.state.getType()))
         return;
 
+    /* Hosts restore the state from any thread, so the model is only loaded by the next prepareToPlay(). */
+    std::lock_guard<std::mutex> lock(m_pluginMutex);
     m_parameters.replaceState(juce::ValueTree::fromXml(*xml));
 }
 
+bool RnNoiseAudioProcessor::setModelPath(const juce::String &path) {
+    std::lock_guard<std::mutex> lock(m_pluginMutex);
+    /* Without a prepared plugin the model is loaded by prepareToPlay(), here it's only checked. */
+    if (m_rnNoisePlugin) {
+        if (!m_rnNoisePlugin->setModelPath(path.toStdString())) {
+            return false;
+        }
+    } else if (path.isNotEmpty() && !RnNoiseModelCache::acquire(path.toStdString())) {
+        return false;
+    }
+
+    m_parameters.state.setProperty(k_modelPathProperty, path, nullptr);
+    return true;
+}
+
+juce::String RnNoiseAudioProcessor::getModelPath() const {
+    return m_parameters.state.getProperty(k_modelPathProperty).toString();
+}
+
 //==============================================================================
 // This creates new instances of the plugin..
 juce::AudioProcessor *JUCE_CALLTYPE createPluginFilter() {
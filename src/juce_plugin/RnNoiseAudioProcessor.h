@@ -2,6 +2,8 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 
+#include <mutex>
+
 class RnNoiseCommonPlugin;
 
 class RnNoiseAudioProcessor : public juce::AudioProcessor {
@@ -14,6 +16,9 @@ public:
 
     void releaseResources() override;
 
+    /* Switches between the realtime and the offline path of a prepared plugin, see m_offline. */
+    void setNonRealtime(bool isNonRealtime) noexcept override;
+
     bool isBusesLayoutSupported(const BusesLayout &layouts) const override;
 
     void processBlock(juce::AudioBuffer<float> &, juce::MidiBuffer &) override;
@@ -44,6 +49,32 @@ public:
 
     void setStateInformation(const void *data, int sizeInBytes) override;
 
+    /**
+     * Loads the rnnoise model in the file, or the built-in one for an empty path, and hands it to
+     * the running plugin without blocking the audio thread. The path is saved with the state,
+     * a restored state's model is loaded by the next prepareToPlay(). Message thread only.
+     * @return false if the model can't be loaded, the current one is kept then.
+     */
+    bool setModelPath(const juce::String &path);
+
+    juce::String getModelPath() const;
+
+private:
+    /* Reports the latency planned for the prepared block size to the host. */
+    void updateLatency(uint32_t retroactiveVADGraceBlocks);
+
+    /* Starts a new stream on the realtime or the offline path, m_pluginMutex must be held. */
+    void prepareProcessingMode(bool offline);
+
+    /* prepareProcessingMode() for isNonRealtime() unless the plugin already runs in that mode. */
+    void updateProcessingMode();
+
+    /* Non-realtime rendering through RnNoiseCommonPlugin::processOffline(). */
+    void processOfflineBlock(juce::AudioBuffer<float> &buffer, uint32_t retroactiveVADGraceBlocks);
+
+    /* Hosts may pass any block sizes when rendering, planning for single frames covers them all. */
+    static const size_t k_anyBlockFrames = 1;
+
 public:
 
     juce::AudioProcessorValueTreeState m_parameters;
@@ -54,5 +85,27 @@ public:
 
     std::shared_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
 
+    /* Held by prepareToPlay() and releaseResources() while they replace m_rnNoisePlugin, by
+     * setModelPath() while it uses it, so a model is never loaded into a plugin being replaced
+     * or initialized, and by the editor to take its reference. Also orders the model path in the
+     * state. processBlock() and setNonRealtime() only try it.
+     */
+    std::mutex m_pluginMutex;
+
+    /* Channel pointers passed to m_rnNoisePlugin, sized in prepareToPlay(). */
+    std::vector<const float *> m_inputChannels;
+    std::vector<float *> m_outputChannels;
+
+    /* Retroactive grace period the reported latency was computed for. */
+    uint32_t m_latencyRetroactiveVADGraceBlocks = 0;
+
+    /* Whether the plugin was prepared for a non-realtime render. The queues delay the aligned
+     * output of processOffline() by the reported latency.
+     */
+    bool m_offline = false;
+    std::vector<std::vector<float>> m_offlineQueues;
+    size_t m_offlineQueueFrames = 0;
+    size_t m_offlineMaxBlockFrames = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RnNoiseAudioProcessor)
 };
\ No newline at end of file
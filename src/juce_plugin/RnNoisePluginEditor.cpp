@@ -41,6 +41,16 @@ RnNoiseAudioProcessorEditor::RnNoiseAudioProcessorEditor(RnNoiseAudioProcessor &
                                                                                vadRetroactiveGracePeriodParam->getParameterID(),
                                                                                m_vadRetroactiveGracePeriodSlider);
 
+    addAndMakeVisible(m_modelButton);
+    m_modelButton.onClick = [this] { chooseModel(); };
+    addAndMakeVisible(m_builtInModelButton);
+    m_builtInModelButton.setButtonText("Use the built-in model");
+    m_builtInModelButton.onClick = [this] {
+        m_processorRef.setModelPath({});
+        updateModelButton();
+    };
+    updateModelButton();
+
     addAndMakeVisible(m_statsHeaderLabel);
     m_statsHeaderLabel.setText("Debug Statistics (updated once per second)", juce::dontSendNotification);
     m_statsHeaderLabel.setFont(juce::Font(20.0f, juce::Font::bold));
@@ -51,7 +61,32 @@ RnNoiseAudioProcessorEditor::RnNoiseAudioProcessorEditor(RnNoiseAudioProcessor &
     addAndMakeVisible(m_statsBlocksWaitingForOutputLabel);
     addAndMakeVisible(m_statsOutputFramesForcedToBeZeroedLabel);
 
-    setSize(400, 400);
+    setSize(400, 460);
+}
+
+void RnNoiseAudioProcessorEditor::chooseModel() {
+    juce::File current(m_processorRef.getModelPath());
+    m_modelChooser = std::make_unique<juce::FileChooser>("Choose an rnnoise model", current, "*");
+    auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    m_modelChooser->launchAsync(flags, [this](const juce::FileChooser &chooser) {
+        juce::File file = chooser.getResult();
+        if (file == juce::File()) {
+            return;
+        }
+
+        if (!m_processorRef.setModelPath(file.getFullPathName())) {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Model not loaded",
+                                                   file.getFullPathName() + " is not a valid rnnoise model.");
+        }
+        updateModelButton();
+    });
+}
+
+void RnNoiseAudioProcessorEditor::updateModelButton() {
+    juce::String path = m_processorRef.getModelPath();
+    m_modelButton.setButtonText("Model: " + (path.isEmpty() ? juce::String("built-in") : juce::File(path).getFileName()));
+    m_modelButton.setTooltip(path);
+    m_builtInModelButton.setEnabled(path.isNotEmpty());
 }
 
 void RnNoiseAudioProcessorEditor::paint(juce::Graphics &g) {
@@ -78,6 +113,9 @@ void RnNoiseAudioProcessorEditor::resized() {
     flexBox.items.add(
             juce::FlexItem(m_vadRetroactiveGracePeriodSlider).withWidth(width).withFlex(1.0));
 
+    flexBox.items.add(juce::FlexItem(m_modelButton).withWidth(width).withFlex(1.0));
+    flexBox.items.add(juce::FlexItem(m_builtInModelButton).withWidth(width).withFlex(1.0));
+
     flexBox.items.add(
             juce::FlexItem(m_statsHeaderLabel).withWidth(width).withFlex(1.0));
     flexBox.items.add(
@@ -102,13 +140,23 @@ void RnNoiseAudioProcessorEditor::visibilityChanged() {
 }
 
 void RnNoiseAudioProcessorEditor::timerCallback() {
-    auto plugin = m_processorRef.m_rnNoisePlugin;
+    std::shared_ptr<RnNoiseCommonPlugin> plugin;
+    {
+        std::lock_guard<std::mutex> lock(m_processorRef.m_pluginMutex);
+        plugin = m_processorRef.m_rnNoisePlugin;
+    }
 
     if (!plugin)
         return;
 
-    RnNoiseStats stats = plugin->getStats();
-    m_processorRef.m_rnNoisePlugin->resetStats();
+    /* Counters only grow, show what happened since the last update. */
+    RnNoiseStats totalStats = plugin->getStats();
+    if (plugin.get() != m_statsPlugin) {
+        m_statsPlugin = plugin.get();
+        m_lastStats = {};
+    }
+    RnNoiseStats stats = totalStats.since(m_lastStats);
+    m_lastStats = totalStats;
 
     juce::String statsVadGraceBlocksStr = juce::String("Unmuted via VAD: ");
     statsVadGraceBlocksStr << (int) stats.vadGraceBlocks * 10 << " ms";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RnNoiseAudioProcessor.h"
+#include "common/RnNoiseCommonPlugin.h"
 
 //==============================================================================
 class RnNoiseAudioProcessorEditor : public juce::AudioProcessorEditor, public juce::Timer {
@@ -37,12 +38,25 @@ private:
     juce::Slider m_vadRetroactiveGracePeriodSlider;
     std::unique_ptr<SliderAttachment> m_vadRetroactiveGracePeriodAttachment;
 
+    /* Shows the model in use, a click picks a file. */
+    juce::TextButton m_modelButton;
+    juce::TextButton m_builtInModelButton;
+    std::unique_ptr<juce::FileChooser> m_modelChooser;
+
+    void chooseModel();
+
+    void updateModelButton();
+
     juce::Label m_statsHeaderLabel;
     juce::Label m_statsVadGraceBlocksLabel;
     juce::Label m_statsRetroactiveVadGraceBlocksLabel;
     juce::Label m_statsBlocksWaitingForOutputLabel;
     juce::Label m_statsOutputFramesForcedToBeZeroedLabel;
 
+    /* Snapshot of the last timer update and the plugin instance it was taken from. */
+    RnNoiseStats m_lastStats{};
+    const RnNoiseCommonPlugin *m_statsPlugin = nullptr;
+
     RnNoiseAudioProcessor &m_processorRef;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RnNoiseAudioProcessorEditor)
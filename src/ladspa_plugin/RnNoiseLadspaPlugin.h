@@ -3,6 +3,8 @@
 #include "ladspa++.h"
 #include "common/RnNoiseCommonPlugin.h"
 
+#include <cstdlib>
+
 using namespace ladspa;
 
 namespace port_info_custom {
@@ -45,6 +47,36 @@ namespace port_info_custom {
             port_types::input | port_types::control,
             {0, 0.f, 0.f}
     };
+    /* Hosts recognize the latency output port by its name. */
+    constexpr static port_info_t latency_output = {
+            "latency",
+            "Delay of the output in samples, hosts use it to compensate the latency.",
+            port_types::output | port_types::control,
+            {0, 0.f, 0.f}
+    };
+}
+
+/*
+ * LADSPA doesn't tell the block size up front, so the latency is planned for the size of the
+ * first block. Hosts usually keep it, otherwise the plugin falls back to waiting for frames.
+ */
+inline void plan_latency(RnNoiseCommonPlugin &plugin, bool &planned, size_t sample_count) {
+    if (!planned) {
+        plugin.setHostBlockFrames(sample_count);
+        planned = true;
+    }
+}
+
+/*
+ * LADSPA has no string controls, so a custom model is picked with the RNNOISE_MODEL environment
+ * variable. Instances of a process using the same file share the model. Falls back to the
+ * built-in model if the file can't be loaded.
+ */
+inline void load_model(RnNoiseCommonPlugin &plugin) {
+    const char *path = std::getenv("RNNOISE_MODEL");
+    if (path != nullptr && path[0] != '\0') {
+        plugin.setModelPath(path);
+    }
 }
 
 struct RnNoiseMono {
@@ -56,6 +88,7 @@ struct RnNoiseMono {
         in_retroactive_vad_grace_blocks,
         in_placeholder1,
         in_placeholder2,
+        out_latency,
         size
     };
 
@@ -68,6 +101,7 @@ struct RnNoiseMono {
                     port_info_custom::retroactive_vad_grace_blocks_input,
                     port_info_custom::placeholder_input,
                     port_info_custom::placeholder_input,
+                    port_info_custom::latency_output,
                     port_info_common::final_port
             };
 
@@ -85,7 +119,8 @@ struct RnNoiseMono {
             };
 
     explicit RnNoiseMono(sample_rate_t _sample_rate) {
-        m_rnNoisePlugin = std::make_unique<RnNoiseCommonPlugin>(1);
+        m_rnNoisePlugin = RnNoiseCommonPlugin::create(1);
+        load_model(*m_rnNoisePlugin);
         m_rnNoisePlugin->init();
     }
 
@@ -107,11 +142,16 @@ struct RnNoiseMono {
         const float *input[] = {in_buffer.data()};
         float *output[] = {out_buffer.data()};
 
+        plan_latency(*m_rnNoisePlugin, m_hostBlockPlanned, in_buffer.size());
         m_rnNoisePlugin->process(input, output, in_buffer.size(), vad_threshold_normalized,
                                  vad_grace_period_blocks, retroactive_vad_grace_blocks);
+
+        pointer latency = ports.get<port_names::out_latency>();
+        static_cast<data &>(latency) = static_cast<data>(m_rnNoisePlugin->getLatencyFrames(retroactive_vad_grace_blocks));
     }
 
     std::unique_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
+    mutable bool m_hostBlockPlanned = false;
 };
 
 struct RnNoiseStereo {
@@ -125,6 +165,7 @@ struct RnNoiseStereo {
         in_retroactive_vad_grace_blocks,
         in_placeholder1,
         in_placeholder2,
+        out_latency,
         size
     };
 
@@ -139,6 +180,7 @@ struct RnNoiseStereo {
                     port_info_custom::retroactive_vad_grace_blocks_input,
                     port_info_custom::placeholder_input,
                     port_info_custom::placeholder_input,
+                    port_info_custom::latency_output,
                     port_info_common::final_port
             };
 
@@ -156,7 +198,8 @@ struct RnNoiseStereo {
             };
 
     explicit RnNoiseStereo(sample_rate_t _sample_rate) {
-        m_rnNoisePlugin = std::make_unique<RnNoiseCommonPlugin>(2);
+        m_rnNoisePlugin = RnNoiseCommonPlugin::create(2);
+        load_model(*m_rnNoisePlugin);
         m_rnNoisePlugin->init();
     }
 
@@ -182,11 +225,16 @@ struct RnNoiseStereo {
         const float *input[] = {in_buffer_l.data(), in_buffer_r.data()};
         float *output[] = {out_buffer_l.data(), out_buffer_r.data()};
 
+        plan_latency(*m_rnNoisePlugin, m_hostBlockPlanned, in_buffer_l.size());
         m_rnNoisePlugin->process(input, output, in_buffer_l.size(), vad_threshold_normalized,
                                  vad_grace_period_blocks, retroactive_vad_grace_blocks);
+
+        pointer latency = ports.get<port_names::out_latency>();
+        static_cast<data &>(latency) = static_cast<data>(m_rnNoisePlugin->getLatencyFrames(retroactive_vad_grace_blocks));
     }
 
     std::unique_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
+    mutable bool m_hostBlockPlanned = false;
 };
 
 /*
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct DenoiseState;
+
+struct RnNoiseStreamStats {
+    /* VAD probability of the last denoised frame. */
+    float vadProbability;
+
+    /* Frames pushed but not denoised yet. */
+    uint32_t pendingFrames;
+    /* Denoised frames waiting to be popped. */
+    uint32_t readyFrames;
+
+    /* Time between push and the end of denoising of the last denoised frame. */
+    std::chrono::microseconds lastFrameLatency;
+    /* (Accumulative) The highest latency of a single frame. */
+    std::chrono::microseconds maxFrameLatency;
+
+    /* (Accumulative) */
+    uint64_t processedFrames;
+    /* (Accumulative) How many frames were denoised after their deadline. */
+    uint64_t missedDeadlines;
+    /* (Accumulative) How many frames were rejected because the input queue was full. */
+    uint64_t rejectedFrames;
+};
+
+/**
+ * Denoises many independent mono streams on a shared worker pool.
+ *
+ * Producers push 10 ms frames to a stream, workers pick streams with ready frames in the
+ * order of their deadlines and denoise frames of different streams together, so all of them
+ * share the RNN weight loads. Each worker has its own queue of ready streams and steals from
+ * the others when it runs out of work or when another queue holds an overdue stream.
+ */
+class RnNoiseMultiStreamEngine {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static const size_t k_frameSize = 480;
+    static const uint32_t k_sampleRate = 48000;
+
+    struct Config {
+        /* 0 means frames are only processed by processBatch() on the caller's thread. */
+        uint32_t workers = 1;
+        /* How many streams are denoised together. Their states have to fit in the cache
+         * for the batching to pay off.
+         */
+        uint32_t maxBatchStreams = 8;
+        /* Capacity of each stream's input and output queues, in frames. */
+        uint32_t streamQueueFrames = 8;
+        /* Deadline of a pushed frame relative to the time it was pushed. */
+        std::chrono::microseconds frameDeadline{10000};
+    };
+
+    class Stream;
+
+    RnNoiseMultiStreamEngine();
+
+    explicit RnNoiseMultiStreamEngine(const Config &config);
+
+    /* Stops the workers, streams must not be used afterwards. */
+    ~RnNoiseMultiStreamEngine();
+
+    RnNoiseMultiStreamEngine(const RnNoiseMultiStreamEngine &) = delete;
+
+    RnNoiseMultiStreamEngine &operator=(const RnNoiseMultiStreamEngine &) = delete;
+
+    /* Not real-time safe. The stream is destroyed when the last reference is released. */
+    std::shared_ptr<Stream> createStream();
+
+    /**
+     * Denoises one batch of ready frames on the calling thread.
+     * @return The amount of frames denoised, 0 if there was nothing to do.
+     */
+    size_t processBatch();
+
+private:
+    friend class Stream;
+
+    struct QueueEntry {
+        Clock::time_point deadline;
+        std::shared_ptr<Stream> stream;
+    };
+
+    /* Ready streams ordered by the deadline of their oldest pending frame. */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::vector<QueueEntry> heap;
+        /* Deadline of the heap top, so that other workers can look at it without locking. */
+        std::atomic<Clock::rep> earliestDeadline;
+    };
+
+    /* Scratch space of one worker, preallocated for maxBatchStreams streams. */
+    struct Batch {
+        std::vector<QueueEntry> entries;
+        std::vector<DenoiseState *> states;
+        std::vector<const float *> inputs;
+        std::vector<float *> outputs;
+        std::vector<float> vadProbabilities;
+    };
+
+    void initBatch(Batch &batch) const;
+
+    void workerLoop(size_t queueIdx);
+
+    size_t processBatch(size_t queueIdx, Batch &batch);
+
+    size_t pickQueue(size_t ownQueueIdx) const;
+
+    void schedule(const std::shared_ptr<Stream> &stream);
+
+    static bool compareDeadlines(const QueueEntry &a, const QueueEntry &b) {
+        return a.deadline > b.deadline;
+    }
+
+private:
+    Config m_config;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::atomic<size_t> m_queuedStreams{0};
+    std::atomic<size_t> m_nextStreamQueue{0};
+    std::atomic<size_t> m_streamCount{0};
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    std::atomic<uint32_t> m_sleepingWorkers{0};
+    bool m_stopping = false;
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_callerBatchMutex;
+    Batch m_callerBatch;
+};
+
+/**
+ * A single mono stream. pushFrame() may be called by one producer thread and popFrame() by
+ * one consumer thread concurrently. Neither of them allocates or waits for denoising, but the
+ * call which makes the stream ready hands it to a worker under short locks: the mutex of the
+ * stream's work queue for a heap push, and the workers' sleep mutex if one of them is parked.
+ * Both are only ever held for a few instructions, still they are locks, so a real-time thread
+ * may wait for another thread holding one of them.
+ */
+class RnNoiseMultiStreamEngine::Stream : public std::enable_shared_from_this<Stream> {
+public:
+    ~Stream();
+
+    /**
+     * @param frame k_frameSize samples in the [-1, 1] range.
+     * @return false if the input queue is full and the frame was dropped.
+     */
+    bool pushFrame(const float *frame);
+
+    bool pushFrame(const float *frame, Clock::time_point deadline);
+
+    /**
+     * @param frame Receives k_frameSize denoised samples.
+     * @param vadProbability Optional, receives the VAD probability of the frame.
+     * @return false if there is no denoised frame yet.
+     */
+    bool popFrame(float *frame, float *vadProbability = nullptr);
+
+    RnNoiseStreamStats getStats() const;
+
+private:
+    friend class RnNoiseMultiStreamEngine;
+
+    Stream(RnNoiseMultiStreamEngine &engine, size_t queueIdx);
+
+    bool isReady() const;
+
+    void trySchedule();
+
+    float *inputFrame(uint64_t idx) {
+        return &m_inputFrames[(idx % m_capacity) * k_frameSize];
+    }
+
+    float *outputFrame(uint64_t idx) {
+        return &m_outputFrames[(idx % m_capacity) * k_frameSize];
+    }
+
+private:
+    RnNoiseMultiStreamEngine &m_engine;
+    size_t m_queueIdx;
+    size_t m_capacity;
+
+    std::unique_ptr<DenoiseState, void (*)(DenoiseState *)> m_denoiseState;
+
+    /* Whether the stream is in a work queue or being denoised. Guarantees that only one
+     * worker touches the denoise state at a time.
+     */
+    std::atomic<bool> m_scheduled{false};
+
+    /* Input queue, written by the producer. */
+    std::vector<float> m_inputFrames;
+    std::vector<Clock::time_point> m_inputPushTimes;
+    std::vector<Clock::time_point> m_inputDeadlines;
+    std::atomic<uint64_t> m_inputWriteIdx{0};
+    std::atomic<uint64_t> m_inputReadIdx{0};
+
+    /* Output queue, written by the worker. */
+    std::vector<float> m_outputFrames;
+    std::vector<float> m_outputVadProbabilities;
+    std::atomic<uint64_t> m_outputWriteIdx{0};
+    std::atomic<uint64_t> m_outputReadIdx{0};
+
+    std::atomic<float> m_vadProbability{0.f};
+    std::atomic<int64_t> m_lastFrameLatencyUs{0};
+    std::atomic<int64_t> m_maxFrameLatencyUs{0};
+    std::atomic<uint64_t> m_missedDeadlines{0};
+    std::atomic<uint64_t> m_rejectedFrames{0};
+};
@@ -0,0 +1,281 @@
+#include "multistream/RnNoiseMultiStreamEngine.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <rnnoise.h>
+
+const size_t RnNoiseMultiStreamEngine::k_frameSize;
+
+static const RnNoiseMultiStreamEngine::Clock::rep k_noDeadline =
+        std::numeric_limits<RnNoiseMultiStreamEngine::Clock::rep>::max();
+
+RnNoiseMultiStreamEngine::RnNoiseMultiStreamEngine() : RnNoiseMultiStreamEngine(Config()) {}
+
+RnNoiseMultiStreamEngine::RnNoiseMultiStreamEngine(const Config &config) : m_config(config) {
+    m_config.maxBatchStreams = std::max<uint32_t>(m_config.maxBatchStreams, 1);
+    m_config.streamQueueFrames = std::max<uint32_t>(m_config.streamQueueFrames, 1);
+
+    /* The caller of processBatch() uses the first queue when there are no workers. */
+    size_t queueCount = std::max<size_t>(m_config.workers, 1);
+    for (size_t i = 0; i < queueCount; i++) {
+        m_queues.emplace_back(new WorkQueue());
+        m_queues.back()->earliestDeadline = k_noDeadline;
+    }
+
+    initBatch(m_callerBatch);
+
+    for (uint32_t i = 0; i < m_config.workers; i++) {
+        m_workers.emplace_back(&RnNoiseMultiStreamEngine::workerLoop, this, i);
+    }
+}
+
+RnNoiseMultiStreamEngine::~RnNoiseMultiStreamEngine() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_sleepCondition.notify_all();
+
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+
+    /* Queued streams reference the engine, release them while it is still alive. */
+    for (auto &queue: m_queues) {
+        queue->heap.clear();
+    }
+}
+
+std::shared_ptr<RnNoiseMultiStreamEngine::Stream> RnNoiseMultiStreamEngine::createStream() {
+    size_t queueIdx = m_nextStreamQueue++ % m_queues.size();
+    std::shared_ptr<Stream> stream(new Stream(*this, queueIdx));
+
+    /* A stream is in at most one queue at a time, so queues never have to grow while scheduling. */
+    size_t streamCount = ++m_streamCount;
+    for (auto &queue: m_queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->heap.reserve(streamCount);
+    }
+
+    return stream;
+}
+
+size_t RnNoiseMultiStreamEngine::processBatch() {
+    std::lock_guard<std::mutex> lock(m_callerBatchMutex);
+    return processBatch(0, m_callerBatch);
+}
+
+void RnNoiseMultiStreamEngine::initBatch(Batch &batch) const {
+    batch.entries.reserve(m_config.maxBatchStreams);
+    batch.states.resize(m_config.maxBatchStreams);
+    batch.inputs.resize(m_config.maxBatchStreams);
+    batch.outputs.resize(m_config.maxBatchStreams);
+    batch.vadProbabilities.resize(m_config.maxBatchStreams);
+}
+
+void RnNoiseMultiStreamEngine::workerLoop(size_t queueIdx) {
+    Batch batch;
+    initBatch(batch);
+
+    while (true) {
+        if (processBatch(queueIdx, batch) > 0) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkers++;
+        m_sleepCondition.wait(lock, [this] { return m_stopping || m_queuedStreams > 0; });
+        m_sleepingWorkers--;
+        if (m_stopping) {
+            return;
+        }
+    }
+}
+
+size_t RnNoiseMultiStreamEngine::pickQueue(size_t ownQueueIdx) const {
+    /* Own queue first, unless another queue holds an overdue stream which is due earlier.
+     * Empty own queue means stealing from the queue with the earliest deadline.
+     */
+    Clock::rep ownDeadline = m_queues[ownQueueIdx]->earliestDeadline;
+    Clock::rep now = Clock::now().time_since_epoch().count();
+
+    size_t victimIdx = ownQueueIdx;
+    Clock::rep victimDeadline = k_noDeadline;
+    for (size_t i = 1; i < m_queues.size(); i++) {
+        size_t idx = (ownQueueIdx + i) % m_queues.size();
+        Clock::rep deadline = m_queues[idx]->earliestDeadline;
+        if (deadline < victimDeadline) {
+            victimIdx = idx;
+            victimDeadline = deadline;
+        }
+    }
+
+    if (ownDeadline == k_noDeadline) {
+        return victimIdx;
+    }
+    if (victimDeadline < now && victimDeadline < ownDeadline) {
+        return victimIdx;
+    }
+    return ownQueueIdx;
+}
+
+size_t RnNoiseMultiStreamEngine::processBatch(size_t queueIdx, Batch &batch) {
+    WorkQueue &queue = *m_queues[pickQueue(queueIdx)];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        while (!queue.heap.empty() && batch.entries.size() < m_config.maxBatchStreams) {
+            std::pop_heap(queue.heap.begin(), queue.heap.end(), compareDeadlines);
+            batch.entries.push_back(std::move(queue.heap.back()));
+            queue.heap.pop_back();
+        }
+        queue.earliestDeadline = queue.heap.empty() ? k_noDeadline
+                                                    : queue.heap.front().deadline.time_since_epoch().count();
+        m_queuedStreams -= batch.entries.size();
+    }
+
+    size_t count = batch.entries.size();
+    if (count == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Stream &stream = *batch.entries[i].stream;
+        batch.states[i] = stream.m_denoiseState.get();
+        batch.inputs[i] = stream.inputFrame(stream.m_inputReadIdx);
+        batch.outputs[i] = stream.outputFrame(stream.m_outputWriteIdx);
+    }
+
+    rnnoise_process_frame_batch_normalized(batch.states.data(), batch.outputs.data(), batch.inputs.data(),
+                                           batch.vadProbabilities.data(), static_cast<int>(count));
+
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        Stream &stream = *batch.entries[i].stream;
+
+        uint64_t inputIdx = stream.m_inputReadIdx;
+        size_t inputSlot = static_cast<size_t>(inputIdx % stream.m_capacity);
+        auto latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                now - stream.m_inputPushTimes[inputSlot]).count();
+        stream.m_lastFrameLatencyUs = latencyUs;
+        if (latencyUs > stream.m_maxFrameLatencyUs) {
+            stream.m_maxFrameLatencyUs = latencyUs;
+        }
+        if (now > stream.m_inputDeadlines[inputSlot]) {
+            stream.m_missedDeadlines++;
+        }
+
+        uint64_t outputIdx = stream.m_outputWriteIdx;
+        stream.m_outputVadProbabilities[static_cast<size_t>(outputIdx % stream.m_capacity)] = batch.vadProbabilities[i];
+        stream.m_vadProbability = batch.vadProbabilities[i];
+
+        stream.m_inputReadIdx = inputIdx + 1;
+        stream.m_outputWriteIdx = outputIdx + 1;
+
+        stream.m_scheduled = false;
+        stream.trySchedule();
+    }
+
+    batch.entries.clear();
+    return count;
+}
+
+void RnNoiseMultiStreamEngine::schedule(const std::shared_ptr<Stream> &stream) {
+    size_t slot = static_cast<size_t>(stream->m_inputReadIdx % stream->m_capacity);
+    Clock::time_point deadline = stream->m_inputDeadlines[slot];
+
+    WorkQueue &queue = *m_queues[stream->m_queueIdx];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.heap.push_back(QueueEntry{deadline, stream});
+        std::push_heap(queue.heap.begin(), queue.heap.end(), compareDeadlines);
+        queue.earliestDeadline = queue.heap.front().deadline.time_since_epoch().count();
+        m_queuedStreams++;
+    }
+
+    if (m_sleepingWorkers > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.notify_one();
+    }
+}
+
+RnNoiseMultiStreamEngine::Stream::Stream(RnNoiseMultiStreamEngine &engine, size_t queueIdx) :
+        m_engine(engine),
+        m_queueIdx(queueIdx),
+        m_capacity(engine.m_config.streamQueueFrames),
+        m_denoiseState(rnnoise_create(nullptr), rnnoise_destroy),
+        m_inputFrames(m_capacity * k_frameSize, 0.f),
+        m_inputPushTimes(m_capacity),
+        m_inputDeadlines(m_capacity),
+        m_outputFrames(m_capacity * k_frameSize, 0.f),
+        m_outputVadProbabilities(m_capacity, 0.f) {}
+
+RnNoiseMultiStreamEngine::Stream::~Stream() = default;
+
+bool RnNoiseMultiStreamEngine::Stream::pushFrame(const float *frame) {
+    Clock::time_point now = Clock::now();
+    return pushFrame(frame, now + m_engine.m_config.frameDeadline);
+}
+
+bool RnNoiseMultiStreamEngine::Stream::pushFrame(const float *frame, Clock::time_point deadline) {
+    uint64_t writeIdx = m_inputWriteIdx;
+    if (writeIdx - m_inputReadIdx >= m_capacity) {
+        m_rejectedFrames++;
+        return false;
+    }
+
+    std::copy(frame, frame + k_frameSize, this->inputFrame(writeIdx));
+    size_t slot = static_cast<size_t>(writeIdx % m_capacity);
+    m_inputPushTimes[slot] = Clock::now();
+    m_inputDeadlines[slot] = deadline;
+
+    m_inputWriteIdx = writeIdx + 1;
+    trySchedule();
+    return true;
+}
+
+bool RnNoiseMultiStreamEngine::Stream::popFrame(float *frame, float *vadProbability) {
+    uint64_t readIdx = m_outputReadIdx;
+    if (readIdx == m_outputWriteIdx) {
+        return false;
+    }
+
+    const float *outputFrame = this->outputFrame(readIdx);
+    std::copy(outputFrame, outputFrame + k_frameSize, frame);
+    if (vadProbability != nullptr) {
+        *vadProbability = m_outputVadProbabilities[static_cast<size_t>(readIdx % m_capacity)];
+    }
+
+    m_outputReadIdx = readIdx + 1;
+    /* The stream could be waiting for space in the output queue. */
+    trySchedule();
+    return true;
+}
+
+RnNoiseStreamStats RnNoiseMultiStreamEngine::Stream::getStats() const {
+    RnNoiseStreamStats stats{};
+    uint64_t inputReadIdx = m_inputReadIdx;
+    uint64_t outputWriteIdx = m_outputWriteIdx;
+    stats.vadProbability = m_vadProbability;
+    stats.pendingFrames = static_cast<uint32_t>(m_inputWriteIdx - inputReadIdx);
+    stats.readyFrames = static_cast<uint32_t>(outputWriteIdx - m_outputReadIdx);
+    stats.lastFrameLatency = std::chrono::microseconds(m_lastFrameLatencyUs);
+    stats.maxFrameLatency = std::chrono::microseconds(m_maxFrameLatencyUs);
+    stats.processedFrames = outputWriteIdx;
+    stats.missedDeadlines = m_missedDeadlines;
+    stats.rejectedFrames = m_rejectedFrames;
+    return stats;
+}
+
+bool RnNoiseMultiStreamEngine::Stream::isReady() const {
+    return m_inputReadIdx != m_inputWriteIdx && m_outputWriteIdx - m_outputReadIdx < m_capacity;
+}
+
+void RnNoiseMultiStreamEngine::Stream::trySchedule() {
+    /* Producer, consumer and the worker all call this after changing their side of the queues,
+     * so whoever makes the stream ready last puts it into the work queue.
+     */
+    if (isReady() && !m_scheduled.exchange(true)) {
+        m_engine.schedule(shared_from_this());
+    }
+}
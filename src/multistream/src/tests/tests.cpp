@@ -0,0 +1,209 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "multistream/RnNoiseMultiStreamEngine.h"
+
+#include <rnnoise.h>
+
+#include <atomic>
+#include <random>
+
+static const size_t k_frameSize = RnNoiseMultiStreamEngine::k_frameSize;
+
+static std::vector<float> generateInput(size_t frames, uint32_t seed) {
+    std::minstd_rand rng(seed);
+    std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+    std::vector<float> input(frames * k_frameSize);
+    for (auto &sample: input) {
+        sample = noise(rng);
+    }
+    return input;
+}
+
+/* What a stream should output, denoised directly with rnnoise. */
+static std::vector<float> denoiseReference(const std::vector<float> &input) {
+    DenoiseState *st = rnnoise_create(nullptr);
+    std::vector<float> output(input.size());
+    float frame[k_frameSize];
+    for (size_t offset = 0; offset < input.size(); offset += k_frameSize) {
+        for (size_t i = 0; i < k_frameSize; i++) {
+            frame[i] = input[offset + i] * std::numeric_limits<short>::max();
+        }
+        rnnoise_process_frame(st, &output[offset], frame);
+        for (size_t i = 0; i < k_frameSize; i++) {
+            output[offset + i] /= std::numeric_limits<short>::max();
+        }
+    }
+    rnnoise_destroy(st);
+    return output;
+}
+
+TEST_CASE("Create and destroy", "[multistream]") {
+    auto workers = GENERATE(0, 1, 4);
+
+    CAPTURE(workers);
+
+    RnNoiseMultiStreamEngine::Config config;
+    config.workers = workers;
+    RnNoiseMultiStreamEngine engine(config);
+
+    auto stream = engine.createStream();
+    std::vector<float> frame(k_frameSize, 0.f);
+    REQUIRE(stream->pushFrame(frame.data()));
+}
+
+TEST_CASE("Stress thousands of streams", "[multistream]") {
+    const uint32_t workers = 3;
+    const size_t streamCount = 2000;
+    /* Enough frames to carry the rnnoise state over and to wrap the queues around a few times. */
+    const size_t framesPerStream = 6;
+    /* Comparing every stream would double the test time. */
+    const size_t referenceStride = 41;
+
+    CAPTURE(workers, streamCount, framesPerStream);
+
+    RnNoiseMultiStreamEngine::Config config;
+    config.workers = workers;
+    config.streamQueueFrames = 2;
+    RnNoiseMultiStreamEngine engine(config);
+
+    std::vector<std::shared_ptr<RnNoiseMultiStreamEngine::Stream>> streams;
+    std::vector<std::vector<float>> inputs;
+    std::vector<std::vector<float>> outputs;
+    for (size_t i = 0; i < streamCount; i++) {
+        streams.push_back(engine.createStream());
+        inputs.push_back(generateInput(framesPerStream, static_cast<uint32_t>(i + 1)));
+        outputs.emplace_back();
+    }
+
+    /* Two producers push interleaved frames while the test thread consumes, queues are small
+     * so that producers and the consumer keep running into full queues. Nothing is checked
+     * until the producers are joined, a failed check must not leave them running.
+     */
+    std::atomic<bool> stopProducers{false};
+    auto producer = [&](size_t first) {
+        std::vector<size_t> pushedFrames(streamCount, 0);
+        bool done = false;
+        while (!done && !stopProducers) {
+            done = true;
+            bool pushed = false;
+            for (size_t i = first; i < streamCount; i += 2) {
+                if (pushedFrames[i] == framesPerStream) {
+                    continue;
+                }
+                done = false;
+                if (streams[i]->pushFrame(&inputs[i][pushedFrames[i] * k_frameSize])) {
+                    pushedFrames[i]++;
+                    pushed = true;
+                }
+            }
+            if (!pushed) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+    std::thread producer0(producer, 0);
+    std::thread producer1(producer, 1);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(5);
+    size_t finishedStreams = 0;
+    size_t invalidVadProbabilities = 0;
+    float frame[k_frameSize];
+    while (finishedStreams < streamCount && std::chrono::steady_clock::now() < deadline) {
+        bool popped = false;
+        for (size_t i = 0; i < streamCount; i++) {
+            float vadProbability = -1.f;
+            while (streams[i]->popFrame(frame, &vadProbability)) {
+                if (vadProbability < 0.f || vadProbability > 1.f) {
+                    invalidVadProbabilities++;
+                }
+                outputs[i].insert(outputs[i].end(), frame, frame + k_frameSize);
+                popped = true;
+                if (outputs[i].size() == framesPerStream * k_frameSize) {
+                    finishedStreams++;
+                }
+            }
+        }
+        if (!popped) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    stopProducers = true;
+    producer0.join();
+    producer1.join();
+
+    REQUIRE(invalidVadProbabilities == 0);
+    REQUIRE(finishedStreams == streamCount);
+
+    for (size_t i = 0; i < streamCount; i++) {
+        CAPTURE(i);
+        const RnNoiseStreamStats stats = streams[i]->getStats();
+        REQUIRE(stats.processedFrames == framesPerStream);
+        REQUIRE(stats.pendingFrames == 0);
+        REQUIRE(stats.readyFrames == 0);
+        REQUIRE(stats.maxFrameLatency >= stats.lastFrameLatency);
+
+        if (i % referenceStride == 0) {
+            REQUIRE(outputs[i] == denoiseReference(inputs[i]));
+        }
+    }
+}
+
+TEST_CASE("Late stream is processed first", "[multistream]") {
+    RnNoiseMultiStreamEngine::Config config;
+    config.workers = 0;
+    config.maxBatchStreams = 1;
+    RnNoiseMultiStreamEngine engine(config);
+
+    auto freshStream = engine.createStream();
+    auto lateStream = engine.createStream();
+
+    std::vector<float> input = generateInput(1, 1);
+    auto now = RnNoiseMultiStreamEngine::Clock::now();
+    REQUIRE(freshStream->pushFrame(input.data(), now + std::chrono::seconds(1)));
+    REQUIRE(lateStream->pushFrame(input.data(), now - std::chrono::milliseconds(1)));
+
+    REQUIRE(engine.processBatch() == 1);
+    REQUIRE(lateStream->getStats().processedFrames == 1);
+    REQUIRE(lateStream->getStats().missedDeadlines == 1);
+    REQUIRE(freshStream->getStats().processedFrames == 0);
+
+    REQUIRE(engine.processBatch() == 1);
+    REQUIRE(freshStream->getStats().processedFrames == 1);
+    REQUIRE(freshStream->getStats().missedDeadlines == 0);
+
+    REQUIRE(engine.processBatch() == 0);
+}
+
+TEST_CASE("Full queues apply back pressure", "[multistream]") {
+    RnNoiseMultiStreamEngine::Config config;
+    config.workers = 0;
+    config.streamQueueFrames = 2;
+    RnNoiseMultiStreamEngine engine(config);
+
+    auto stream = engine.createStream();
+    std::vector<float> input = generateInput(5, 1);
+
+    REQUIRE(stream->pushFrame(&input[0]));
+    REQUIRE(stream->pushFrame(&input[k_frameSize]));
+    REQUIRE_FALSE(stream->pushFrame(&input[2 * k_frameSize]));
+    REQUIRE(stream->getStats().rejectedFrames == 1);
+
+    /* Output queue is full after two frames, the rest waits for the consumer. */
+    while (engine.processBatch() > 0) {}
+    REQUIRE(stream->pushFrame(&input[2 * k_frameSize]));
+    REQUIRE(engine.processBatch() == 0);
+    REQUIRE(stream->getStats().pendingFrames == 1);
+    REQUIRE(stream->getStats().readyFrames == 2);
+
+    std::vector<float> output(3 * k_frameSize);
+    REQUIRE(stream->popFrame(&output[0]));
+    REQUIRE(engine.processBatch() == 1);
+    REQUIRE(stream->popFrame(&output[k_frameSize]));
+    REQUIRE(stream->popFrame(&output[2 * k_frameSize]));
+    REQUIRE_FALSE(stream->popFrame(&output[0]));
+
+    std::vector<float> expected = denoiseReference(std::vector<float>(input.begin(), input.begin() + 3 * k_frameSize));
+    REQUIRE(output == expected);
+}